@@ -0,0 +1,241 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		asset_loader.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <iostream>
+#include <cstdio>
+#include <memory>
+#include <atomic>
+#include <IL/il.h>
+#include "asset_loader.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "gl_state.h"
+
+// DevIL keeps global state (bound image, error stack), only decoding itself is serialized, files are read in parallel
+static std::mutex devilMutex;
+
+// faces of cube map decoded by separate tasks, the last one queues the upload
+typedef struct CubeMapRequest {
+	std::string fileNames[6];
+	ImageData faces[6];
+	bool decoded[6];
+	std::atomic<int> remaining;
+	GLuint* texture;
+} CubeMapRequest;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// reads whole file to memory
+static bool readFile(const std::string& fileName, std::vector<unsigned char>& content)
+{
+	FILE* file = fopen(fileName.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	bool read = size > 0;
+	if (read) {
+		content.resize((size_t)size);
+		read = fread(&content[0], 1, content.size(), file) == content.size();
+	}
+	fclose(file);
+	return read;
+}
+
+// hands GL work over to the main thread
+static void queueUpload(AssetLoader& loader, const std::function<void()>& upload)
+{
+	{
+		std::lock_guard<std::mutex> lock(loader.mutex);
+		loader.uploads.push_back(upload);
+	}
+	loader.uploadAdded.notify_one();
+}
+
+// same texture setup as pgr::createTexture()
+static void uploadTexture(const ImageData& image, GLuint* texture)
+{
+	glGenTextures(1, texture);
+	glBindTexture(GL_TEXTURE_2D, *texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image.pixels[0]);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	CHECK_GL_ERROR();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Decodes image file, can be called from any thread.
+bool decodeImage(const std::string& fileName, ImageData& image)
+{
+	std::vector<unsigned char> content;
+	if (!readFile(fileName, content))
+		return false;
+
+	std::lock_guard<std::mutex> lock(devilMutex);
+
+	ILuint imageId;
+	ilGenImages(1, &imageId);
+	ilBindImage(imageId);
+	// set origin to lower left corner (the orientation which OpenGL uses)
+	ilEnable(IL_ORIGIN_SET);
+	ilOriginFunc(IL_ORIGIN_LOWER_LEFT);
+
+	bool decoded = ilLoadL(IL_TYPE_UNKNOWN, &content[0], (ILuint)content.size()) == IL_TRUE
+		&& ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE) == IL_TRUE;
+	if (decoded) {
+		image.width = ilGetInteger(IL_IMAGE_WIDTH);
+		image.height = ilGetInteger(IL_IMAGE_HEIGHT);
+		const ILubyte* pixels = ilGetData();
+		image.pixels.assign(pixels, pixels + 4 * image.width * image.height);
+	}
+
+	ilDeleteImages(1, &imageId);
+	return decoded;
+}
+
+/// Starts new loading batch, requests are executed on \a pool. Must be called on the GL thread.
+void initAssetLoader(AssetLoader& loader, ThreadPool* pool)
+{
+	loader.pool = pool;
+	loader.uploads.clear();
+	loader.pending = 0;
+	loader.failed = 0;
+	// GL_INT_2_10_10_10_REV vertex attributes are core since OpenGL 3.3
+	loader.vertexFormat = isGLSupported(3, 3, "GL_ARB_vertex_type_2_10_10_10_rev") ? MESH_FORMAT_PACKED : MESH_FORMAT_FLOAT;
+}
+
+/// Requests 2D texture with mipmaps, \a texture is set when uploaded (0 on failure).
+void loadTextureAsync(AssetLoader& loader, const std::string& fileName, GLuint* texture)
+{
+	AssetLoader* target = &loader;
+	loader.pending++;
+
+	submitTask(*loader.pool, [target, fileName, texture]() {
+		std::shared_ptr<ImageData> image(new ImageData());
+		bool decoded = decodeImage(fileName, *image);
+
+		queueUpload(*target, [target, fileName, texture, image, decoded]() {
+			*texture = 0;
+			if (!decoded) {
+				std::cerr << "Texture loading failed: " << fileName << std::endl;
+				target->failed++;
+				return;
+			}
+			std::cout << "Loading texture file: " << fileName << std::endl;
+			uploadTexture(*image, texture);
+		});
+	});
+}
+
+/// Requests cube map, faces in order +x, -x, +y, -y, +z, -z, \a texture is set when uploaded.
+void loadCubeMapAsync(AssetLoader& loader, const std::string fileNames[6], GLuint* texture)
+{
+	static const GLenum targets[] = {
+		GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
+		GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
+		GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z
+	};
+
+	AssetLoader* target = &loader;
+	std::shared_ptr<CubeMapRequest> request(new CubeMapRequest());
+	for (int i = 0; i < 6; i++)
+		request->fileNames[i] = fileNames[i];
+	request->remaining = 6;
+	request->texture = texture;
+	loader.pending++;
+
+	for (int i = 0; i < 6; i++) {
+		submitTask(*loader.pool, [target, request, i]() {
+			request->decoded[i] = decodeImage(request->fileNames[i], request->faces[i]);
+			if (--request->remaining > 0)
+				return;
+
+			queueUpload(*target, [target, request]() {
+				glActiveTexture(GL_TEXTURE0);
+				glGenTextures(1, request->texture);
+				glBindTexture(GL_TEXTURE_CUBE_MAP, *request->texture);
+
+				for (int face = 0; face < 6; face++) {
+					std::cout << "Loading cube map texture: " << request->fileNames[face] << std::endl;
+					if (!request->decoded[face])
+						pgr::dieWithError("Skybox cube map loading failed!");
+
+					const ImageData& image = request->faces[face];
+					glTexImage2D(targets[face], 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image.pixels[0]);
+				}
+
+				glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+				glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+				// unbind the texture
+				glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+				CHECK_GL_ERROR();
+			});
+		});
+	}
+}
+
+/// Requests mesh and its texture, \a geometry is set when placed to the scene arena (NULL on failure).
+void loadMeshAsync(AssetLoader& loader, const std::string& fileName, MeshGeometry** geometry)
+{
+	AssetLoader* target = &loader;
+	loader.pending++;
+
+	submitTask(*loader.pool, [target, fileName, geometry]() {
+		std::shared_ptr<MeshData> data(new MeshData());
+		std::shared_ptr<ImageData> image(new ImageData());
+		bool loaded = loadMeshData(fileName, *data);
+		if (loaded)
+			convertMesh(*data, target->vertexFormat);
+		bool textured = loaded && !data->texture.empty() && decodeImage(data->texture, *image);
+
+		queueUpload(*target, [target, fileName, geometry, data, image, loaded, textured]() {
+			if (!loaded) {
+				std::cerr << "Mesh loading failed: " << fileName << std::endl;
+				*geometry = NULL;
+				target->failed++;
+				return;
+			}
+
+			createMeshGeometry(*data, geometry);
+			if (textured) {
+				std::cout << "Loading texture file: " << data->texture << std::endl;
+				uploadTexture(*image, &(*geometry)->texture);
+			}
+			else if (!data->texture.empty())
+				std::cerr << "Texture loading failed: " << data->texture << std::endl;
+
+			releaseMeshData(*data);
+		});
+	});
+}
+
+/// Uploads loaded assets on the calling (GL) thread until all requests are finished.
+int finishAssetLoading(AssetLoader& loader)
+{
+	std::unique_lock<std::mutex> lock(loader.mutex);
+	while (loader.pending > 0) {
+		while (loader.uploads.empty())
+			loader.uploadAdded.wait(lock);
+
+		std::function<void()> upload = loader.uploads.front();
+		loader.uploads.pop_front();
+
+		lock.unlock();
+		upload();
+		lock.lock();
+
+		loader.pending--;
+	}
+	return loader.failed;
+}
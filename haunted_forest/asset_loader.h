@@ -0,0 +1,66 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		asset_loader.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __ASSET_LOADER_H
+#define __ASSET_LOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "pgr.h"
+#include "render_stuff.h"
+#include "thread_pool.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Decoded image, RGBA with 8 bits per channel, first row is the bottom one (as OpenGL expects).
+typedef struct ImageData {
+	std::vector<unsigned char> pixels;
+	int width;
+	int height;
+} ImageData;
+
+/// Loads files on worker threads, resulting GL objects are created on the main thread.
+/**
+Workers decode meshes and images into CPU buffers and queue the upload, the main thread
+executes queued uploads in finishAssetLoading() as soon as they arrive.
+*/
+typedef struct AssetLoader {
+	ThreadPool* pool;
+	std::deque<std::function<void()> > uploads;		// GL work waiting for the main thread
+	std::mutex mutex;
+	std::condition_variable uploadAdded;
+	int pending;									// requests not uploaded yet
+	int failed;										// requests which could not be loaded
+	unsigned int vertexFormat;						// MESH_FORMAT_* of loaded meshes, packed if GL supports it
+} AssetLoader;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Decodes image file, can be called from any thread.
+bool decodeImage(const std::string& fileName, ImageData& image);
+
+/// Starts new loading batch, requests are executed on \a pool. Must be called on the GL thread.
+void initAssetLoader(AssetLoader& loader, ThreadPool* pool);
+
+/// Requests 2D texture with mipmaps, \a texture is set when uploaded (0 on failure).
+void loadTextureAsync(AssetLoader& loader, const std::string& fileName, GLuint* texture);
+
+/// Requests cube map, faces in order +x, -x, +y, -y, +z, -z, \a texture is set when uploaded.
+void loadCubeMapAsync(AssetLoader& loader, const std::string fileNames[6], GLuint* texture);
+
+/// Requests mesh and its texture, \a geometry is set when placed to the scene arena (NULL on failure).
+void loadMeshAsync(AssetLoader& loader, const std::string& fileName, MeshGeometry** geometry);
+
+/// Uploads loaded assets on the calling (GL) thread until all requests are finished.
+/**
+\param[in]  loader             Loader with requests.
+\return                        Number of requests which failed.
+*/
+int finishAssetLoading(AssetLoader& loader);
+
+#endif // __ASSET_LOADER_H
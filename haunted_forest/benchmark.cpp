@@ -0,0 +1,152 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		benchmark.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "benchmark.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// string as JSON string literal
+static std::string quoteJson(const char* text)
+{
+	std::string quoted = "\"";
+	for (; text != NULL && *text != '\0'; text++) {
+		if (*text == '"' || *text == '\\')
+			quoted += '\\';
+		if ((unsigned char)*text >= 0x20)
+			quoted += *text;
+	}
+	return quoted + "\"";
+}
+
+// mean and maximum of counts
+static void getCountSummary(const std::vector<unsigned int>& values, double& mean, unsigned int& maximum)
+{
+	mean = 0.0;
+	maximum = 0;
+	for (size_t i = 0; i < values.size(); i++) {
+		mean += values[i];
+		maximum = std::max(maximum, values[i]);
+	}
+	if (!values.empty())
+		mean /= values.size();
+}
+
+// writes report to stream
+static void writeReport(std::ostream& out, const BenchStats& stats, const BenchInfo& info)
+{
+	double meanTime = 0.0;
+	for (size_t i = 0; i < stats.frameTimes.size(); i++)
+		meanTime += stats.frameTimes[i];
+	if (!stats.frameTimes.empty())
+		meanTime /= stats.frameTimes.size();
+
+	double meanDrawCalls, meanTriangles;
+	unsigned int maxDrawCalls, maxTriangles;
+	getCountSummary(stats.drawCalls, meanDrawCalls, maxDrawCalls);
+	getCountSummary(stats.triangles, meanTriangles, maxTriangles);
+
+	char checksum[17];
+	sprintf(checksum, "%016llx", info.layoutChecksum);
+
+	out << "{\n"
+		<< "  \"renderer\": " << quoteJson((const char*)glGetString(GL_RENDERER)) << ",\n"
+		<< "  \"glVersion\": " << quoteJson((const char*)glGetString(GL_VERSION)) << ",\n"
+		<< "  \"seed\": " << info.seed << ",\n"
+		<< "  \"layoutChecksum\": \"" << checksum << "\",\n"
+		<< "  \"width\": " << info.width << ",\n"
+		<< "  \"height\": " << info.height << ",\n"
+		<< "  \"warmupFrames\": " << info.warmupFrames << ",\n"
+		<< "  \"frames\": " << stats.frameTimes.size() << ",\n"
+		<< "  \"frameTimeMs\": { \"mean\": " << meanTime
+		<< ", \"p50\": " << getPercentile(stats.frameTimes, 50.0f)
+		<< ", \"p95\": " << getPercentile(stats.frameTimes, 95.0f)
+		<< ", \"p99\": " << getPercentile(stats.frameTimes, 99.0f)
+		<< ", \"max\": " << getPercentile(stats.frameTimes, 100.0f) << " },\n"
+		<< "  \"drawCalls\": { \"mean\": " << meanDrawCalls << ", \"max\": " << maxDrawCalls << " },\n"
+		<< "  \"triangles\": { \"mean\": " << meanTriangles << ", \"max\": " << maxTriangles << " }\n"
+		<< "}" << std::endl;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Creates framebuffer with color and depth renderbuffers.
+bool createBenchTarget(BenchTarget& target, int width, int height)
+{
+	target.width = width;
+	target.height = height;
+
+	glGenRenderbuffers(1, &target.colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &target.depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &target.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return complete;
+}
+
+/// Deletes framebuffer and its renderbuffers.
+void destroyBenchTarget(BenchTarget& target)
+{
+	glDeleteFramebuffers(1, &target.framebuffer);
+	glDeleteRenderbuffers(1, &target.colorBuffer);
+	glDeleteRenderbuffers(1, &target.depthBuffer);
+	target.framebuffer = 0;
+	target.colorBuffer = 0;
+	target.depthBuffer = 0;
+}
+
+/// Prepares storage for \a frames frames.
+void initBenchStats(BenchStats& stats, int frames)
+{
+	stats.frameTimes.clear();
+	stats.drawCalls.clear();
+	stats.triangles.clear();
+	stats.frameTimes.reserve(frames);
+	stats.drawCalls.reserve(frames);
+	stats.triangles.reserve(frames);
+}
+
+/// Records one frame.
+void addBenchFrame(BenchStats& stats, float frameTime, const GLStateStats& frameStats)
+{
+	stats.frameTimes.push_back(frameTime);
+	stats.drawCalls.push_back(frameStats.drawCalls);
+	stats.triangles.push_back(frameStats.triangles);
+}
+
+/// Value below which \a percentile percent of values lie (nearest rank).
+float getPercentile(std::vector<float> values, float percentile)
+{
+	if (values.empty())
+		return 0.0f;
+
+	size_t rank = (size_t)ceil(percentile / 100.0f * values.size());
+	size_t index = std::min(std::max(rank, (size_t)1), values.size()) - 1;
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+/// Writes report as JSON (frame time percentiles, draw calls and triangles per frame).
+bool writeBenchReport(const std::string& fileName, const BenchStats& stats, const BenchInfo& info)
+{
+	std::ofstream file(fileName.c_str());
+	if (!file) {
+		std::cerr << "cannot write benchmark report: " << fileName << std::endl;
+		return false;
+	}
+	writeReport(file, stats, info);
+	return file.good();
+}
@@ -0,0 +1,77 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		benchmark.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include "pgr.h"
+#include "gl_state.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Framebuffer the benchmark renders to, so the window size and swap interval do not affect the results.
+typedef struct BenchTarget {
+	GLuint framebuffer;
+	GLuint colorBuffer;
+	GLuint depthBuffer;
+	int width;
+	int height;
+} BenchTarget;
+
+/// Measurements of recorded frames.
+typedef struct BenchStats {
+	std::vector<float> frameTimes;			// milliseconds from the start of the frame to glFinish()
+	std::vector<unsigned int> drawCalls;
+	std::vector<unsigned int> triangles;
+} BenchStats;
+
+/// Description of the run written to the report, so results of different builds can be matched.
+typedef struct BenchInfo {
+	unsigned int seed;
+	unsigned long long layoutChecksum;
+	int width;
+	int height;
+	int warmupFrames;
+} BenchInfo;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Creates framebuffer with color and depth renderbuffers.
+/**
+\param[out] target             Framebuffer.
+\param[in]  width              Width in pixels.
+\param[in]  height             Height in pixels.
+\return                        False if the framebuffer is not complete.
+*/
+bool createBenchTarget(BenchTarget& target, int width, int height);
+
+/// Deletes framebuffer and its renderbuffers.
+void destroyBenchTarget(BenchTarget& target);
+
+/// Prepares storage for \a frames frames.
+void initBenchStats(BenchStats& stats, int frames);
+
+/// Records one frame.
+/**
+\param[in,out] stats           Measurements.
+\param[in]  frameTime          Milliseconds.
+\param[in]  frameStats         Draws and state changes counted during the frame.
+*/
+void addBenchFrame(BenchStats& stats, float frameTime, const GLStateStats& frameStats);
+
+/// Value below which \a percentile percent of values lie (nearest rank).
+float getPercentile(std::vector<float> values, float percentile);
+
+/// Writes report as JSON (frame time percentiles, draw calls and triangles per frame).
+/**
+\param[in]  fileName           Written file.
+\param[in]  stats              Recorded frames.
+\param[in]  info               Run description.
+\return                        True on success.
+*/
+bool writeBenchReport(const std::string& fileName, const BenchStats& stats, const BenchInfo& info);
+
+#endif // __BENCHMARK_H
@@ -38,6 +38,39 @@ enum { LEFT, RIGHT, UP, DOWN, KEYS_COUNT };
 #define BAT_MODEL "data/bat/bat.obj"
 #define GHOST_MODEL "data/ghost/ghost.obj"
 
+// imported meshes are reordered for vertex cache and packed (cooked meshes must be deleted after change)
+#define OPTIMIZE_MESHES true
+
+// levels of detail of imported meshes (quadric edge collapse when cooked)
+#define GENERATE_MESH_LODS true
+#define MESH_LOD_COUNT 3
+#define MESH_LOD_RATIO 0.4f				// triangles of level relative to the previous one
+#define MESH_LOD_MIN_REDUCTION 0.8f		// level is not added when it keeps more triangles of the previous one
+#define MESH_LOD_MAX_ERROR 0.01f		// allowed displacement of surface per level, relative to diagonal of mesh bounds
+// level is selected by projected height of object bounding sphere (fraction of viewport height)
+#define LOD_SCREEN_SIZE_1 0.25f			// smaller objects use level 1
+#define LOD_SCREEN_SIZE_2 0.08f			// smaller objects use level 2
+#define LOD_HYSTERESIS 0.15f			// object has to be this much further past threshold to switch back (no popping on the border)
+
+// distant trees are drawn as camera facing quads with pre-rendered views (impostors)
+#define IMPOSTOR_DISTANCE 2.5f			// trees further from the camera (along view direction) use impostors
+#define IMPOSTOR_VIEWS 8				// directions around vertical axis baked to the atlas
+#define IMPOSTOR_TILE_SIZE 128			// pixels of one view in the atlas
+
+// software occlusion culling ~ the nearest trees and the rock are rasterized on CPU, still objects behind them are not drawn
+#define OCCLUSION_CULLING true
+#define OCCLUSION_WIDTH 256				// pixels of the depth buffer
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_OCCLUDERS 16			// visible objects closest to the camera used as occluders
+
+// linear allocators, blocks grow when they overflow
+#define SCENE_MEMORY_SIZE 16384			// bytes of objects living until restart (camera, ground, rain, fog)
+#define FRAME_MEMORY_SIZE 262144		// bytes of transient data of one frame packet, living until the packet is built again (culling, batch, copies of drawn objects)
+
+// simulation runs in fixed steps, drawing interpolates between the last two steps
+#define SIMULATION_STEP (1.0f / 60.0f)	// seconds
+#define SIMULATION_MAX_FRAME_TIME 0.25f	// longer frames (e.g. window dragging) are cut, the simulation slows down instead of catching up
+
 // number of objects in scene
 #define TREES01_COUNT 15
 #define TREES02_COUNT 23
@@ -45,8 +78,8 @@ enum { LEFT, RIGHT, UP, DOWN, KEYS_COUNT };
 #define TREES04_COUNT 20
 #define EXTRA_OBJECT_COUNT 5
 
-// delta of view angle
-#define VIEW_ANGLE_DELTA 5.0f
+// view angle per second of turning by keys
+#define VIEW_ANGLE_SPEED 150.0f
 // maximal elevation of camera
 #define CAMERA_ELEVATION_MAX 50.0f
 // movement speed
@@ -74,4 +107,23 @@ enum { LEFT, RIGHT, UP, DOWN, KEYS_COUNT };
 #define FOG_DENSITY 1.0f;
 #define TRESHOLD_RADIUS 0.13f
 
+// placement of objects (Poisson disk sampling) ~ minimal distance from other objects
+#define TREE_PLACEMENT_RADIUS 0.2f
+#define SKULL_PLACEMENT_RADIUS 0.15f
+#define ROCK_PLACEMENT_RADIUS 0.2f
+#define EXTRA_PLACEMENT_RADIUS TRESHOLD_RADIUS
+#define MUSH_PLACEMENT_RADIUS TRESHOLD_RADIUS
+#define PLACEMENT_ATTEMPTS 30
+#define SCENE_SEED 2017u				// seed of scene generation when none is given by --seed
+#define SCENE_SNAPSHOT_FILE "forest.scene"	// saved by F5, loaded by F9 or --scene
+
+// benchmark (--bench N) ~ N frames of camera flythrough rendered offscreen as fast as possible
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_WARMUP_FRAMES 30			// rendered before the measured frames, not recorded
+#define BENCH_FRAME_TIME (1.0f / 60.0f)	// simulated seconds per frame, animation does not depend on the speed of the machine
+#define BENCH_CAMERA_SPEED 0.2f			// curve segments per second
+#define BENCH_CAMERA_ELEVATION 5.0f
+#define BENCH_REPORT_FILE "bench.json"	// JSON report, --bench-report overrides it
+
 #endif // __CONST_H
@@ -0,0 +1,229 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		culling.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <algorithm>
+#include "culling.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define CULLING_USE_SSE
+#endif
+
+// objects in one leaf of the hierarchy
+#define BVH_LEAF_SIZE 4
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Bounds of the box \a box transformed by \a matrix (Arvo's method).
+BoundingBox transformBoundingBox(const BoundingBox& box, const glm::mat4& matrix)
+{
+	BoundingBox result;
+	result.min = result.max = glm::vec3(matrix[3]);
+
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row < 3; row++) {
+			float a = matrix[col][row] * box.min[col];
+			float b = matrix[col][row] * box.max[col];
+			result.min[row] += std::min(a, b);
+			result.max[row] += std::max(a, b);
+		}
+	}
+	return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Extracts frustum planes from projection * view matrix (Gribb & Hartmann).
+void extractFrustum(Frustum& frustum, const glm::mat4& PVmatrix)
+{
+	// rows of the matrix (glm is column major)
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(PVmatrix[0][i], PVmatrix[1][i], PVmatrix[2][i], PVmatrix[3][i]);
+
+	glm::vec4 planes[8] = {
+		row[3] + row[0], row[3] - row[0], // left, right
+		row[3] + row[1], row[3] - row[1], // bottom, top
+		row[3] + row[2], row[3] - row[2], // near, far
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) // padding
+	};
+
+	for (int i = 0; i < 8; i++) {
+		frustum.nx[i] = planes[i].x;
+		frustum.ny[i] = planes[i].y;
+		frustum.nz[i] = planes[i].z;
+		frustum.d[i] = planes[i].w;
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Tests box against frustum.
+/**
+Box is outside if it lies completely on the negative side of any plane, it is inside
+if it lies on the positive side of all planes.
+
+\param[in]  frustum            Frustum planes.
+\param[in]  box                Tested box.
+\return                        CULL_OUTSIDE, CULL_INTERSECT or CULL_INSIDE.
+*/
+int testBoxInFrustum(const Frustum& frustum, const BoundingBox& box)
+{
+	glm::vec3 center = 0.5f * (box.max + box.min);
+	glm::vec3 extent = 0.5f * (box.max - box.min);
+
+#ifdef CULLING_USE_SSE
+	const __m128 cx = _mm_set1_ps(center.x);
+	const __m128 cy = _mm_set1_ps(center.y);
+	const __m128 cz = _mm_set1_ps(center.z);
+	const __m128 ex = _mm_set1_ps(extent.x);
+	const __m128 ey = _mm_set1_ps(extent.y);
+	const __m128 ez = _mm_set1_ps(extent.z);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	int outside = 0;
+	int intersect = 0;
+
+	// 4 planes at once
+	for (int i = 0; i < 8; i += 4) {
+		__m128 nx = _mm_loadu_ps(frustum.nx + i);
+		__m128 ny = _mm_loadu_ps(frustum.ny + i);
+		__m128 nz = _mm_loadu_ps(frustum.nz + i);
+		__m128 d = _mm_loadu_ps(frustum.d + i);
+
+		// signed distance of box center
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), d));
+		// projected radius of box ~ extent dot |n|
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)), _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		intersect |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+	}
+
+	if (outside != 0)
+		return CULL_OUTSIDE;
+	return (intersect != 0) ? CULL_INTERSECT : CULL_INSIDE;
+#else
+	int result = CULL_INSIDE;
+	for (int i = 0; i < 6; i++) {
+		float distance = frustum.nx[i] * center.x + frustum.ny[i] * center.y + frustum.nz[i] * center.z + frustum.d[i];
+		float radius = fabs(frustum.nx[i]) * extent.x + fabs(frustum.ny[i]) * extent.y + fabs(frustum.nz[i]) * extent.z;
+
+		if (distance + radius < 0.0f)
+			return CULL_OUTSIDE;
+		if (distance - radius < 0.0f)
+			result = CULL_INTERSECT;
+	}
+	return result;
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// BOUNDING VOLUME HIERARCHY
+
+// orders objects by box center along given axis
+struct CullObjectCenterLess
+{
+	int axis;
+	bool operator()(const CullObject& a, const CullObject& b) const
+	{
+		return (a.bounds.min[axis] + a.bounds.max[axis]) < (b.bounds.min[axis] + b.bounds.max[axis]);
+	}
+};
+
+// build subtree over objects [first, first + count), returns index of its root
+static int buildBvhNode(Bvh& bvh, int first, int count)
+{
+	BvhNode node;
+	node.bounds = bvh.objects[first].bounds;
+	for (int i = first + 1; i < first + count; i++) {
+		node.bounds.min = glm::min(node.bounds.min, bvh.objects[i].bounds.min);
+		node.bounds.max = glm::max(node.bounds.max, bvh.objects[i].bounds.max);
+	}
+	node.left = node.right = -1;
+	node.first = first;
+	node.count = count;
+
+	int index = (int)bvh.nodes.size();
+	bvh.nodes.push_back(node);
+
+	if (count <= BVH_LEAF_SIZE)
+		return index;
+
+	// median split along the longest axis ~ half of the objects (by center) go to each child
+	glm::vec3 size = node.bounds.max - node.bounds.min;
+	CullObjectCenterLess less;
+	less.axis = (size.x > size.y) ? ((size.x > size.z) ? 0 : 2) : ((size.y > size.z) ? 1 : 2);
+
+	int half = count / 2;
+	std::nth_element(bvh.objects.begin() + first, bvh.objects.begin() + first + half, bvh.objects.begin() + first + count, less);
+
+	int left = buildBvhNode(bvh, first, half);
+	int right = buildBvhNode(bvh, first + half, count - half);
+
+	// nodes vector may have been reallocated
+	bvh.nodes[index].left = left;
+	bvh.nodes[index].right = right;
+	bvh.nodes[index].count = 0;
+	return index;
+}
+
+/// Builds hierarchy over given objects (median split along the longest axis).
+void buildBvh(Bvh& bvh, const CullObject* objects, unsigned int count)
+{
+	bvh.nodes.clear();
+	bvh.objects.assign(objects, objects + count);
+
+	if (!bvh.objects.empty())
+		buildBvhNode(bvh, 0, (int)bvh.objects.size());
+}
+
+/// Sets OBJECT_VISIBLE flag of all objects in the storage.
+/**
+Subtrees completely inside the frustum are accepted without testing their objects.
+
+\param[in]  bvh                Hierarchy built by buildBvh().
+\param[in]  frustum            Current view frustum.
+\return                        Number of visible objects.
+*/
+int cullBvh(const Bvh& bvh, const Frustum& frustum, SceneStorage& scene)
+{
+	for (size_t i = 0; i < scene.flags.size(); i++)
+		scene.flags[i] &= ~OBJECT_VISIBLE;
+
+	if (bvh.nodes.empty())
+		return 0;
+
+	int visibleCount = 0;
+
+	// node index, parent completely inside
+	std::vector<std::pair<int, bool> > stack;
+	stack.push_back(std::make_pair(0, false));
+
+	while (!stack.empty()) {
+		const BvhNode& node = bvh.nodes[stack.back().first];
+		bool inside = stack.back().second;
+		stack.pop_back();
+
+		if (!inside) {
+			int result = testBoxInFrustum(frustum, node.bounds);
+			if (result == CULL_OUTSIDE)
+				continue;
+			inside = (result == CULL_INSIDE);
+		}
+
+		if (node.left < 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				if (inside || testBoxInFrustum(frustum, bvh.objects[i].bounds) != CULL_OUTSIDE) {
+					scene.flags[bvh.objects[i].index] |= OBJECT_VISIBLE;
+					visibleCount++;
+				}
+			}
+		}
+		else {
+			stack.push_back(std::make_pair(node.left, inside));
+			stack.push_back(std::make_pair(node.right, inside));
+		}
+	}
+	return visibleCount;
+}
@@ -0,0 +1,78 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		culling.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __CULLING_H
+#define __CULLING_H
+
+#include <vector>
+#include "pgr.h"
+#include "render_stuff.h"
+#include "scene_storage.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// View frustum planes (left, right, bottom, top, near, far) stored as structure of arrays.
+/**
+Planes are padded to 8 so they can be tested in two groups of 4 using SSE,
+padding planes (0, 0, 0, 1) never reject anything.
+*/
+typedef struct Frustum {
+	float nx[8];
+	float ny[8];
+	float nz[8];
+	float d[8];
+} Frustum;
+
+/// Result of box vs. frustum test.
+enum { CULL_OUTSIDE, CULL_INTERSECT, CULL_INSIDE };
+
+/// Static object inserted into the bounding volume hierarchy.
+typedef struct CullObject {
+	BoundingBox bounds;		// world space bounds
+	unsigned int index;		// dense index in SceneStorage, the hierarchy is rebuilt whenever objects change
+} CullObject;
+
+typedef struct BvhNode {
+	BoundingBox bounds;
+	int left;				// child nodes, -1 for leaf
+	int right;
+	int first;				// leaf: range of objects
+	int count;
+} BvhNode;
+
+/// Bounding volume hierarchy over static objects of the scene.
+typedef struct Bvh {
+	std::vector<BvhNode> nodes;
+	std::vector<CullObject> objects;
+} Bvh;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Bounds of the box \a box transformed by \a matrix (Arvo's method).
+BoundingBox transformBoundingBox(const BoundingBox& box, const glm::mat4& matrix);
+
+/// Extracts frustum planes from projection * view matrix (Gribb & Hartmann).
+void extractFrustum(Frustum& frustum, const glm::mat4& PVmatrix);
+
+/// Tests box against frustum.
+/**
+\param[in]  frustum            Frustum planes.
+\param[in]  box                Tested box.
+\return                        CULL_OUTSIDE, CULL_INTERSECT or CULL_INSIDE.
+*/
+int testBoxInFrustum(const Frustum& frustum, const BoundingBox& box);
+
+/// Builds hierarchy over given objects (median split along the longest axis).
+void buildBvh(Bvh& bvh, const CullObject* objects, unsigned int count);
+
+/// Sets OBJECT_VISIBLE flag of all objects in the storage.
+/**
+\param[in]  bvh                Hierarchy built by buildBvh().
+\param[in]  frustum            Current view frustum.
+\param[in,out] scene           Objects of the hierarchy, those outside of it are hidden.
+\return                        Number of visible objects.
+*/
+int cullBvh(const Bvh& bvh, const Frustum& frustum, SceneStorage& scene);
+
+#endif // __CULLING_H
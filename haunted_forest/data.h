@@ -118,6 +118,16 @@ const float smoke[] =
 	1.0f,  1.0f, 0.0f,	1.0f, 1.0f,
 };
 
+// impostor quad ~ corners only, texture coordinates are given by the tile in the atlas
+const int impostorNumQuadVertices = 4;
+const float impostorQuad[] =
+{
+	-1.0f, -1.0f,
+	1.0f, -1.0f,
+	-1.0f,  1.0f,
+	1.0f,  1.0f,
+};
+
 const int rockNAttribsPerVertex = 8;
 const int rockNVertices = 910;
 const int rockNTriangles = 1492;
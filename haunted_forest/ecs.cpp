@@ -0,0 +1,275 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		ecs.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cassert>
+#include <cstring>
+#include "ecs.h"
+
+// end of the list of free entity indices
+#define NO_FREE_ENTITY -1
+// component arrays start at multiples of this
+#define ECS_COMPONENT_ALIGNMENT 16
+
+static const size_t componentSizes[COMPONENT_COUNT] = {
+	sizeof(TransformComponent),
+	sizeof(MeshComponent),
+	sizeof(SplineFollowerComponent),
+	sizeof(ParticleEmitterComponent)
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// index of archetype with exactly \a mask components, created if missing
+static int findArchetype(EcsWorld& world, ComponentMask mask)
+{
+	for (size_t i = 0; i < world.archetypes.size(); i++)
+		if (world.archetypes[i].mask == mask)
+			return (int)i;
+
+	Archetype archetype;
+	archetype.mask = mask;
+	world.archetypes.push_back(archetype);
+	return (int)world.archetypes.size() - 1;
+}
+
+// empty chunk with component arrays of the archetype
+static EcsChunk* createChunk(EcsWorld& world, int archetype)
+{
+	// emptied chunk of the archetype has the same layout
+	if (!world.archetypes[archetype].freeChunks.empty()) {
+		EcsChunk* chunk = world.archetypes[archetype].freeChunks.back();
+		world.archetypes[archetype].freeChunks.pop_back();
+		chunk->count = 0;
+		return chunk;
+	}
+
+	ComponentMask mask = world.archetypes[archetype].mask;
+	EcsChunk* chunk = new EcsChunk();
+	chunk->archetype = archetype;
+	chunk->count = 0;
+
+	size_t offsets[COMPONENT_COUNT];
+	size_t size = 0;
+	for (int component = 0; component < COMPONENT_COUNT; component++) {
+		offsets[component] = size;
+		if (mask & COMPONENT_BIT(component))
+			size += (componentSizes[component] * ECS_CHUNK_CAPACITY + ECS_COMPONENT_ALIGNMENT - 1) & ~(size_t)(ECS_COMPONENT_ALIGNMENT - 1);
+	}
+
+	// storage is never resized, pointers to components stay valid
+	chunk->storage.assign(size + ECS_COMPONENT_ALIGNMENT, 0);
+	unsigned char* base = &chunk->storage[0];
+	base += (ECS_COMPONENT_ALIGNMENT - (size_t)base % ECS_COMPONENT_ALIGNMENT) % ECS_COMPONENT_ALIGNMENT;
+	for (int component = 0; component < COMPONENT_COUNT; component++)
+		chunk->components[component] = (mask & COMPONENT_BIT(component)) ? base + offsets[component] : NULL;
+	return chunk;
+}
+
+// component of row in chunk
+static unsigned char* getRowComponent(const EcsChunk& chunk, int component, int row)
+{
+	return (unsigned char*)chunk.components[component] + row * componentSizes[component];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Empties world, frees all chunks.
+void initEcsWorld(EcsWorld& world)
+{
+	clearEcsWorld(world);
+	for (size_t i = 0; i < world.archetypes.size(); i++)
+		for (size_t chunk = 0; chunk < world.archetypes[i].freeChunks.size(); chunk++)
+			delete world.archetypes[i].freeChunks[chunk];
+	world.archetypes.clear();
+	world.entities.clear();
+	world.firstFreeEntity = NO_FREE_ENTITY;
+}
+
+/// Destroys all entities, chunks are kept for reuse by createEntity().
+void clearEcsWorld(EcsWorld& world)
+{
+	for (size_t i = 0; i < world.archetypes.size(); i++) {
+		Archetype& archetype = world.archetypes[i];
+		archetype.freeChunks.insert(archetype.freeChunks.end(), archetype.chunks.begin(), archetype.chunks.end());
+		archetype.chunks.clear();
+	}
+
+	// all indices are free, generations are kept so old entities stay dead
+	world.firstFreeEntity = NO_FREE_ENTITY;
+	for (size_t index = world.entities.size(); index-- > 0;) {
+		EntityLocation& location = world.entities[index];
+		if (location.chunk != NULL) {
+			location.chunk = NULL;
+			location.generation = (location.generation + 1) & (0xffffffffu >> ENTITY_INDEX_BITS);
+		}
+		location.row = world.firstFreeEntity;
+		world.firstFreeEntity = (int)index;
+	}
+	world.destroyQueue.clear();
+}
+
+/// Creates entity with zeroed components.
+Entity createEntity(EcsWorld& world, ComponentMask mask)
+{
+	int archetypeIndex = findArchetype(world, mask);
+	Archetype& archetype = world.archetypes[archetypeIndex];
+	if (archetype.chunks.empty() || archetype.chunks.back()->count == ECS_CHUNK_CAPACITY)
+		archetype.chunks.push_back(createChunk(world, archetypeIndex));
+	EcsChunk* chunk = archetype.chunks.back();
+
+	int index;
+	if (world.firstFreeEntity != NO_FREE_ENTITY) {
+		index = world.firstFreeEntity;
+		world.firstFreeEntity = world.entities[index].row;
+	}
+	else {
+		index = (int)world.entities.size();
+		assert((unsigned int)index <= ENTITY_INDEX_MASK);
+		EntityLocation location;
+		location.generation = 0;
+		world.entities.push_back(location);
+	}
+
+	int row = chunk->count++;
+	Entity entity = (world.entities[index].generation << ENTITY_INDEX_BITS) | (unsigned int)index;
+	world.entities[index].chunk = chunk;
+	world.entities[index].row = row;
+	chunk->entities[row] = entity;
+	for (int component = 0; component < COMPONENT_COUNT; component++)
+		if (chunk->components[component] != NULL)
+			memset(getRowComponent(*chunk, component, row), 0, componentSizes[component]);
+	return entity;
+}
+
+/// Destroys entity immediately, must not be called while systems run.
+void destroyEntity(EcsWorld& world, Entity entity)
+{
+	if (!isEntityAlive(world, entity))
+		return;
+
+	unsigned int index = entity & ENTITY_INDEX_MASK;
+	EcsChunk* chunk = world.entities[index].chunk;
+	int row = world.entities[index].row;
+
+	// the last entity of the archetype fills the hole
+	Archetype& archetype = world.archetypes[chunk->archetype];
+	EcsChunk* lastChunk = archetype.chunks.back();
+	int lastRow = lastChunk->count - 1;
+	if (lastChunk != chunk || lastRow != row) {
+		for (int component = 0; component < COMPONENT_COUNT; component++)
+			if (chunk->components[component] != NULL)
+				memcpy(getRowComponent(*chunk, component, row), getRowComponent(*lastChunk, component, lastRow), componentSizes[component]);
+		Entity moved = lastChunk->entities[lastRow];
+		chunk->entities[row] = moved;
+		world.entities[moved & ENTITY_INDEX_MASK].chunk = chunk;
+		world.entities[moved & ENTITY_INDEX_MASK].row = row;
+	}
+	if (--lastChunk->count == 0) {
+		archetype.freeChunks.push_back(lastChunk);
+		archetype.chunks.pop_back();
+	}
+
+	EntityLocation& location = world.entities[index];
+	location.chunk = NULL;
+	location.generation = (location.generation + 1) & (0xffffffffu >> ENTITY_INDEX_BITS);
+	location.row = world.firstFreeEntity;
+	world.firstFreeEntity = (int)index;
+}
+
+/// Queues entity for destruction by flushDestroyedEntities(), can be called from systems.
+void deferDestroyEntity(EcsWorld& world, Entity entity)
+{
+	std::lock_guard<std::mutex> lock(world.mutex);
+	world.destroyQueue.push_back(entity);
+}
+
+/// Destroys entities queued by deferDestroyEntity().
+void flushDestroyedEntities(EcsWorld& world)
+{
+	for (size_t i = 0; i < world.destroyQueue.size(); i++)
+		destroyEntity(world, world.destroyQueue[i]);
+	world.destroyQueue.clear();
+}
+
+/// Checks whether entity exists.
+bool isEntityAlive(const EcsWorld& world, Entity entity)
+{
+	unsigned int index = entity & ENTITY_INDEX_MASK;
+	if (entity == INVALID_ENTITY || index >= world.entities.size())
+		return false;
+	const EntityLocation& location = world.entities[index];
+	return location.chunk != NULL && location.generation == (entity >> ENTITY_INDEX_BITS);
+}
+
+/// Component of entity, NULL if the entity does not have it.
+void* getComponent(EcsWorld& world, Entity entity, int component)
+{
+	if (!isEntityAlive(world, entity))
+		return NULL;
+	const EntityLocation& location = world.entities[entity & ENTITY_INDEX_MASK];
+	if (location.chunk->components[component] == NULL)
+		return NULL;
+	return getRowComponent(*location.chunk, component, location.row);
+}
+
+/// Array of component in chunk, NULL if the archetype does not have it.
+void* getChunkComponents(const EcsChunk& chunk, int component)
+{
+	return chunk.components[component];
+}
+
+/// Transform between the previous (\a alpha 0) and the current simulation step (\a alpha 1).
+TransformComponent interpolateTransform(const TransformComponent& transform, float alpha)
+{
+	TransformComponent result = transform;
+	result.position = glm::mix(transform.previousPosition, transform.position, alpha);
+	glm::vec3 direction = glm::mix(transform.previousDirection, transform.direction, alpha);
+	if (glm::dot(direction, direction) > 0.0f)
+		result.direction = glm::normalize(direction);
+	return result;
+}
+
+/// Collects chunks of all archetypes having at least \a required components.
+void queryChunks(EcsWorld& world, ComponentMask required, std::vector<EcsChunk*>& chunks)
+{
+	chunks.clear();
+	for (size_t i = 0; i < world.archetypes.size(); i++)
+		if ((world.archetypes[i].mask & required) == required)
+			chunks.insert(chunks.end(), world.archetypes[i].chunks.begin(), world.archetypes[i].chunks.end());
+}
+
+/// Runs system on chunks with \a required components.
+void runSystem(EcsWorld& world, ComponentMask required, ThreadPool* pool, const std::function<void(EcsChunk&)>& update)
+{
+	std::vector<EcsChunk*> chunks;
+	queryChunks(world, required, chunks);
+	if (chunks.empty())
+		return;
+
+	// the calling thread takes the first chunk, the rest goes to the workers
+	std::mutex mutex;
+	std::condition_variable chunkFinished;
+	int remaining = 0;
+	if (pool != NULL && !pool->workers.empty()) {
+		remaining = (int)chunks.size() - 1;
+		for (size_t i = 1; i < chunks.size(); i++) {
+			EcsChunk* chunk = chunks[i];
+			submitTask(*pool, [chunk, &update, &mutex, &chunkFinished, &remaining]() {
+				update(*chunk);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--remaining == 0)
+					chunkFinished.notify_one();
+			});
+		}
+		update(*chunks[0]);
+	}
+	else {
+		for (size_t i = 0; i < chunks.size(); i++)
+			update(*chunks[i]);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (remaining > 0)
+		chunkFinished.wait(lock);
+}
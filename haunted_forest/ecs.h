@@ -0,0 +1,151 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		ecs.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __ECS_H
+#define __ECS_H
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include "pgr.h"
+#include "thread_pool.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Entity of EcsWorld, index in the low bits and generation of the index in the high bits.
+typedef unsigned int Entity;
+
+#define INVALID_ENTITY 0xffffffffu
+#define ENTITY_INDEX_BITS 20
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+
+/// Component types.
+enum { COMPONENT_TRANSFORM, COMPONENT_MESH, COMPONENT_SPLINE_FOLLOWER, COMPONENT_PARTICLE_EMITTER, COMPONENT_COUNT };
+
+/// Set of component types, bit per COMPONENT_*.
+typedef unsigned int ComponentMask;
+#define COMPONENT_BIT(component) (1u << (component))
+
+// entities stored in one chunk
+#define ECS_CHUNK_CAPACITY 64
+
+/// Placement of entity.
+typedef struct TransformComponent {
+	glm::vec3 position;
+	glm::vec3 direction;
+	float size;
+	glm::vec3 previousPosition;			// at the previous simulation step, drawing interpolates between them
+	glm::vec3 previousDirection;
+} TransformComponent;
+
+/// How the entity is drawn.
+typedef struct MeshComponent {
+	int kind;							// PACKET_*
+	bool visible;
+} MeshComponent;
+
+/// Moves entity along closed Catmull-Rom curve.
+typedef struct SplineFollowerComponent {
+	glm::vec3* curve;					// control points
+	size_t curveSize;
+	float speed;						// curve segments per second
+	float startTime;
+} SplineFollowerComponent;
+
+/// Animated billboard, the entity is destroyed when the animation ends.
+typedef struct ParticleEmitterComponent {
+	float startTime;
+	float currentTime;
+	float frameDuration;				// seconds
+	int texFrames;						// frames of the animation texture
+} ParticleEmitterComponent;
+
+/// Entities of one archetype, each component is stored as array of ECS_CHUNK_CAPACITY elements.
+typedef struct EcsChunk {
+	int archetype;
+	int count;
+	Entity entities[ECS_CHUNK_CAPACITY];
+	void* components[COMPONENT_COUNT];			// arrays in storage, NULL for components missing in the archetype
+	std::vector<unsigned char> storage;
+} EcsChunk;
+
+/// All entities with the same set of components.
+typedef struct Archetype {
+	ComponentMask mask;
+	std::vector<EcsChunk*> chunks;				// all but the last one are full
+	std::vector<EcsChunk*> freeChunks;			// emptied chunks reused before new ones are allocated
+} Archetype;
+
+/// Where entity lives, chunk is NULL for free indices.
+typedef struct EntityLocation {
+	EcsChunk* chunk;
+	int row;									// next free index of free indices
+	unsigned int generation;
+} EntityLocation;
+
+/// Archetype based entity-component storage.
+/**
+Components of entities with the same set of components are packed into chunks, so systems
+iterate over arrays of components one chunk after another and chunks can be updated on
+different threads. Removing entity moves the last entity of its archetype to its place,
+component pointers are therefore valid only until the next removal.
+*/
+typedef struct EcsWorld {
+	std::vector<Archetype> archetypes;
+	std::vector<EntityLocation> entities;
+	int firstFreeEntity;
+	std::mutex mutex;							// guards destroyQueue while systems run
+	std::vector<Entity> destroyQueue;
+} EcsWorld;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Empties world, frees all chunks.
+void initEcsWorld(EcsWorld& world);
+
+/// Destroys all entities, chunks are kept for reuse by createEntity().
+void clearEcsWorld(EcsWorld& world);
+
+/// Creates entity with zeroed components.
+/**
+\param[in,out] world           World.
+\param[in]  mask               Components of the entity, COMPONENT_BIT() of each.
+\return                        New entity.
+*/
+Entity createEntity(EcsWorld& world, ComponentMask mask);
+
+/// Destroys entity immediately, must not be called while systems run.
+void destroyEntity(EcsWorld& world, Entity entity);
+
+/// Queues entity for destruction by flushDestroyedEntities(), can be called from systems.
+void deferDestroyEntity(EcsWorld& world, Entity entity);
+
+/// Destroys entities queued by deferDestroyEntity().
+void flushDestroyedEntities(EcsWorld& world);
+
+/// Checks whether entity exists.
+bool isEntityAlive(const EcsWorld& world, Entity entity);
+
+/// Component of entity, NULL if the entity does not have it.
+void* getComponent(EcsWorld& world, Entity entity, int component);
+
+/// Array of component in chunk, NULL if the archetype does not have it.
+void* getChunkComponents(const EcsChunk& chunk, int component);
+
+/// Transform between the previous (\a alpha 0) and the current simulation step (\a alpha 1).
+TransformComponent interpolateTransform(const TransformComponent& transform, float alpha);
+
+/// Collects chunks of all archetypes having at least \a required components.
+void queryChunks(EcsWorld& world, ComponentMask required, std::vector<EcsChunk*>& chunks);
+
+/// Runs system on chunks with \a required components.
+/**
+\param[in,out] world           World.
+\param[in]  required           Components needed by the system.
+\param[in]  pool               Workers updating chunks in parallel with the calling thread, NULL to update them on the calling thread.
+\param[in]  update             Updates one chunk, must touch only that chunk (use deferDestroyEntity() to remove entities).
+*/
+void runSystem(EcsWorld& world, ComponentMask required, ThreadPool* pool, const std::function<void(EcsChunk&)>& update);
+
+#endif // __ECS_H
@@ -39,38 +39,33 @@ uniform sampler2D texSampler;
 // current material
 uniform Material material;
 
-uniform float time;
-
-// Projection * View * Model  (model to clip coordinates)
-uniform mat4 PVMmatrix;
-
-// View                       (world to eye coordinates)
-uniform mat4 Vmatrix;
-
-// Model                      (model to world coordinates)
-uniform mat4 Mmatrix;
-
-uniform mat4 normalMatrix; // inverse transposed VMmatrix
-
-//fog
-uniform float fogDensity;
-uniform vec4 fogColor;
-uniform bool fogOn;
+// per-frame data shared by all programs (FrameData in render_stuff.h)
+layout(std140) uniform FrameData
+{
+	mat4 Vmatrix;				// View                       --> world to eye coordinates
+	mat4 Pmatrix;				// Projection
+	mat4 PVmatrix;				// Projection * View          --> world to clip coordinates
+	mat4 inversePVmatrix;		// inverse of Projection * View rotation (skybox)
+	vec4 reflectorPosition;		// lights in eye coordinates
+	vec4 reflectorDirection;
+	vec4 pointlightPosition;
+	vec4 fogColor;
+	float fogDensity;
+	float time;					// app elapsed time in seconds
+	bool fogOn;
+	bool sunOn;
+	bool reflectorOn;
+	bool pointlightOn;
+};
 
 //sun
 Light sun;
-uniform bool sunOn;
 
 //point - ghost
 Light pointLighter;
-uniform vec4 pointlightPosition;
-uniform bool pointlightOn;
 
 //flashlight
 Light reflector;
-uniform vec4 reflectorPosition;
-uniform vec3 reflectorDirection;
-uniform bool reflectorOn;
 
 smooth in vec2 texCoord_v;	// fragment texture coordinates
 smooth in vec3 normal_v;	//camera space normal
@@ -96,15 +91,15 @@ void setupLights()
     reflector.spotCosCutOff = 0.95f;
     reflector.spotExponent = 4.0;
 
-    reflector.position = Vmatrix * reflectorPosition;
-    reflector.spotDirection = normalize((Vmatrix * vec4(reflectorDirection, 0.0f)).xyz);
+    reflector.position = reflectorPosition;
+    reflector.spotDirection = reflectorDirection.xyz;
 
 	if (pointlightOn == true) 
 	{
         pointLighter.ambient = vec3(0.05f);
 		pointLighter.diffuse = vec3(0.3f, 0.0f, 0.6f);
         pointLighter.specular = vec3(0.0f);
-        pointLighter.position = (Vmatrix * pointlightPosition);
+        pointLighter.position = pointlightPosition;
     }
 }
 
@@ -189,8 +184,15 @@ void main()
 	color_f = outputColor;
 
 	// texture - modulate object color by the texture
+    vec4 texColor = vec4(1.0f);
     if (material.useTexture)
-        color_f = outputColor * texture(texSampler, texCoord_v);
+    {
+        texColor = texture(texSampler, texCoord_v);
+        color_f = outputColor * texColor;
+    }
+
+	// alpha is coverage, not a sum of lights (impostor atlas is baked with this shader)
+    color_f.a = texColor.a;
    
    	//fog - source: 08_Misc.pdf
     if (fogOn) 
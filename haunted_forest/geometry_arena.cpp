@@ -0,0 +1,262 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		geometry_arena.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cstring>
+#include "geometry_arena.h"
+#include "gl_state.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// appends indices of mesh, adds \a offset to them (rebasing), indices are widened to 32 bits when needed
+static void appendIndices(std::vector<unsigned char>& target, const MeshData& data, unsigned int offset, unsigned int indexSize)
+{
+	size_t start = target.size();
+	target.resize(start + data.numIndices * indexSize);
+
+	if (offset == 0 && indexSize == data.indexSize) {
+		memcpy(&target[start], data.indices, data.numIndices * indexSize);
+		return;
+	}
+
+	for (unsigned int i = 0; i < data.numIndices; i++) {
+		unsigned int index = data.indexSize == sizeof(unsigned short) ? ((const unsigned short*)data.indices)[i] : ((const unsigned int*)data.indices)[i];
+		index += offset;
+		if (indexSize == sizeof(unsigned short))
+			((unsigned short*)&target[start])[i] = (unsigned short)index;
+		else
+			((unsigned int*)&target[start])[i] = index;
+	}
+}
+
+// instance matrix attribute (4 vec4 locations) reads matrices from \a baseInstance on, vao must be bound
+static void setInstancePointers(const GeometryArena& arena, GLuint baseInstance)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, arena.instanceBufferObject);
+	for (int column = 0; column < 4; column++)
+		glVertexAttribPointer(arena.instanceMatrixLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(baseInstance * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Prepares empty arena for meshes of \a vertexFormat (MESH_FORMAT_*). Must be called on the GL thread.
+void initGeometryArena(GeometryArena& arena, unsigned int vertexFormat)
+{
+	arena.vertexArrayObject = 0;
+	arena.vertexBufferObject = 0;
+	arena.elementBufferObject = 0;
+	arena.instanceBufferObject = 0;
+	arena.indirectBufferObject = 0;
+	arena.instanceMatrixLocation = -1;
+	arena.vertexFormat = vertexFormat;
+	arena.vertexStride = vertexFormat == MESH_FORMAT_PACKED ? MESH_PACKED_VERTEX_SIZE : MESH_FLOATS_PER_VERTEX * sizeof(float);
+	arena.numVertices = 0;
+
+	arena.vertices.clear();
+	arena.indices.clear();
+	arena.meshes.clear();
+	clearArenaBatch(arena);
+
+	arena.baseVertex = isGLSupported(3, 2, "GL_ARB_draw_elements_base_vertex");
+	arena.multiDrawIndirect = isGLSupported(4, 3, NULL);
+}
+
+/// Stages mesh, \a geometry gets its place in the arena (its vao is set by uploadGeometryArena()).
+void addArenaMesh(GeometryArena& arena, const MeshData& data, MeshGeometry* geometry)
+{
+	// without base vertex the indices are rebased, 16 bits are kept only while they are enough
+	unsigned int indexSize = data.indexSize;
+	unsigned int offset = 0;
+	if (!arena.baseVertex) {
+		offset = arena.numVertices;
+		if (offset + data.numVertices > 65536)
+			indexSize = sizeof(unsigned int);
+	}
+
+	// offsets of indices must be aligned to their size, all are aligned to 4 bytes
+	arena.indices.resize((arena.indices.size() + 3) & ~(size_t)3);
+
+	geometry->indexType = indexSize == sizeof(unsigned short) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	geometry->firstIndex = (GLuint)(arena.indices.size() / indexSize);
+	geometry->baseVertex = arena.baseVertex ? (GLint)arena.numVertices : 0;
+	geometry->vertexArrayObject = 0;
+
+	// levels of detail follow the full mesh
+	geometry->numLods = (int)data.numLods;
+	GLuint lodFirstIndex = geometry->firstIndex;
+	for (unsigned int lod = 0; lod < data.numLods; lod++) {
+		geometry->lodFirstIndex[lod] = lodFirstIndex;
+		geometry->lodNumTriangles[lod] = data.lodNumIndices[lod] / 3;
+		lodFirstIndex += data.lodNumIndices[lod];
+	}
+	geometry->numTriangles = geometry->lodNumTriangles[0];
+
+	appendIndices(arena.indices, data, offset, indexSize);
+
+	const unsigned char* vertices = (const unsigned char*)data.vertices;
+	arena.vertices.insert(arena.vertices.end(), vertices, vertices + data.numVertices * data.vertexStride);
+	arena.numVertices += data.numVertices;
+	arena.meshes.push_back(geometry);
+}
+
+/// Creates buffers and vao connecting them to \a shader, staged data are released.
+void uploadGeometryArena(GeometryArena& arena, const SCommonShaderProgram& shader)
+{
+	glGenVertexArrays(1, &arena.vertexArrayObject);
+	glBindVertexArray(arena.vertexArrayObject);
+
+	glGenBuffers(1, &arena.vertexBufferObject);
+	glBindBuffer(GL_ARRAY_BUFFER, arena.vertexBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, arena.vertices.size(), arena.vertices.empty() ? NULL : &arena.vertices[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &arena.elementBufferObject);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.elementBufferObject);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indices.size(), arena.indices.empty() ? NULL : &arena.indices[0], GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(shader.posLocation);
+	glVertexAttribPointer(shader.posLocation, 3, GL_FLOAT, GL_FALSE, arena.vertexStride, 0);
+
+	if (arena.vertexFormat == MESH_FORMAT_PACKED) {
+		glEnableVertexAttribArray(shader.texCoordLocation);
+		glVertexAttribPointer(shader.texCoordLocation, 2, GL_HALF_FLOAT, GL_FALSE, arena.vertexStride, (void*)(3 * sizeof(float) + sizeof(GLuint)));
+
+		// normalized to [-1, 1], w component is ignored by vec3 input
+		glEnableVertexAttribArray(shader.normalLocation);
+		glVertexAttribPointer(shader.normalLocation, 4, GL_INT_2_10_10_10_REV, GL_TRUE, arena.vertexStride, (void*)(3 * sizeof(float)));
+	}
+	else {
+		glEnableVertexAttribArray(shader.texCoordLocation);
+		glVertexAttribPointer(shader.texCoordLocation, 2, GL_FLOAT, GL_FALSE, arena.vertexStride, (void*)(6 * sizeof(float)));
+
+		glEnableVertexAttribArray(shader.normalLocation);
+		glVertexAttribPointer(shader.normalLocation, 3, GL_FLOAT, GL_FALSE, arena.vertexStride, (void*)(3 * sizeof(float)));
+	}
+
+	// mat4 attribute = 4 consecutive vec4 locations, advanced once per instance
+	arena.instanceMatrixLocation = shader.instanceMatrixLocation;
+	glGenBuffers(1, &arena.instanceBufferObject);
+	for (int column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(shader.instanceMatrixLocation + column);
+		glVertexAttribDivisor(shader.instanceMatrixLocation + column, 1);
+	}
+	setInstancePointers(arena, 0);
+
+	glBindVertexArray(0);
+
+	if (arena.multiDrawIndirect)
+		glGenBuffers(1, &arena.indirectBufferObject);
+
+	for (size_t i = 0; i < arena.meshes.size(); i++)
+		arena.meshes[i]->vertexArrayObject = arena.vertexArrayObject;
+
+	std::vector<unsigned char>().swap(arena.vertices);
+	std::vector<unsigned char>().swap(arena.indices);
+	CHECK_GL_ERROR();
+}
+
+/// Removes all draws of the batch.
+void clearArenaBatch(GeometryArena& arena)
+{
+	arena.instances.clear();
+	arena.commands.clear();
+	arena.commandMeshes.clear();
+}
+
+/// Adds instanced draw of one level of detail of \a geometry to the batch, returns index of the command (-1 if there are no instances).
+int addArenaBatchDraw(GeometryArena& arena, const MeshGeometry* geometry, int lod, const glm::mat4* modelMatrices, unsigned int count)
+{
+	if (geometry == NULL || count == 0 || lod >= geometry->numLods)
+		return -1;
+
+	DrawElementsIndirectCommand command;
+	command.count = geometry->lodNumTriangles[lod] * 3;
+	command.instanceCount = count;
+	command.firstIndex = geometry->lodFirstIndex[lod];
+	command.baseVertex = geometry->baseVertex;
+	command.baseInstance = (GLuint)arena.instances.size();
+
+	arena.instances.insert(arena.instances.end(), modelMatrices, modelMatrices + count);
+	arena.commands.push_back(command);
+	arena.commandMeshes.push_back(geometry);
+	return (int)arena.commands.size() - 1;
+}
+
+/// Uploads model matrices and commands of the batch.
+void uploadArenaBatch(GeometryArena& arena)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, arena.instanceBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, arena.instances.size() * sizeof(glm::mat4), arena.instances.empty() ? NULL : &arena.instances[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (arena.multiDrawIndirect) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, arena.indirectBufferObject);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, arena.commands.size() * sizeof(DrawElementsIndirectCommand), arena.commands.empty() ? NULL : &arena.commands[0], GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+/// Draws single mesh without instancing, arena vao must be bound.
+void drawArenaMesh(const GeometryArena& arena, const MeshGeometry* geometry)
+{
+	GLuint indexSize = geometry->indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	const void* offset = (const void*)(size_t)(geometry->firstIndex * indexSize);
+
+	if (arena.baseVertex)
+		glDrawElementsBaseVertex(GL_TRIANGLES, geometry->numTriangles * 3, geometry->indexType, offset, geometry->baseVertex);
+	else
+		glDrawElements(GL_TRIANGLES, geometry->numTriangles * 3, geometry->indexType, offset);
+	countDraw(geometry->numTriangles);
+}
+
+/// Draws commands [first, first + count) of the batch, arena vao must be bound and the commands must have the same index type.
+void drawArenaBatch(const GeometryArena& arena, int first, int count)
+{
+	if (first < 0 || count <= 0)
+		return;
+
+	GLenum indexType = arena.commandMeshes[first]->indexType;
+	GLuint indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	if (arena.multiDrawIndirect) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, arena.indirectBufferObject);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*)(first * sizeof(DrawElementsIndirectCommand)), count, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		unsigned int triangles = 0;
+		for (int i = first; i < first + count; i++)
+			triangles += arena.commands[i].count / 3 * arena.commands[i].instanceCount;
+		countDraw(triangles);
+		return;
+	}
+
+	// base instance is emulated by offsetting the instance attribute
+	for (int i = first; i < first + count; i++) {
+		const DrawElementsIndirectCommand& command = arena.commands[i];
+		const void* offset = (const void*)(size_t)(command.firstIndex * indexSize);
+
+		setInstancePointers(arena, command.baseInstance);
+		if (arena.baseVertex)
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, indexType, offset, command.instanceCount, command.baseVertex);
+		else
+			glDrawElementsInstanced(GL_TRIANGLES, command.count, indexType, offset, command.instanceCount);
+		countDraw(command.count / 3 * command.instanceCount);
+	}
+}
+
+/// Deletes GL objects of the arena.
+void destroyGeometryArena(GeometryArena& arena)
+{
+	glDeleteVertexArrays(1, &arena.vertexArrayObject);
+	glDeleteBuffers(1, &arena.vertexBufferObject);
+	glDeleteBuffers(1, &arena.elementBufferObject);
+	glDeleteBuffers(1, &arena.instanceBufferObject);
+	if (arena.indirectBufferObject != 0)
+		glDeleteBuffers(1, &arena.indirectBufferObject);
+
+	arena.vertexArrayObject = 0;
+	arena.vertexBufferObject = 0;
+	arena.elementBufferObject = 0;
+	arena.instanceBufferObject = 0;
+	arena.indirectBufferObject = 0;
+	clearArenaBatch(arena);
+}
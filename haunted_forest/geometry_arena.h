@@ -0,0 +1,96 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		geometry_arena.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __GEOMETRY_ARENA_H
+#define __GEOMETRY_ARENA_H
+
+#include <vector>
+#include "pgr.h"
+#include "render_stuff.h"
+#include "mesh_cache.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Command of glMultiDrawElementsIndirect(), layout is given by OpenGL.
+typedef struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+} DrawElementsIndirectCommand;
+
+/// Vertices and indices of all meshes of one vertex format in shared buffers with one vao.
+/**
+Meshes are staged in CPU memory by addArenaMesh() and uploaded at once by uploadGeometryArena(),
+each mesh remembers its first index and base vertex. Batches of instanced draws read per-draw
+model matrices from the instance buffer, the commands go out through glMultiDrawElementsIndirect
+when available (OpenGL 4.3), one by one otherwise.
+*/
+typedef struct GeometryArena {
+	GLuint vertexArrayObject;
+	GLuint vertexBufferObject;
+	GLuint elementBufferObject;
+	GLuint instanceBufferObject;					// per-draw model matrices of the batch
+	GLuint indirectBufferObject;					// commands of the batch, multi draw indirect only
+	GLint instanceMatrixLocation;
+	unsigned int vertexFormat;
+	unsigned int vertexStride;
+	unsigned int numVertices;
+
+	std::vector<unsigned char> vertices;			// staged until uploadGeometryArena()
+	std::vector<unsigned char> indices;
+	std::vector<MeshGeometry*> meshes;				// get the vao when uploaded
+
+	std::vector<glm::mat4> instances;				// batch
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<const MeshGeometry*> commandMeshes;
+
+	bool baseVertex;								// glDrawElementsBaseVertex (3.2), indices are rebased otherwise
+	bool multiDrawIndirect;							// glMultiDrawElementsIndirect with base instance (4.3)
+} GeometryArena;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Prepares empty arena for meshes of \a vertexFormat (MESH_FORMAT_*). Must be called on the GL thread.
+void initGeometryArena(GeometryArena& arena, unsigned int vertexFormat);
+
+/// Stages mesh, \a geometry gets its place in the arena (its vao is set by uploadGeometryArena()).
+/**
+\param[in,out] arena           Arena which is not uploaded yet.
+\param[in]  data               Mesh in the vertex format of the arena.
+\param[out] geometry           Number of triangles, index type, first index, base vertex and levels of detail are set.
+*/
+void addArenaMesh(GeometryArena& arena, const MeshData& data, MeshGeometry* geometry);
+
+/// Creates buffers and vao connecting them to \a shader, staged data are released.
+void uploadGeometryArena(GeometryArena& arena, const SCommonShaderProgram& shader);
+
+/// Removes all draws of the batch.
+void clearArenaBatch(GeometryArena& arena);
+
+/// Adds instanced draw of one level of detail of \a geometry to the batch.
+/**
+\param[in,out] arena           Arena with the batch.
+\param[in]  geometry           Mesh from the arena.
+\param[in]  lod                Level of detail, 0 is the full mesh.
+\param[in]  modelMatrices      One matrix per instance.
+\param[in]  count              Number of instances.
+\return                        Index of the command, -1 if there are no instances or the mesh does not have the level.
+*/
+int addArenaBatchDraw(GeometryArena& arena, const MeshGeometry* geometry, int lod, const glm::mat4* modelMatrices, unsigned int count);
+
+/// Uploads model matrices and commands of the batch.
+void uploadArenaBatch(GeometryArena& arena);
+
+/// Draws single mesh without instancing, arena vao must be bound.
+void drawArenaMesh(const GeometryArena& arena, const MeshGeometry* geometry);
+
+/// Draws commands [first, first + count) of the batch, arena vao must be bound and the commands must have the same index type.
+void drawArenaBatch(const GeometryArena& arena, int first, int count);
+
+/// Deletes GL objects of the arena.
+void destroyGeometryArena(GeometryArena& arena);
+
+#endif // __GEOMETRY_ARENA_H
@@ -0,0 +1,28 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		geometry_types.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __GEOMETRY_TYPES_H
+#define __GEOMETRY_TYPES_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Axis aligned bounding box.
+typedef struct BoundingBox {
+	glm::vec3 min;
+	glm::vec3 max;
+} BoundingBox;
+
+/// Positions and triangles of mesh, rasterized as occluder and intersected by pick rays.
+/**
+Occluders must not reach outside the drawn mesh, so it is built from the full level of detail.
+*/
+typedef struct PositionMesh {
+	std::vector<glm::vec3> vertices;	// model space
+	std::vector<unsigned int> indices;	// triangles
+} PositionMesh;
+
+#endif // __GEOMETRY_TYPES_H
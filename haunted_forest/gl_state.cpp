@@ -0,0 +1,156 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		gl_state.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cstring>
+#include "gl_state.h"
+
+// value of state not known to the cache
+#define GL_STATE_UNKNOWN 0xffffffffu
+
+static GLStateCache state;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Forgets tracked state, must be called whenever GL state was changed bypassing the cache (e.g. by loading).
+void resetStateCache(void)
+{
+	GLStateStats stats = state.stats;
+
+	state.program = GL_STATE_UNKNOWN;
+	state.vertexArray = GL_STATE_UNKNOWN;
+	state.activeTexture = GL_STATE_UNKNOWN;
+	for (int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+		state.texture2D[unit] = GL_STATE_UNKNOWN;
+		state.textureCubeMap[unit] = GL_STATE_UNKNOWN;
+	}
+	state.blend = -1;
+	state.blendSrc = GL_STATE_UNKNOWN;
+	state.blendDst = GL_STATE_UNKNOWN;
+	state.depthTest = -1;
+
+	state.stats = stats;
+}
+
+/// Starts counting for new frame, returns counts of the previous frame.
+GLStateStats beginStateFrame(void)
+{
+	GLStateStats last = state.stats;
+	memset(&state.stats, 0, sizeof(GLStateStats));
+	return last;
+}
+
+/// Counts of the current frame so far.
+const GLStateStats& getStateStats(void)
+{
+	return state.stats;
+}
+
+/// glUseProgram() if \a program is not current.
+void useProgram(GLuint program)
+{
+	if (state.program == program) {
+		state.stats.programSkipped++;
+		return;
+	}
+	glUseProgram(program);
+	state.program = program;
+	state.stats.programIssued++;
+}
+
+/// glBindVertexArray() if \a vertexArray is not bound.
+void bindVertexArray(GLuint vertexArray)
+{
+	if (state.vertexArray == vertexArray) {
+		state.stats.vertexArraySkipped++;
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	state.vertexArray = vertexArray;
+	state.stats.vertexArrayIssued++;
+}
+
+/// Binds texture to texture unit, \a target is GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP.
+void bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	GLuint& bound = target == GL_TEXTURE_CUBE_MAP ? state.textureCubeMap[unit] : state.texture2D[unit];
+	if (bound == texture) {
+		state.stats.textureSkipped++;
+		return;
+	}
+	if (state.activeTexture != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.activeTexture = unit;
+	}
+	glBindTexture(target, texture);
+	bound = texture;
+	state.stats.textureIssued++;
+}
+
+/// Enables (with given blend function) or disables blending.
+void setBlend(bool enabled, GLenum src, GLenum dst)
+{
+	// blend function does not matter while blending is disabled
+	bool changed = state.blend != (GLint)enabled || (enabled && (state.blendSrc != src || state.blendDst != dst));
+	if (!changed) {
+		state.stats.blendSkipped++;
+		return;
+	}
+
+	if (state.blend != (GLint)enabled) {
+		if (enabled)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+		state.blend = enabled;
+	}
+	if (enabled && (state.blendSrc != src || state.blendDst != dst)) {
+		glBlendFunc(src, dst);
+		state.blendSrc = src;
+		state.blendDst = dst;
+	}
+	state.stats.blendIssued++;
+}
+
+/// Enables or disables depth test.
+void setDepthTest(bool enabled)
+{
+	if (state.depthTest == (GLint)enabled) {
+		state.stats.depthSkipped++;
+		return;
+	}
+	if (enabled)
+		glEnable(GL_DEPTH_TEST);
+	else
+		glDisable(GL_DEPTH_TEST);
+	state.depthTest = enabled;
+	state.stats.depthIssued++;
+}
+
+/// Counts draw call issued by the caller (draws do not go through the cache).
+void countDraw(unsigned int triangles)
+{
+	state.stats.drawCalls++;
+	state.stats.triangles += triangles;
+}
+
+/// Checks that context has at least given version or supports \a extension (may be NULL).
+bool isGLSupported(int major, int minor, const char* extension)
+{
+	GLint contextMajor = 0, contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	if (contextMajor > major || (contextMajor == major && contextMinor >= minor))
+		return true;
+	if (extension == NULL)
+		return false;
+
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; i++) {
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name != NULL && strcmp(name, extension) == 0)
+			return true;
+	}
+	return false;
+}
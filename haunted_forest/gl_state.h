@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		gl_state.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __GL_STATE_H
+#define __GL_STATE_H
+
+#include "pgr.h"
+
+// number of texture units tracked by the cache
+#define GL_STATE_TEXTURE_UNITS 4
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Number of state changes sent to GL and skipped as redundant since beginStateFrame(), draws counted by countDraw().
+typedef struct GLStateStats {
+	unsigned int programIssued;
+	unsigned int programSkipped;
+	unsigned int vertexArrayIssued;
+	unsigned int vertexArraySkipped;
+	unsigned int textureIssued;
+	unsigned int textureSkipped;
+	unsigned int blendIssued;
+	unsigned int blendSkipped;
+	unsigned int depthIssued;
+	unsigned int depthSkipped;
+	unsigned int drawCalls;
+	unsigned int triangles;
+} GLStateStats;
+
+/// Shadow copy of GL state set while drawing.
+/**
+All state changes done while drawing the scene have to go through the functions below,
+otherwise the copy gets out of sync. Values are unknown (GL_STATE_UNKNOWN) after
+resetStateCache(), the first change of each state is then always issued.
+*/
+typedef struct GLStateCache {
+	GLuint program;
+	GLuint vertexArray;
+	GLuint activeTexture;								// unit index, not GL_TEXTUREi enum
+	GLuint texture2D[GL_STATE_TEXTURE_UNITS];
+	GLuint textureCubeMap[GL_STATE_TEXTURE_UNITS];
+	GLint blend;										// -1 unknown, 0 disabled, 1 enabled
+	GLenum blendSrc;
+	GLenum blendDst;
+	GLint depthTest;
+	GLStateStats stats;
+} GLStateCache;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Forgets tracked state, must be called whenever GL state was changed bypassing the cache (e.g. by loading).
+void resetStateCache(void);
+
+/// Starts counting for new frame.
+/**
+\return                        Counts of the previous frame.
+*/
+GLStateStats beginStateFrame(void);
+
+/// Counts of the current frame so far.
+const GLStateStats& getStateStats(void);
+
+/// glUseProgram() if \a program is not current.
+void useProgram(GLuint program);
+
+/// glBindVertexArray() if \a vertexArray is not bound.
+void bindVertexArray(GLuint vertexArray);
+
+/// Binds texture to texture unit, \a target is GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP.
+void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+/// Enables (with given blend function) or disables blending.
+void setBlend(bool enabled, GLenum src = GL_SRC_ALPHA, GLenum dst = GL_ONE_MINUS_SRC_ALPHA);
+
+/// Enables or disables depth test.
+void setDepthTest(bool enabled);
+
+/// Counts draw call issued by the caller (draws do not go through the cache).
+void countDraw(unsigned int triangles);
+
+/// Checks that context has at least given version or supports \a extension (may be NULL).
+bool isGLSupported(int major, int minor, const char* extension);
+
+#endif // __GL_STATE_H
@@ -0,0 +1,48 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file		|		impostor.frag
+*/
+//----------------------------------------------------------------------------------------
+#version 140
+
+// per-frame data shared by all programs (FrameData in render_stuff.h)
+layout(std140) uniform FrameData
+{
+	mat4 Vmatrix;				// View                       --> world to eye coordinates
+	mat4 Pmatrix;				// Projection
+	mat4 PVmatrix;				// Projection * View          --> world to clip coordinates
+	mat4 inversePVmatrix;		// inverse of Projection * View rotation (skybox)
+	vec4 reflectorPosition;		// lights in eye coordinates
+	vec4 reflectorDirection;
+	vec4 pointlightPosition;
+	vec4 fogColor;
+	float fogDensity;
+	float time;					// app elapsed time in seconds
+	bool fogOn;
+	bool sunOn;
+	bool reflectorOn;
+	bool pointlightOn;
+};
+
+uniform sampler2D texSampler;	// impostor atlas, alpha is coverage
+
+smooth in vec2 texCoord_v;
+out vec4 color_f;
+
+void main()
+{
+	color_f = texture(texSampler, texCoord_v);
+
+	// alpha test ~ impostors are drawn with opaque objects and write depth
+	if (color_f.a < 0.5f)
+		discard;
+	color_f.a = 1.0f;
+
+	// fog as in fs.frag, it is not baked
+	if (fogOn)
+	{
+		float fogMode = exp(-pow(fogDensity * abs(gl_FragCoord.z / gl_FragCoord.w), 2.0f));
+		fogMode = 1.0f - clamp(fogMode, 0.0f, 1.0f);
+		color_f = mix(color_f, fogColor, fogMode);
+	}
+}
@@ -0,0 +1,46 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file		|		impostor.vert
+*/
+//----------------------------------------------------------------------------------------
+#version 140
+
+// per-frame data shared by all programs (FrameData in render_stuff.h)
+layout(std140) uniform FrameData
+{
+	mat4 Vmatrix;				// View                       --> world to eye coordinates
+	mat4 Pmatrix;				// Projection
+	mat4 PVmatrix;				// Projection * View          --> world to clip coordinates
+	mat4 inversePVmatrix;		// inverse of Projection * View rotation (skybox)
+	vec4 reflectorPosition;		// lights in eye coordinates
+	vec4 reflectorDirection;
+	vec4 pointlightPosition;
+	vec4 fogColor;
+	float fogDensity;
+	float time;					// app elapsed time in seconds
+	bool fogOn;
+	bool sunOn;
+	bool reflectorOn;
+	bool pointlightOn;
+};
+
+uniform ivec2 atlasTiles;		// views (columns) and meshes (rows of one lighting) in the atlas
+
+in vec2 corner;					// corner of the quad in [-1, 1]
+in vec4 instanceCenter;			// per-instance world center, w = radius of the bounding sphere
+in vec2 instanceTile;			// per-instance view (column) and mesh (row)
+
+smooth out vec2 texCoord_v;
+
+void main()
+{
+	// inverse view rotation as in drawSmoke() ~ the quad faces the camera
+	vec3 right = vec3(Vmatrix[0][0], Vmatrix[1][0], Vmatrix[2][0]);
+	vec3 up = vec3(Vmatrix[0][1], Vmatrix[1][1], Vmatrix[2][1]);
+	vec3 position = instanceCenter.xyz + instanceCenter.w * (corner.x * right + corner.y * up);
+	gl_Position = PVmatrix * vec4(position, 1.0f);
+
+	// rows baked without the sun follow those with the sun
+	vec2 tile = vec2(instanceTile.x, sunOn ? instanceTile.y : instanceTile.y + float(atlasTiles.y));
+	texCoord_v = (tile + 0.5f * (corner + 1.0f)) / vec2(atlasTiles.x, 2 * atlasTiles.y);
+}
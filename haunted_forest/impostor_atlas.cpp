@@ -0,0 +1,153 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		impostor_atlas.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cmath>
+#include "impostor_atlas.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Creates atlas texture for \a numMeshes meshes seen from \a numViews directions, false if it cannot be rendered to.
+bool initImpostorAtlas(ImpostorAtlas& atlas, int numMeshes, int numViews, int tileSize)
+{
+	atlas.numMeshes = numMeshes;
+	atlas.numViews = numViews;
+	atlas.tileSize = tileSize;
+	atlas.instances.clear();
+
+	// rows with the sun and without it
+	glGenTextures(1, &atlas.texture);
+	glBindTexture(GL_TEXTURE_2D, atlas.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, numViews * tileSize, 2 * numMeshes * tileSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &atlas.depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, atlas.depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, numViews * tileSize, 2 * numMeshes * tileSize);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &atlas.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, atlas.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas.texture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, atlas.depthBuffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(1, &atlas.instanceBufferObject);
+	CHECK_GL_ERROR();
+
+	if (!complete) {
+		destroyImpostorAtlas(atlas);
+		return false;
+	}
+	return true;
+}
+
+/// Binds atlas as render target and clears it to transparent black.
+void beginImpostorBake(ImpostorAtlas& atlas)
+{
+	glGetIntegerv(GL_VIEWPORT, atlas.savedViewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, atlas.savedClearColor);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, atlas.framebuffer);
+	glViewport(0, 0, atlas.numViews * atlas.tileSize, 2 * atlas.numMeshes * atlas.tileSize);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/// Sets viewport and camera for rendering one tile.
+void setImpostorTile(const ImpostorAtlas& atlas, int mesh, int view, bool sun, const BoundingBox& bounds, glm::mat4& viewMatrix, glm::mat4& projectionMatrix)
+{
+	int row = sun ? mesh : atlas.numMeshes + mesh;
+	glViewport(view * atlas.tileSize, row * atlas.tileSize, atlas.tileSize, atlas.tileSize);
+
+	// camera circles around the vertical axis, the sphere fits between near and far plane
+	glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+	float radius = 0.5f * glm::length(bounds.max - bounds.min);
+	float angle = 2.0f * 3.14159265f * view / atlas.numViews;
+	glm::vec3 direction = glm::vec3(sinf(angle), 0.0f, cosf(angle));
+
+	viewMatrix = glm::lookAt(center + 2.0f * radius * direction, center, glm::vec3(0.0f, 1.0f, 0.0f));
+	projectionMatrix = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+}
+
+/// Restores the default framebuffer, generates mipmaps of the atlas and deletes the render target.
+void endImpostorBake(ImpostorAtlas& atlas)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(atlas.savedViewport[0], atlas.savedViewport[1], atlas.savedViewport[2], atlas.savedViewport[3]);
+	glClearColor(atlas.savedClearColor[0], atlas.savedClearColor[1], atlas.savedClearColor[2], atlas.savedClearColor[3]);
+
+	glBindTexture(GL_TEXTURE_2D, atlas.texture);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// atlas is not rendered again
+	glDeleteFramebuffers(1, &atlas.framebuffer);
+	glDeleteRenderbuffers(1, &atlas.depthBuffer);
+	atlas.framebuffer = 0;
+	atlas.depthBuffer = 0;
+	CHECK_GL_ERROR();
+}
+
+/// Column of the atlas closest to model space direction from the mesh towards the camera.
+int getImpostorView(const ImpostorAtlas& atlas, const glm::vec3& direction)
+{
+	// same angle as in setImpostorTile()
+	float angle = atan2f(direction.x, direction.z);
+	int view = (int)floorf(angle * atlas.numViews / (2.0f * 3.14159265f) + 0.5f);
+	return ((view % atlas.numViews) + atlas.numViews) % atlas.numViews;
+}
+
+/// Removes all instances.
+void clearImpostorInstances(ImpostorAtlas& atlas)
+{
+	atlas.instances.clear();
+}
+
+/// Instance of distant object.
+ImpostorInstance makeImpostorInstance(int mesh, int view, const glm::vec3& center, float radius)
+{
+	ImpostorInstance instance;
+	instance.center = glm::vec4(center, radius);
+	instance.tile = glm::vec2((float)view, (float)mesh);
+	return instance;
+}
+
+/// Replaces instances by \a count instances copied from \a instances.
+void setImpostorInstances(ImpostorAtlas& atlas, const ImpostorInstance* instances, unsigned int count)
+{
+	atlas.instances.assign(instances, instances + count);
+}
+
+/// Uploads instances to the instance buffer.
+void uploadImpostorInstances(ImpostorAtlas& atlas)
+{
+	if (atlas.texture == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, atlas.instanceBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, atlas.instances.size() * sizeof(ImpostorInstance), atlas.instances.empty() ? NULL : &atlas.instances[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// Deletes GL objects of the atlas.
+void destroyImpostorAtlas(ImpostorAtlas& atlas)
+{
+	if (atlas.framebuffer != 0)
+		glDeleteFramebuffers(1, &atlas.framebuffer);
+	if (atlas.depthBuffer != 0)
+		glDeleteRenderbuffers(1, &atlas.depthBuffer);
+	glDeleteTextures(1, &atlas.texture);
+	glDeleteBuffers(1, &atlas.instanceBufferObject);
+
+	atlas.texture = 0;
+	atlas.framebuffer = 0;
+	atlas.depthBuffer = 0;
+	atlas.instanceBufferObject = 0;
+	atlas.instances.clear();
+}
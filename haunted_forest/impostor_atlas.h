@@ -0,0 +1,90 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		impostor_atlas.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __IMPOSTOR_ATLAS_H
+#define __IMPOSTOR_ATLAS_H
+
+#include <vector>
+#include "pgr.h"
+#include "render_stuff.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// One distant object drawn as camera facing quad, layout of per-instance attributes.
+typedef struct ImpostorInstance {
+	glm::vec4 center;				// world center of the mesh bounds, w = radius of the bounding sphere
+	glm::vec2 tile;					// view (column) and mesh (row) in the atlas
+} ImpostorInstance;
+
+/// Texture with meshes pre-rendered from several directions around their vertical (model y) axis.
+/**
+Each mesh has one row of tiles, each view one column. Rows are baked twice, with the sun in
+the first half of the rows and without it in the second half, other lights are not baked.
+Tiles are rendered by orthographic camera fitted to the bounding sphere of the mesh, so the
+quad of the impostor has the radius of the sphere.
+*/
+typedef struct ImpostorAtlas {
+	GLuint texture;
+	GLuint framebuffer;								// exists only while baking
+	GLuint depthBuffer;
+	GLuint instanceBufferObject;
+	int numMeshes;
+	int numViews;
+	int tileSize;									// pixels
+
+	GLint savedViewport[4];							// restored when baking ends
+	GLfloat savedClearColor[4];
+
+	std::vector<ImpostorInstance> instances;		// drawn by one instanced draw
+} ImpostorAtlas;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Creates atlas texture for \a numMeshes meshes seen from \a numViews directions, false if it cannot be rendered to.
+bool initImpostorAtlas(ImpostorAtlas& atlas, int numMeshes, int numViews, int tileSize);
+
+/// Binds atlas as render target and clears it to transparent black.
+void beginImpostorBake(ImpostorAtlas& atlas);
+
+/// Sets viewport and camera for rendering one tile.
+/**
+\param[in]  atlas              Atlas being baked.
+\param[in]  mesh               Row of the mesh.
+\param[in]  view               Column of the view.
+\param[in]  sun                True for the half of rows lit by the sun.
+\param[in]  bounds             Model space bounds of the mesh.
+\param[out] viewMatrix         View of the tile (model space is world space while baking).
+\param[out] projectionMatrix   Orthographic projection of the bounding sphere.
+*/
+void setImpostorTile(const ImpostorAtlas& atlas, int mesh, int view, bool sun, const BoundingBox& bounds, glm::mat4& viewMatrix, glm::mat4& projectionMatrix);
+
+/// Restores the default framebuffer, generates mipmaps of the atlas and deletes the render target.
+void endImpostorBake(ImpostorAtlas& atlas);
+
+/// Column of the atlas closest to model space direction from the mesh towards the camera.
+int getImpostorView(const ImpostorAtlas& atlas, const glm::vec3& direction);
+
+/// Removes all instances.
+void clearImpostorInstances(ImpostorAtlas& atlas);
+
+/// Instance of distant object.
+/**
+\param[in]  mesh               Row of the mesh.
+\param[in]  view               Column of the view, see getImpostorView().
+\param[in]  center             World center of the mesh bounds.
+\param[in]  radius             World radius of the bounding sphere.
+\return                        Per-instance attributes.
+*/
+ImpostorInstance makeImpostorInstance(int mesh, int view, const glm::vec3& center, float radius);
+
+/// Replaces instances by \a count instances copied from \a instances.
+void setImpostorInstances(ImpostorAtlas& atlas, const ImpostorInstance* instances, unsigned int count);
+
+/// Uploads instances to the instance buffer.
+void uploadImpostorInstances(ImpostorAtlas& atlas);
+
+/// Deletes GL objects of the atlas.
+void destroyImpostorAtlas(ImpostorAtlas& atlas);
+
+#endif // __IMPOSTOR_ATLAS_H
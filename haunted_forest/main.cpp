@@ -7,22 +7,49 @@
 //----------------------------------------------------------------------------------------
 
 #include <time.h>
-#include <list>
+#include <chrono>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <stdlib.h> 
+#include <string.h>
 #include "pgr.h"
 #include "const.h"
 #include "render_stuff.h"
 #include "spline.h"
+#include "culling.h"
+#include "spatial_grid.h"
+#include "poisson_disk.h"
+#include "mesh_cache.h"
+#include "thread_pool.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "occlusion_buffer.h"
+#include "scene_storage.h"
+#include "ecs.h"
+#include "memory_arena.h"
+#include "random.h"
+#include "scene_snapshot.h"
+#include "benchmark.h"
+#include "picking.h"
+#include "impostor_atlas.h"
 
 //set shader uniforms here
 extern SCommonShaderProgram shaderProgram;
 extern SSkyboxShaderProgram skyboxShaderProgram;
 
-typedef std::list<void*> GameObjectsList;
-
-std::vector<glm::vec3> GameObjectsPositions;
+// positions of objects which must not collide
+SpatialGrid gameObjectsGrid;
+// generator of object positions
+PoissonSampler scenePlacement;
+// workers for loading and other parallel work
+ThreadPool workerThreads;
+// one thread running simulation and building of frame packets
+ThreadPool simulationThread;
+// objects freed at once on restart
+MemoryArena sceneMemory;
+// state changes of the last finished frame
+GLStateStats lastFrameStateStats;
 
 //structure for state of app
 struct GameState 
@@ -44,6 +71,13 @@ struct GameState
 	bool ghost;						//if ghost is spawned
 	bool keyMap[KEYS_COUNT];		// map of specail keys
 	float elapsedTime;				// app elapsed time
+	bool cullingDirty;				// still objects were moved, hierarchy for culling must be rebuilt
+	unsigned int seed;				// seed of scene generation, the same seed gives the same layout
+	const char* sceneFile;			// snapshot loaded at start instead of generating the scene (--scene), NULL if none
+	float lastFrameTime;			// real time of the last frame, seconds
+	float simulationAccumulator;	// real time not simulated yet, less than SIMULATION_STEP after each frame
+	float interpolation;			// drawn frame between the previous (0) and the current (1) simulation step
+	bool staticBatchDirty;			// still objects changed their mesh, the batch must be rebuilt
 } gameState;
 
 //Structure of all game objects
@@ -52,31 +86,78 @@ struct GameObjects
 	CameraObject* camera;
 	GroundObject * ground;
 
-	//4 types of tree
-	GameObjectsList trees01;
-	GameObjectsList trees02;
-	GameObjectsList trees03;
-	GameObjectsList trees04;
-
-	//extra object - mushrooms
-	GameObjectsList extra;
-
-	Object * skull;
-	Object * mush;
-	Object * rock;
+	// 4 types of tree, extra objects (mushrooms), skull, mushroom and rock
+	SceneStorage stillObjects;
+	ObjectHandle skull;
+	ObjectHandle mush;
+	ObjectHandle rock;
 	
 	RainObject * rain;
 	FogObject * fog;
-	SmokeObject* smoke;
 
-	//3 flying bats + 1 ghost
-	MovingObject * bat01;
-	MovingObject * bat02;
-	MovingObject * bat03;
-	MovingObject * ghost;
+	// flying bats, ghost and smoke
+	EcsWorld entities;
+	Entity ghost;
+	Entity smoke;
+
+	// generator of all random choices of the scene (placement, directions, sizes)
+	Random random;
 
 } gameObjects;
 
+// hierarchy of still objects for view frustum culling
+Bvh sceneBvh;
+
+// still object which can hide others
+typedef struct OccluderCandidate {
+	unsigned int index;				// dense index in stillObjects
+	float distance;					// from the camera
+} OccluderCandidate;
+
+// the nearest visible trees and the rock are rasterized to the occlusion buffer
+OcclusionBuffer occlusionBuffer;
+
+// benchmark run (--bench)
+typedef struct BenchRun {
+	int frames;						// measured frames, 0 if the application runs normally
+	bool failed;					// report could not be written, the application exits with nonzero status
+	int frame;						// frames rendered so far, including warm-up
+	float startTime;
+	const char* reportFile;
+	BenchTarget target;
+	BenchStats stats;
+} BenchRun;
+
+BenchRun bench;
+
+// everything the GL thread needs to draw one frame, nothing in it changes until the packet is built again
+typedef struct FramePacket {
+	MemoryArena memory;				// transient data of the frame (culling, batch, copies of drawn objects)
+	RenderQueue queue;				// sorted draws
+	FrameData frame;				// per-frame uniforms
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::mat4 inversePVmatrix;		// mouse rays are cast through it
+	bool batchChanged;				// visible still objects changed, the batch is uploaded before drawing
+	StaticBatch batch;
+} FramePacket;
+
+// two stage pipeline ~ the simulation thread builds one packet while the GL thread draws the other one
+typedef struct FramePipeline {
+	FramePacket packets[2];
+	int drawn;						// packet of the last drawn frame
+	bool building;					// the other packet is being built or waits for drawing
+} FramePipeline;
+
+FramePipeline framePipeline;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// camera jumped, it is not interpolated from the previous simulation step
+void snapCamera(void)
+{
+	gameObjects.camera->previousPosition = gameObjects.camera->position;
+	gameObjects.camera->previousDirection = gameObjects.camera->direction;
+}
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // turn camera left 
@@ -105,47 +186,22 @@ void turnCameraRight(float deltaAngle)
 // clean objects
 void cleanUpObjects(void)
 {
-	// delete game objects in list
-	while (!gameObjects.trees01.empty())
-	{
-		delete gameObjects.trees01.back();
-		gameObjects.trees01.pop_back();
-	}
-
-	while (!gameObjects.trees02.empty())
-	{
-		delete gameObjects.trees02.back();
-		gameObjects.trees02.pop_back();
-	}
-
-	while (!gameObjects.trees03.empty())
-	{
-		delete gameObjects.trees03.back();
-		gameObjects.trees03.pop_back();
-	}
+	// still objects, entities and the rest of objects are freed at once, their storage is kept for the next scene
+	clearSceneStorage(gameObjects.stillObjects);
+	clearEcsWorld(gameObjects.entities);
+	resetMemoryArena(sceneMemory);
 
-	while (!gameObjects.trees04.empty())
-	{
-		delete gameObjects.trees04.back();
-		gameObjects.trees04.pop_back();
-	}
-
-	while (!gameObjects.extra.empty())
-	{
-		delete gameObjects.extra.back();
-		gameObjects.extra.pop_back();
-	}
+	clearSpatialGrid(gameObjectsGrid);
 
-	gameObjects.skull = NULL;
-	gameObjects.mush = NULL;
-	gameObjects.rock = NULL;
+	gameObjects.skull = INVALID_OBJECT_HANDLE;
+	gameObjects.mush = INVALID_OBJECT_HANDLE;
+	gameObjects.rock = INVALID_OBJECT_HANDLE;
+	gameObjects.camera = NULL;
+	gameObjects.ground = NULL;
 	gameObjects.rain = NULL;
 	gameObjects.fog = NULL;
-	gameObjects.bat01 = NULL;
-	gameObjects.bat02 = NULL;
-	gameObjects.bat03 = NULL;
-	gameObjects.ghost = NULL;
-	gameObjects.smoke = NULL;
+	gameObjects.ghost = INVALID_ENTITY;
+	gameObjects.smoke = INVALID_ENTITY;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
@@ -157,35 +213,24 @@ bool isCollision(const glm::vec3 positionToCheck)
 	//check for starting camera collision
 	if (gameState.cameraNumber != 0)
 	{
-		glm::vec2 centerCamera = glm::vec2(0.0f, 0.0f);
-		float centerCamDist = sqrt(pow((float)(a.x - centerCamera.x), 2) + pow((float)(a.y - centerCamera.y), 2));
-		if (centerCamDist <= TRESHOLD_RADIUS)
+		if (a.x * a.x + a.y * a.y <= TRESHOLD_RADIUS * TRESHOLD_RADIUS)
 			return true;
 	}
 
 	//check for collision with the rest of the objects in the scene
-	for (std::vector<glm::vec3>::iterator it = GameObjectsPositions.begin(); it != GameObjectsPositions.end(); ++it) 
-	{
-		glm::vec2 b = glm::vec2((*it).x, (*it).y);
-		float distance = sqrt(pow((float)(a.x - b.x), 2) + pow((float)(a.y - b.y), 2));
-		if (distance <= TRESHOLD_RADIUS)
-			return true;
-	}
-	return false;
+	return queryGridRadius(gameObjectsGrid, a, TRESHOLD_RADIUS);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
-// generate random position
-glm::vec3 generateRandomPosition(int type, float tree_size, bool savePosition)
+// generate random position ~ Poisson disk sampling, keeps given distance from other objects
+bool generateRandomPosition(int type, float tree_size, float radius, const glm::vec2& extent, bool savePosition, glm::vec3& newPosition)
 {
-	// position is generated randomly with z being 0.2f ("on ground")
-	// coordinates are in range -4.0f ... 4.0f (x, y)
+	// position is generated with z being 0.2f ("on ground")
+	// coordinates are in range -extent ... extent (x, y)
 
-	glm::vec3 newPosition;
-	do {
-		newPosition = glm::vec3((float)((rand() / (double)(RAND_MAX + 1)) - 4.0f) + (double)(rand() % 8),
-			(float)((rand() / (double)(RAND_MAX + 1)) - 4.0) + (double)(rand() % 8), 0.2f);
-	} while (isCollision(newPosition) == true);
+	glm::vec2 position;
+	bool placed = generatePoissonPosition(scenePlacement, radius, extent, savePosition, position);
+	newPosition = glm::vec3(position, 0.2f);
 
 	switch (type) //depends on what type of tree and its size, change its z coord
 	{
@@ -196,10 +241,8 @@ glm::vec3 generateRandomPosition(int type, float tree_size, bool savePosition)
 		newPosition.z = (float)(tree_size - 0.29); //ofs: -0.08, diff: 0.1
 		break;
 	}
-	
-	if (savePosition)
-		GameObjectsPositions.push_back(newPosition); //save this "unique" position
-	return newPosition;
+
+	return placed;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
@@ -207,7 +250,7 @@ glm::vec3 generateRandomPosition(int type, float tree_size, bool savePosition)
 glm::vec3 generateRandomDirection(void)
 {
 	glm::vec3 newDirection;
-	newDirection = glm::vec3((float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), (float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), 0.0f);
+	newDirection = glm::vec3(randomRange(gameObjects.random, -1.0f, 1.0f), randomRange(gameObjects.random, -1.0f, 1.0f), 0.0f);
 	return newDirection;
 }
 
@@ -215,77 +258,79 @@ glm::vec3 generateRandomDirection(void)
 // generate random size of tree (from 0.2 to 0.5)
 float generaterandomSize(void)
 {
-	float newsize = ((rand() % 4) + 2) / 10.0f;
+	float newsize = (randomBelow(gameObjects.random, 4) + 2) / 10.0f;
 	return newsize;
 }
 
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// add still object to the scene and compute its transform
+ObjectHandle addStillObject(int mesh, const glm::vec3& position, const glm::vec3& direction, float size)
+{
+	SceneStorage& scene = gameObjects.stillObjects;
+	ObjectHandle handle = addSceneObject(scene, mesh, position, direction, size);
+	if (mesh == MESH_ROCK)
+		setRockTransform(scene, getSceneObjectIndex(scene, handle));
+	else
+		setStillObjectTransform(scene, getSceneObjectIndex(scene, handle));
+	return handle;
+}
+
 //----------------------------------------------------------------------------------------
-// create tree objects ~ generates a tree object with random size (0.2f - 0.5f) and position
-Object * createTree(int type)
+// create tree objects ~ generates a tree object with random size (0.2f - 0.5f) and position, INVALID_OBJECT_HANDLE if there is no space left
+ObjectHandle createTree(int type)
 {
-	Object * newTree = new Object;
-	newTree->size = generaterandomSize();
-	newTree->direction = generateRandomDirection();
-	newTree->direction = glm::normalize(newTree->direction);
-	newTree->position = generateRandomPosition(type, newTree->size, true);
-	return newTree;
+	float size = generaterandomSize();
+	glm::vec3 direction = glm::normalize(generateRandomDirection());
+	glm::vec3 position;
+	if (!generateRandomPosition(type, size, TREE_PLACEMENT_RADIUS, glm::vec2(4.0f, 4.0f), true, position))
+		return INVALID_OBJECT_HANDLE;
+	return addStillObject(MESH_TREE01 + type - 1, position, direction, size);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // create skull object
-Object * createSkull(void)
+ObjectHandle createSkull(void)
 {
-	Object * newSkull = new Object;
-	newSkull->size = SKULL_SIZE;
-	newSkull->direction = generateRandomDirection();
-	newSkull->direction = glm::normalize(newSkull->direction);
-	do 	//generate in reachable area
-	{
-		newSkull->position = generateRandomPosition(1, 0, true);
-	} while (fabs(newSkull->position.x) >= (SCENE_WIDTH - 1.0f) || fabs(newSkull->position.y) >= (SCENE_HEIGHT - 1.0f));
-	newSkull->position.z = -0.25f;
-
-	return newSkull;
+	glm::vec3 direction = glm::normalize(generateRandomDirection());
+	glm::vec3 position;
+	//generate in reachable area
+	if (!generateRandomPosition(1, 0, SKULL_PLACEMENT_RADIUS, glm::vec2(SCENE_WIDTH - 1.0f, SCENE_HEIGHT - 1.0f), true, position))
+		std::cerr << "No free space for skull, it may overlap other objects" << std::endl;
+	position.z = -0.25f;
+	return addStillObject(MESH_SKULL, position, direction, SKULL_SIZE);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // create mushroom object AS LAST OBJECT!
-Object * createMushroom(void)
+ObjectHandle createMushroom(void)
 {
-	Object* newMush = new Object;
-	newMush->size = MUSH_SIZE;
-	newMush->direction = generateRandomDirection();
-	newMush->direction = glm::normalize(newMush->direction);
-	do 	//generate in reachable area
-	{
-		newMush->position = generateRandomPosition(1, 0, false); //false - do not save its position
-	} while (fabs(newMush->position.x) >= SCENE_WIDTH || fabs(newMush->position.y) >= SCENE_HEIGHT);
-	newMush->position.z = -0.23f;
-
-	return newMush;
+	glm::vec3 direction = glm::normalize(generateRandomDirection());
+	glm::vec3 position;
+	//generate in reachable area, false - do not save its position
+	if (!generateRandomPosition(1, 0, MUSH_PLACEMENT_RADIUS, glm::vec2(SCENE_WIDTH, SCENE_HEIGHT), false, position))
+		std::cerr << "No free space for mushroom, it may overlap other objects" << std::endl;
+	position.z = -0.23f;
+	return addStillObject(MESH_MUSHROOM, position, direction, MUSH_SIZE);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
-// create extra objects
-Object * createExtra(void)
-{
-	Object * newEx = new Object;
-	newEx->size = EXTRA_OBJECT_SIZE;
-	newEx->direction = generateRandomDirection();
-	newEx->direction = glm::normalize(newEx->direction);
-	do 	//generate in reachable area
-	{
-		newEx->position = generateRandomPosition(1, 0, true); //false - do not save its position
-	} while (fabs(newEx->position.x) >= (SCENE_WIDTH - 1.0f) || fabs(newEx->position.y) >= (SCENE_HEIGHT - 1.0f));
-	newEx->position.z = -0.23f;
-	return newEx;
+// create extra objects, INVALID_OBJECT_HANDLE if there is no space left
+ObjectHandle createExtra(void)
+{
+	glm::vec3 direction = glm::normalize(generateRandomDirection());
+	glm::vec3 position;
+	//generate in reachable area
+	if (!generateRandomPosition(1, 0, EXTRA_PLACEMENT_RADIUS, glm::vec2(SCENE_WIDTH - 1.0f, SCENE_HEIGHT - 1.0f), true, position))
+		return INVALID_OBJECT_HANDLE;
+	position.z = -0.23f;
+	return addStillObject(MESH_EXTRA, position, direction, EXTRA_OBJECT_SIZE);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // create ground object
 GroundObject * createGround(void)
 {
-	GroundObject* newGround = new GroundObject;
+	GroundObject* newGround = arenaNew<GroundObject>(sceneMemory);
 	newGround->position = glm::vec3(0.0f, 0.0f, -0.08f);
 	newGround->viewAngle = 0.0f;
 	newGround->direction = glm::vec3(cos(glm::radians(newGround->viewAngle)), sin(glm::radians(newGround->viewAngle)), 0.0f);
@@ -295,24 +340,22 @@ GroundObject * createGround(void)
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // create rock object
-Object * createRock(void)
+ObjectHandle createRock(void)
 {
-	Object * newRock = new Object;
-	newRock->size = ROCK_SIZE;
-	newRock->direction = generateRandomDirection();
-	do 	//generate in reachable area
-	{
-		newRock->position = generateRandomPosition(1, 0, true); //false - do not save its position
-	} while (fabs(newRock->position.x) >= (SCENE_WIDTH - 1.0f) || fabs(newRock->position.y) >= (SCENE_HEIGHT - 1.0f));
-	newRock->position.z = -0.05f;
-	return newRock;
+	glm::vec3 direction = generateRandomDirection();
+	glm::vec3 position;
+	//generate in reachable area
+	if (!generateRandomPosition(1, 0, ROCK_PLACEMENT_RADIUS, glm::vec2(SCENE_WIDTH - 1.0f, SCENE_HEIGHT - 1.0f), true, position))
+		std::cerr << "No free space for rock, it may overlap other objects" << std::endl;
+	position.z = -0.05f;
+	return addStillObject(MESH_ROCK, position, direction, ROCK_SIZE);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // create rain object
 RainObject* createRain(void)
 {
-	RainObject* newRain = new RainObject;
+	RainObject* newRain = arenaNew<RainObject>(sceneMemory);
 	newRain->size = RAIN_SIZE;
 	newRain->position = gameObjects.camera->position + gameObjects.camera->direction*0.1f;
 	newRain->direction = glm::normalize(gameObjects.camera->position - newRain->position);
@@ -325,7 +368,7 @@ RainObject* createRain(void)
 // create fog object
 FogObject* createFog(void)
 {
-	FogObject* newFog = new FogObject;
+	FogObject* newFog = arenaNew<FogObject>(sceneMemory);
 	newFog->color = glm::vec4(0.53f, 0.13f, 0.13f, 1.0f);
 	newFog->density = FOG_DENSITY;
 	newFog->fogOn = false;
@@ -333,70 +376,76 @@ FogObject* createFog(void)
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
-// Create bat object
-MovingObject * createBat(int type)
+// create entity moving along closed curve
+Entity createCurveFollower(int kind, glm::vec3* curve, size_t curveSize, float speed, float size)
 {
-	MovingObject* newBat = new MovingObject;
-	newBat->position = glm::vec3(0.0f, 0.0f, 0.0f);
-	newBat->initPosition = glm::vec3(0.0f, 1.0f, 0.0f);
-	newBat->viewAngle = 0.0f;
-	newBat->direction = glm::vec3(cos(glm::radians(newBat->viewAngle)), sin(glm::radians(newBat->viewAngle)), 0.0f);
-	//newBat->directionForReflector = glm::vec3(sin(glm::radians(newBat->viewAngle)), 0.0f, -cos(glm::radians(newBat->viewAngle)));
+	Entity entity = createEntity(gameObjects.entities,
+		COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH) | COMPONENT_BIT(COMPONENT_SPLINE_FOLLOWER));
+
+	// starts at the beginning of the curve
+	TransformComponent* transform = (TransformComponent*)getComponent(gameObjects.entities, entity, COMPONENT_TRANSFORM);
+	transform->position = evaluateClosedCurve(curve, curveSize, 0.0f);
+	transform->direction = glm::normalize(evaluateClosedCurve_1stDerivative(curve, curveSize, 0.0f));
+	transform->size = size;
+	transform->previousPosition = transform->position;
+	transform->previousDirection = transform->direction;
+
+	MeshComponent* mesh = (MeshComponent*)getComponent(gameObjects.entities, entity, COMPONENT_MESH);
+	mesh->kind = kind;
+	mesh->visible = true;
+
+	SplineFollowerComponent* follower = (SplineFollowerComponent*)getComponent(gameObjects.entities, entity, COMPONENT_SPLINE_FOLLOWER);
+	follower->curve = curve;
+	follower->curveSize = curveSize;
+	follower->speed = speed;
+	follower->startTime = gameState.elapsedTime;
+	return entity;
+}
 
-	//depending on type, assign its speed and size
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// Create bat object
+Entity createBat(int type)
+{
+	//depending on type, assign its curve, speed and size
 	if (type == 1)
-	{
-		newBat->speed = BAT_SPEED1;
-		newBat->size = BAT_SIZE1;
-	}
+		return createCurveFollower(PACKET_BAT, bat01CurveData, bat01CurveSize, BAT_SPEED1, BAT_SIZE1);
 	else if (type == 2)
-	{
-		newBat->speed = BAT_SPEED2;
-		newBat->size = BAT_SIZE2;
-	}
+		return createCurveFollower(PACKET_BAT, bat02CurveData, bat02CurveSize, BAT_SPEED2, BAT_SIZE2);
 	else
-	{
-		newBat->speed = BAT_SPEED3;
-		newBat->size = BAT_SIZE3;
-	}
-
-	newBat->startTime = gameState.elapsedTime;
-	newBat->currentTime = newBat->startTime;
-	return newBat;
+		return createCurveFollower(PACKET_BAT, bat03CurveData, bat03CurveSize, BAT_SPEED3, BAT_SIZE3);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // Create ghost object
-MovingObject * createGhost(void)
-{
-	MovingObject * newGhost = new MovingObject;
-	newGhost->position = glm::vec3(0.0f, 0.0f, 0.0f);
-	//newGhost->position.z = 0.0f;
-	newGhost->initPosition = glm::vec3(0.0f, 1.0f, 0.0f);
-	//newGhost->initPosition.z = 0.0f;
-	newGhost->viewAngle = 0.0f;
-	newGhost->direction = glm::vec3(cos(glm::radians(newGhost->viewAngle)), sin(glm::radians(newGhost->viewAngle)), 0.0f);
-	newGhost->size = GHOST_SIZE;
-	newGhost->speed = GHOST_SPEED;
-	newGhost->startTime = gameState.elapsedTime;
-	newGhost->currentTime = newGhost->startTime;
-	return newGhost;
+Entity createGhost(void)
+{
+	return createCurveFollower(PACKET_GHOST, ghostCurveData, ghostCurveSize, GHOST_SPEED, GHOST_SIZE);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // Create smoke after clicking on skull
-SmokeObject * createSmoke(const glm::vec3 & position)
+Entity createSmoke(const glm::vec3 & position)
 {
-	SmokeObject * newSmoke = new SmokeObject;
-	newSmoke->position = position;
-	newSmoke->direction = glm::vec3(0.0f, 0.0f, 1.0f);
-	newSmoke->size = SMOKE_SIZE;
-	newSmoke->speed = 0.0f;
-	newSmoke->startTime = gameState.elapsedTime;
-	newSmoke->currentTime = newSmoke->startTime;
-	newSmoke->frameDuration = 0.09f;
-	newSmoke->texFrames = 16;
-	return newSmoke;
+	Entity smoke = createEntity(gameObjects.entities,
+		COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH) | COMPONENT_BIT(COMPONENT_PARTICLE_EMITTER));
+
+	TransformComponent* transform = (TransformComponent*)getComponent(gameObjects.entities, smoke, COMPONENT_TRANSFORM);
+	transform->position = position;
+	transform->direction = glm::vec3(0.0f, 0.0f, 1.0f);
+	transform->size = SMOKE_SIZE;
+	transform->previousPosition = transform->position;
+	transform->previousDirection = transform->direction;
+
+	MeshComponent* mesh = (MeshComponent*)getComponent(gameObjects.entities, smoke, COMPONENT_MESH);
+	mesh->kind = PACKET_SMOKE;
+	mesh->visible = true;
+
+	ParticleEmitterComponent* emitter = (ParticleEmitterComponent*)getComponent(gameObjects.entities, smoke, COMPONENT_PARTICLE_EMITTER);
+	emitter->startTime = gameState.elapsedTime;
+	emitter->currentTime = emitter->startTime;
+	emitter->frameDuration = 0.09f;
+	emitter->texFrames = 16;
+	return smoke;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
@@ -425,18 +474,156 @@ void setupCamera(void)
 		break;
 	}
 	gameState.cameraSetup = false;
+	snapCamera();
 }
 
-// restart
-void restart(void)
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// rebuild the batch of visible still objects in the packet memory ~ after culling or change of extra objects color, GL thread uploads it
+void updateStaticBatch(StaticBatch& batch, MemoryArena& memory)
+{
+	SceneStorage& scene = gameObjects.stillObjects;
+	unsigned int impostorCount = 0;
+	memset(batch.counts, 0, sizeof(batch.counts));
+
+	// levels of detail of visible objects are selected first, distant trees go to the impostors
+	for (unsigned int i = 0; i < getSceneObjectCount(scene); i++) {
+		if (!(scene.flags[i] & OBJECT_VISIBLE))
+			continue;
+
+		int mesh = scene.meshes[i];
+		if (mesh == MESH_EXTRA && gameState.diffColor)
+			mesh = MESH_EXTRA_NEG;
+		int lod = selectObjectLod(scene, i, mesh);
+		if (lod == LOD_IMPOSTOR)
+			impostorCount++;
+		else
+			batch.counts[mesh][lod]++;
+	}
+
+	// then the objects are sorted by mesh and level of detail into arrays of the packet memory
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++) {
+		for (int lod = 0; lod < MESH_MAX_LODS; lod++) {
+			batch.modelMatrices[mesh][lod] = arenaArray<glm::mat4>(memory, batch.counts[mesh][lod]);
+			batch.counts[mesh][lod] = 0;
+		}
+	}
+	batch.impostors = arenaArray<ImpostorInstance>(memory, impostorCount);
+	batch.numImpostors = 0;
+	for (unsigned int i = 0; i < getSceneObjectCount(scene); i++) {
+		if (!(scene.flags[i] & OBJECT_VISIBLE))
+			continue;
+
+		int mesh = scene.meshes[i];
+		if (mesh == MESH_EXTRA && gameState.diffColor)
+			mesh = MESH_EXTRA_NEG;
+		int lod = scene.lods[i];
+		if (lod == LOD_IMPOSTOR) {
+			if (getStaticImpostor(scene, i, mesh, batch.impostors[batch.numImpostors]))
+				batch.numImpostors++;
+		}
+		else
+			batch.modelMatrices[mesh][lod][batch.counts[mesh][lod]++] = scene.transforms[i].modelMatrix;
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// build hierarchy over all still objects
+void buildSceneBvh(MemoryArena& memory)
+{
+	const SceneStorage& scene = gameObjects.stillObjects;
+	unsigned int count = getSceneObjectCount(scene);
+	CullObject* cullObjects = arenaArray<CullObject>(memory, count);
+	for (unsigned int i = 0; i < count; i++) {
+		cullObjects[i].bounds = transformBoundingBox(getMeshBoundingBox(scene.meshes[i]), scene.transforms[i].modelMatrix);
+		cullObjects[i].index = i;
+	}
+	buildBvh(sceneBvh, cullObjects, count);
+}
+
+// trees and the rock can hide other objects
+static bool isOccluderMesh(int mesh)
+{
+	return (mesh >= MESH_TREE01 && mesh <= MESH_TREE04) || mesh == MESH_ROCK;
+}
+
+// candidates ordered from the nearest
+static bool isOccluderCloser(const OccluderCandidate& a, const OccluderCandidate& b)
+{
+	return a.distance < b.distance;
+}
+
+// hides objects left visible by frustum culling which are behind the nearest trees or the rock
+void occludeScene(const glm::mat4& PVmatrix, const glm::vec3& cameraPosition, MemoryArena& memory)
+{
+	SceneStorage& scene = gameObjects.stillObjects;
+	beginOcclusionPass(occlusionBuffer, PVmatrix);
+
+	OccluderCandidate* candidates = arenaArray<OccluderCandidate>(memory, getSceneObjectCount(scene));
+	unsigned int candidateCount = 0;
+	for (unsigned int i = 0; i < getSceneObjectCount(scene); i++) {
+		if (!(scene.flags[i] & OBJECT_VISIBLE) || !isOccluderMesh(scene.meshes[i]))
+			continue;
+		candidates[candidateCount].index = i;
+		candidates[candidateCount].distance = glm::length(scene.positions[i] - cameraPosition);
+		candidateCount++;
+	}
+	OccluderCandidate* occludersEnd = candidates + std::min<unsigned int>(OCCLUSION_OCCLUDERS, candidateCount);
+	std::partial_sort(candidates, occludersEnd, candidates + candidateCount, isOccluderCloser);
+
+	for (OccluderCandidate* it = candidates; it != occludersEnd; ++it) {
+		const PositionMesh* occluder = getMeshPositionMesh(scene.meshes[it->index]);
+		if (occluder != NULL)
+			addOccluder(occlusionBuffer, *occluder, scene.transforms[it->index].modelMatrix);
+	}
+	rasterizeOccluders(occlusionBuffer, &workerThreads);
+
+	for (size_t i = 0; i < sceneBvh.objects.size(); i++) {
+		unsigned int index = sceneBvh.objects[i].index;
+		if ((scene.flags[index] & OBJECT_VISIBLE) && isBoxOccluded(occlusionBuffer, sceneBvh.objects[i].bounds))
+			scene.flags[index] &= ~OBJECT_VISIBLE;
+	}
+}
+
+// view frustum and occlusion culling of still objects, only visible ones are sent to the static batch
+void cullScene(const glm::mat4& PVmatrix, const glm::vec3& cameraPosition, MemoryArena& memory)
+{
+	Frustum frustum;
+	extractFrustum(frustum, PVmatrix);
+	cullBvh(sceneBvh, frustum, gameObjects.stillObjects);
+	if (OCCLUSION_CULLING)
+		occludeScene(PVmatrix, cameraPosition, memory);
+}
+
+// FNV-1a hash of still objects in the order they were generated, equal layouts give equal checksums
+unsigned long long getLayoutChecksum(void)
+{
+	const SceneStorage& scene = gameObjects.stillObjects;
+	unsigned long long hash = 14695981039346656037ull;
+	for (unsigned int i = 0; i < getSceneObjectCount(scene); i++) {
+		const void* fields[] = { &scene.meshes[i], &scene.positions[i], &scene.directions[i], &scene.sizes[i] };
+		const size_t sizes[] = { sizeof(scene.meshes[i]), sizeof(scene.positions[i]), sizeof(scene.directions[i]), sizeof(scene.sizes[i]) };
+		for (int field = 0; field < 4; field++) {
+			const unsigned char* bytes = (const unsigned char*)fields[field];
+			for (size_t byte = 0; byte < sizes[field]; byte++)
+				hash = (hash ^ bytes[byte]) * 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+// empty scene with initial camera, state, bats and ghost, still objects are generated or loaded then
+void startScene(void)
 {
 	cleanUpObjects();
 	gameState.elapsedTime = 0.001f * (float)glutGet(GLUT_ELAPSED_TIME); // milliseconds => seconds
+	gameState.lastFrameTime = gameState.elapsedTime;
+	gameState.simulationAccumulator = 0.0f;
+	gameState.interpolation = 1.0f;
 
 	//setup a new camera
 	gameState.cameraNumber = 0;
 	if (gameObjects.camera == NULL)
-		gameObjects.camera = new CameraObject;
+		gameObjects.camera = arenaNew<CameraObject>(sceneMemory);
 	setupCamera();
 
 	gameState.sunOn = false;
@@ -460,62 +647,171 @@ void restart(void)
 	if (gameObjects.fog == NULL)
 		gameObjects.fog = createFog();
 
-	if (gameObjects.skull == NULL)
+	if (gameObjects.ground == NULL)
+		gameObjects.ground = createGround();
+
+	//create 3 bats
+	for (int type = 1; type <= 3; type++)
+		createBat(type);
+
+	if (!isEntityAlive(gameObjects.entities, gameObjects.ghost))
+		gameObjects.ghost = createGhost();
+
+	//reset map with special keys
+	for (int i = 0; i < KEYS_COUNT; i++)
+		gameState.keyMap[i] = false;
+
+	// still objects will be replaced
+	gameState.cullingDirty = true;
+}
+
+// restart ~ still objects are generated from the seed
+void restart(void)
+{
+	startScene();
+
+	// same seed ~ same layout after every restart, all random choices of the scene come from one generator
+	seedRandom(gameObjects.random, gameState.seed, 0);
+	initPoissonSampler(scenePlacement, &gameObjectsGrid, &gameObjects.random, PLACEMENT_ATTEMPTS);
+
+	if (!isSceneObjectValid(gameObjects.stillObjects, gameObjects.skull))
 		gameObjects.skull = createSkull();
 
-	if (gameObjects.mush == NULL)
+	if (!isSceneObjectValid(gameObjects.stillObjects, gameObjects.mush))
 		gameObjects.mush = createMushroom();
 
-	if (gameObjects.ground == NULL)
-		gameObjects.ground = createGround();
-
-	if (gameObjects.rock == NULL)
+	if (!isSceneObjectValid(gameObjects.stillObjects, gameObjects.rock))
 		gameObjects.rock = createRock();
 
-	// create trees01-04 and put them in list
-	for (int i = 0; i < TREES01_COUNT; i++) {
-		Object * newTree = createTree(1);
-		gameObjects.trees01.push_back(newTree);
-	}
-
-	for (int i = 0; i < TREES02_COUNT; i++) {
-		Object * newTree = createTree(2);
-		gameObjects.trees02.push_back(newTree);
-	}
+	// objects in reachable area first, trees fill the rest
+	for (int i = 0; i < EXTRA_OBJECT_COUNT; i++)
+		createExtra();
+
+	// create trees01-04
+	for (int i = 0; i < TREES01_COUNT; i++)
+		createTree(1);
+	for (int i = 0; i < TREES02_COUNT; i++)
+		createTree(2);
+	for (int i = 0; i < TREES03_COUNT; i++)
+		createTree(3);
+	for (int i = 0; i < TREES04_COUNT; i++)
+		createTree(4);
+
+	std::cout << "scene seed " << gameState.seed << ", layout checksum " << std::hex << getLayoutChecksum() << std::dec << std::endl;
+}
 
-	for (int i = 0; i < TREES03_COUNT; i++) {
-		Object * newTree = createTree(3);
-		gameObjects.trees03.push_back(newTree);
-	}
+// dense index of still object for the snapshot
+static unsigned int getSnapshotIndex(ObjectHandle handle)
+{
+	if (!isSceneObjectValid(gameObjects.stillObjects, handle))
+		return SCENE_SNAPSHOT_NO_OBJECT;
+	return getSceneObjectIndex(gameObjects.stillObjects, handle);
+}
 
-	for (int i = 0; i < TREES04_COUNT; i++) {
-		Object * newTree = createTree(4);
-		gameObjects.trees04.push_back(newTree);
-	}
+// save still objects, seed, camera and toggles
+bool saveScene(const std::string& fileName)
+{
+	SceneSnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	header.seed = gameState.seed;
+	header.toggles = (gameState.sunOn ? SNAPSHOT_SUN_ON : 0) | (gameState.sunForced ? SNAPSHOT_SUN_FORCED : 0)
+		| (gameState.reflectorOn ? SNAPSHOT_REFLECTOR_ON : 0) | (gameState.rain ? SNAPSHOT_RAIN : 0)
+		| (gameState.ghost ? SNAPSHOT_GHOST : 0) | (gameState.diffColor ? SNAPSHOT_DIFF_COLOR : 0)
+		| (gameObjects.fog->fogOn ? SNAPSHOT_FOG_ON : 0);
+	header.randomState = gameObjects.random.state;
+	header.randomIncrement = gameObjects.random.increment;
+	header.layoutChecksum = getLayoutChecksum();
+	header.cameraNumber = gameState.cameraNumber;
+	header.attemptCnt = gameState.attemptCnt;
+	for (int i = 0; i < 3; i++)
+		header.cameraPosition[i] = gameObjects.camera->position[i];
+	header.cameraViewAngle = gameObjects.camera->viewAngle;
+	header.cameraElevationAngle = gameState.cameraElevationAngle;
+	header.skull = getSnapshotIndex(gameObjects.skull);
+	header.mush = getSnapshotIndex(gameObjects.mush);
+	header.rock = getSnapshotIndex(gameObjects.rock);
+
+	if (!writeSceneSnapshot(fileName, header, gameObjects.stillObjects))
+		return false;
+	std::cout << "Scene saved: " << fileName << std::endl;
+	return true;
+}
 
-	for (int i = 0; i < EXTRA_OBJECT_COUNT; i++) {
-		Object * newEx = createExtra();
-		gameObjects.extra.push_back(newEx);
+// replace scene by saved one, nothing is generated
+bool loadScene(const std::string& fileName)
+{
+	SceneSnapshot snapshot;
+	if (!openSceneSnapshot(fileName, snapshot))
+		return false;
+	const SceneSnapshotHeader* header = snapshot.header;
+
+	startScene();
+	gameState.seed = header->seed;
+	gameObjects.random.state = header->randomState;
+	gameObjects.random.increment = header->randomIncrement;
+	initPoissonSampler(scenePlacement, &gameObjectsGrid, &gameObjects.random, PLACEMENT_ATTEMPTS);
+
+	// objects keep their dense order, all but the mushroom are obstacles for collisions and placement
+	for (unsigned int i = 0; i < header->numObjects; i++) {
+		ObjectHandle handle = addStillObject(snapshot.meshes[i], snapshot.positions[i], snapshot.directions[i], snapshot.sizes[i]);
+		if (i == header->skull)
+			gameObjects.skull = handle;
+		if (i == header->mush)
+			gameObjects.mush = handle;
+		else
+			insertIntoGrid(gameObjectsGrid, glm::vec3(snapshot.positions[i].x, snapshot.positions[i].y, 0.0f));
+		if (i == header->rock)
+			gameObjects.rock = handle;
 	}
 
-	//create 3 bats
-	if (gameObjects.bat01 == NULL)
-		gameObjects.bat01 = createBat(1);
-	if (gameObjects.bat02 == NULL)
-		gameObjects.bat02 = createBat(2);
-	if (gameObjects.bat03 == NULL)
-		gameObjects.bat03 = createBat(3);
-
-	if (gameObjects.ghost == NULL)
-		gameObjects.ghost = createGhost();
+	gameState.cameraNumber = header->cameraNumber;
+	gameState.attemptCnt = header->attemptCnt;
+	gameState.sunOn = (header->toggles & SNAPSHOT_SUN_ON) != 0;
+	gameState.sunForced = (header->toggles & SNAPSHOT_SUN_FORCED) != 0;
+	gameState.reflectorOn = (header->toggles & SNAPSHOT_REFLECTOR_ON) != 0;
+	gameState.rain = (header->toggles & SNAPSHOT_RAIN) != 0;
+	gameState.ghost = (header->toggles & SNAPSHOT_GHOST) != 0;
+	gameState.diffColor = (header->toggles & SNAPSHOT_DIFF_COLOR) != 0;
+	gameObjects.fog->fogOn = (header->toggles & SNAPSHOT_FOG_ON) != 0;
+
+	gameObjects.camera->position = glm::vec3(header->cameraPosition[0], header->cameraPosition[1], header->cameraPosition[2]);
+	gameObjects.camera->viewAngle = header->cameraViewAngle;
+	float angle = glm::radians(gameObjects.camera->viewAngle);
+	gameObjects.camera->direction = glm::vec3(cos(angle), sin(angle), 0.0f);
+	gameState.cameraElevationAngle = header->cameraElevationAngle;
+	snapCamera();
+
+	unsigned long long checksum = getLayoutChecksum();
+	if (checksum != header->layoutChecksum)
+		std::cerr << "scene snapshot " << fileName << ": layout checksum does not match" << std::endl;
+	std::cout << "Scene loaded: " << fileName << ", seed " << gameState.seed << ", layout checksum " << std::hex << checksum << std::dec << std::endl;
+	closeSceneSnapshot(snapshot);
+	return true;
+}
 
-	//reset map with special keys
-	for (int i = 0; i < KEYS_COUNT; i++)
-		gameState.keyMap[i] = false;
+// queue draws of visible entities with mesh, entities are copied to the packet memory as they keep moving while the packet is drawn
+void queueEntityDraws(FramePacket& packet)
+{
+	std::vector<EcsChunk*> chunks;
+	queryChunks(gameObjects.entities, COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_MESH), chunks);
+	for (size_t i = 0; i < chunks.size(); i++) {
+		EcsChunk* chunk = chunks[i];
+		const TransformComponent* transforms = (const TransformComponent*)getChunkComponents(*chunk, COMPONENT_TRANSFORM);
+		const MeshComponent* meshes = (const MeshComponent*)getChunkComponents(*chunk, COMPONENT_MESH);
+		const ParticleEmitterComponent* emitters = (const ParticleEmitterComponent*)getChunkComponents(*chunk, COMPONENT_PARTICLE_EMITTER);
+		for (int row = 0; row < chunk->count; row++) {
+			if (!meshes[row].visible)
+				continue;
+			EntityDraw* draw = arenaNew<EntityDraw>(packet.memory);
+			draw->transform = interpolateTransform(transforms[row], gameState.interpolation);
+			draw->emitter = emitters != NULL ? emitters[row] : ParticleEmitterComponent();
+			queueDraw(packet.queue, meshes[row].kind, draw, draw->transform.position);
+		}
+	}
 }
 
-// draw scene, set positions
-void drawWindowContents()
+// set positions, cull and queue the scene into frame packet ~ runs on the simulation thread, no GL calls
+void buildFramePacket(FramePacket& packet)
 {
 	// static viewpoint - top view
 	glm::mat4 orthoViewMatrix = glm::lookAt(
@@ -523,6 +819,9 @@ void drawWindowContents()
 		glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 1.0f, 0.0f));
 
+	// the GL thread has finished drawing this packet, its transient data is not needed anymore
+	resetMemoryArena(packet.memory);
+
 	if (gameState.cameraSetup == true)
 		setupCamera();
 
@@ -534,11 +833,14 @@ void drawWindowContents()
 
 	glm::mat4 projectionMatrix = orthoProjectionMatrix;
 
-	glm::vec3 cameraPosition = gameObjects.camera->position;
-	glm::vec3 cameraCenter = gameObjects.camera->position + gameObjects.camera->direction; //bod na ktery kouka
+	// camera and moving entities are drawn between the last two simulation steps
+	float alpha = gameState.interpolation;
+
+	glm::vec3 cameraPosition = glm::mix(gameObjects.camera->previousPosition, gameObjects.camera->position, alpha);
+	glm::vec3 cameraViewDirection = glm::normalize(glm::mix(gameObjects.camera->previousDirection, gameObjects.camera->direction, alpha));
+	glm::vec3 cameraCenter = cameraPosition + cameraViewDirection; //bod na ktery kouka
 	glm::vec3 cameraUpVector = glm::vec3(0.0f, 0.0f, 1.0f);
 
-	glm::vec3 cameraViewDirection = gameObjects.camera->direction;
 	glm::vec3 rotationAxis = glm::cross(cameraViewDirection, glm::vec3(0.0f, 0.0f, 1.0f)); //vektorovy soucin, osa podle ktere se rotuje
 	glm::mat4 cameraTransform = glm::rotate(glm::mat4(1.0f), -gameState.cameraElevationAngle, rotationAxis); //co, o kolik, podle ktere osy
 
@@ -549,120 +851,100 @@ void drawWindowContents()
 	//vypocitani matic pri otaceni kamerou
 	glm::mat4 viewMatrix = glm::lookAt(cameraPosition, cameraCenter, cameraUpVector); //bod bod vektor
 	projectionMatrix = glm::perspective(60.0f, gameState.windowWidth / (float)gameState.windowHeight, 0.01f, 10.0f);
-
-	glUseProgram(shaderProgram.program);
-	//uniforms of shaderProgram
-	//lights
-	glUniform4fv(shaderProgram.reflectorPositionLocation, 1, glm::value_ptr(glm::vec4(gameObjects.camera->position, 1.0f)));
-	glUniform3fv(shaderProgram.reflectorDirectionLocation, 1, glm::value_ptr(cameraViewDirection));
-	glUniform1i(shaderProgram.reflectorOnLocation, gameState.reflectorOn);
-	glUniform1i(shaderProgram.sunOnLocation, gameState.sunOn);
-	glUniform4fv(shaderProgram.pointlightPositionLocation, 1, glm::value_ptr(glm::vec4( gameObjects.ghost->position, 1.0f)) );
-	glUniform1i(shaderProgram.pointlightOnLocation, gameState.ghost);
-
-	glUniform1i(shaderProgram.fogOnLocation, gameObjects.fog->fogOn);
-	glUniform4fv(shaderProgram.fogColorLocation, 1, glm::value_ptr(gameObjects.fog->color));
-	glUniform1f(shaderProgram.fogDensityLocation, gameObjects.fog->density);
-
-	glUseProgram(0);
-
-	glUseProgram(skyboxShaderProgram.program);
-	//uniforms of skyboxShaderProgram
-	glUniform1i(skyboxShaderProgram.fogOnLocation, gameObjects.fog->fogOn);
-	glUniform4fv(skyboxShaderProgram.fogColorLocation, 1, glm::value_ptr(gameObjects.fog->color));
-	glUniform1f(skyboxShaderProgram.fogDensityLocation, gameObjects.fog->density);
-
-	glUseProgram(0);
-
-	gameObjects.rain->position = gameObjects.camera->position + cameraViewDirection*0.012f;
-	gameObjects.rain->direction = glm::normalize(gameObjects.camera->position - gameObjects.rain->position);
-
-	//draw skybox
-	drawSkybox(viewMatrix, projectionMatrix, gameState.sunOn);
-
-	// draw trees
-	for (GameObjectsList::iterator it = gameObjects.trees01.begin(); it != gameObjects.trees01.end(); ++it) {
-		Object * tree = (Object*)(*it);
-		drawTree(tree, viewMatrix, projectionMatrix, 1);
-	}
-
-	for (GameObjectsList::iterator it = gameObjects.trees02.begin(); it != gameObjects.trees02.end(); ++it) {
-		Object * tree = (Object*)(*it);
-		drawTree(tree, viewMatrix, projectionMatrix, 2);
-	}
-
-	for (GameObjectsList::iterator it = gameObjects.trees03.begin(); it != gameObjects.trees03.end(); ++it) {
-		Object * tree = (Object*)(*it);
-		drawTree(tree, viewMatrix, projectionMatrix, 3);
-	}
-
-	for (GameObjectsList::iterator it = gameObjects.trees04.begin(); it != gameObjects.trees04.end(); ++it) {
-		Object * tree = (Object*)(*it);
-		drawTree(tree, viewMatrix, projectionMatrix, 4);
+	bool viewChanged = setViewProjection(viewMatrix, projectionMatrix);
+	packet.viewMatrix = viewMatrix;
+	packet.projectionMatrix = projectionMatrix;
+	packet.inversePVmatrix = glm::inverse(projectionMatrix * viewMatrix);
+
+	// still objects do not move, culling is needed only if camera or objects have changed
+	if (gameState.cullingDirty) {
+		buildSceneBvh(packet.memory);
+		gameState.cullingDirty = false;
+		viewChanged = true;
 	}
-
-	//draw 3 bats
-	drawBat(gameObjects.bat01, viewMatrix, projectionMatrix);
-	drawBat(gameObjects.bat02, viewMatrix, projectionMatrix);
-	drawBat(gameObjects.bat03, viewMatrix, projectionMatrix);
-	
-	//draw rock
-	drawRock(gameObjects.rock, viewMatrix, projectionMatrix);
-
-	//enable stencil for mouse detection
-	glClearStencil(0);
-	glEnable(GL_STENCIL_TEST);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
-	//draw extra object
-	glStencilFunc(GL_ALWAYS, 3, -1);
-	for (GameObjectsList::iterator it = gameObjects.extra.begin(); it != gameObjects.extra.end(); ++it) {
-		Object * extra = (Object*)(*it);
-		drawExtra(extra, viewMatrix, projectionMatrix, gameState.diffColor);
+	if (viewChanged)
+		cullScene(projectionMatrix * viewMatrix, cameraPosition, packet.memory);
+	packet.batchChanged = viewChanged || gameState.staticBatchDirty;
+	if (packet.batchChanged)
+		updateStaticBatch(packet.batch, packet.memory);
+	gameState.staticBatchDirty = false;
+
+	// per-frame uniforms of all programs ~ lights in eye coordinates, one upload per frame
+	FrameData& frame = packet.frame;
+	frame.reflectorPosition = viewMatrix * glm::vec4(cameraPosition, 1.0f);
+	frame.reflectorDirection = glm::vec4(glm::normalize(glm::vec3(viewMatrix * glm::vec4(cameraViewDirection, 0.0f))), 0.0f);
+	const TransformComponent* ghost = (const TransformComponent*)getComponent(gameObjects.entities, gameObjects.ghost, COMPONENT_TRANSFORM);
+	frame.pointlightPosition = viewMatrix * glm::vec4(interpolateTransform(*ghost, alpha).position, 1.0f);
+	frame.reflectorOn = gameState.reflectorOn;
+	frame.sunOn = gameState.sunOn;
+	frame.pointlightOn = gameState.ghost;
+
+	frame.fogOn = gameObjects.fog->fogOn;
+	frame.fogColor = gameObjects.fog->color;
+	frame.fogDensity = gameObjects.fog->density;
+	frame.time = gameState.elapsedTime;
+	setFrameMatrices(frame, viewMatrix, projectionMatrix);
+
+	gameObjects.rain->position = cameraPosition + cameraViewDirection*0.012f;
+	gameObjects.rain->direction = glm::normalize(cameraPosition - gameObjects.rain->position);
+
+	// collect draws of this frame, the queue orders them by state and depth
+	clearRenderQueue(packet.queue);
+
+	//skybox
+	queueDraw(packet.queue, PACKET_SKYBOX, NULL, cameraPosition, gameState.sunOn);
+
+	// still objects ~ one instanced draw of all visible objects per mesh
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, MESH_TREE01);
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, MESH_TREE02);
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, MESH_TREE03);
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, MESH_TREE04);
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, MESH_ROCK);
+	// distant trees of all meshes ~ one instanced draw of camera facing quads
+	queueDraw(packet.queue, PACKET_IMPOSTOR, NULL, cameraPosition);
+
+	// bats, ghost (shown with its light) and smoke
+	((MeshComponent*)getComponent(gameObjects.entities, gameObjects.ghost, COMPONENT_MESH))->visible = gameState.ghost;
+	queueEntityDraws(packet);
+
+	// objects reacting to mouse clicks
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, gameState.diffColor ? MESH_EXTRA_NEG : MESH_EXTRA);
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, MESH_SKULL);
+	queueDraw(packet.queue, PACKET_STATIC, NULL, cameraPosition, MESH_MUSHROOM);
+
+	//ground and rain are copied, restart or the next simulation step may change them while the packet is drawn
+	GroundObject* ground = arenaNew<GroundObject>(packet.memory);
+	*ground = *gameObjects.ground;
+	queueDraw(packet.queue, PACKET_GROUND, ground, ground->position);
+
+	if (gameState.rain) {
+		RainObject* rain = arenaNew<RainObject>(packet.memory);
+		*rain = *gameObjects.rain;
+		queueDraw(packet.queue, PACKET_RAIN, rain, rain->position);
 	}
 
-	//draw skull
-	glStencilFunc(GL_ALWAYS, 4, -1);
-	drawSkull(gameObjects.skull, viewMatrix, projectionMatrix);
-
-	//draw mushroom
-	glStencilFunc(GL_ALWAYS, 1, -1);
-	drawMushroom(gameObjects.mush, viewMatrix, projectionMatrix);
-	
-	//draw ground
-	glStencilFunc(GL_ALWAYS, 2, -1);
-	drawGround(gameObjects.ground, viewMatrix, projectionMatrix);
-	glDisable(GL_STENCIL_TEST);
-
-	//ghost
-	if (gameState.ghost)
-		drawGhost(gameObjects.ghost, viewMatrix, projectionMatrix);
-	
-	//rain
-	if (gameState.rain)
-		drawRain(gameObjects.rain, viewMatrix, projectionMatrix);
-
-	//smoke
-	glDisable(GL_DEPTH_TEST);
-	if (gameObjects.smoke != NULL)
-		drawSmoke(gameObjects.smoke, viewMatrix, projectionMatrix);
-	glEnable(GL_DEPTH_TEST);
+	sortRenderQueue(packet.queue);
 }
 
-// update the display
-void displayCallback()
+// draw frame packet ~ GL thread
+void drawFramePacket(const FramePacket& packet)
 {
-	GLbitfield mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
-	mask |= GL_STENCIL_BUFFER_BIT;
+	if (packet.batchChanged)
+		uploadStaticBatch(packet.batch);
+	uploadFrameData(packet.frame);
+	submitRenderQueue(packet.queue, packet.viewMatrix, packet.projectionMatrix);
+}
 
-	glClear(mask);
-	drawWindowContents();
-	glutSwapBuffers();
+// waits until the simulation thread is idle ~ game state can be changed by the calling thread then
+void waitForFrameBuild(void)
+{
+	waitThreadPool(simulationThread);
 }
 
 // window resize ~ pixels
 void reshapeCallback(int newWidth, int newHeight)
 {
+	waitForFrameBuild();
 	gameState.windowWidth = newWidth;
 	gameState.windowHeight = newHeight;
 	glViewport(0, 0, (GLsizei)newWidth, (GLsizei)newHeight);
@@ -686,12 +968,39 @@ void lightning(float elapsedTime)
 	}
 }
 
+// system moving entities along their curves
+void updateCurveFollowers(EcsChunk& chunk, float elapsedTime)
+{
+	TransformComponent* transforms = (TransformComponent*)getChunkComponents(chunk, COMPONENT_TRANSFORM);
+	const SplineFollowerComponent* followers = (const SplineFollowerComponent*)getChunkComponents(chunk, COMPONENT_SPLINE_FOLLOWER);
+	for (int row = 0; row < chunk.count; row++) {
+		const SplineFollowerComponent& follower = followers[row];
+		float curveParamT = follower.speed * (elapsedTime - follower.startTime);
+		transforms[row].previousPosition = transforms[row].position;
+		transforms[row].previousDirection = transforms[row].direction;
+		transforms[row].position = evaluateClosedCurve(follower.curve, follower.curveSize, curveParamT);
+		transforms[row].direction = glm::normalize(evaluateClosedCurve_1stDerivative(follower.curve, follower.curveSize, curveParamT));
+	}
+}
+
+// system advancing animated billboards, entity is destroyed after the last frame
+void updateParticleEmitters(EcsChunk& chunk, float elapsedTime)
+{
+	ParticleEmitterComponent* emitters = (ParticleEmitterComponent*)getChunkComponents(chunk, COMPONENT_PARTICLE_EMITTER);
+	for (int row = 0; row < chunk.count; row++) {
+		emitters[row].currentTime = elapsedTime;
+		if (emitters[row].currentTime > emitters[row].startTime + emitters[row].texFrames * emitters[row].frameDuration)
+			deferDestroyEntity(gameObjects.entities, chunk.entities[row]);
+	}
+}
+
 // update objects ~ camera: time * speed, rain, bats and ghost depend on time!
 void updateObjects(float elapsedTime)
 {
 	// update camera
 	float timeDelta = elapsedTime - gameObjects.camera->currentTime;
 	gameObjects.camera->currentTime = elapsedTime;
+	snapCamera();
 	if (gameState.freeCameraMode == true) 
 	{
 		// move forward (W)
@@ -729,60 +1038,224 @@ void updateObjects(float elapsedTime)
 		}
 
 		if (gameState.keyMap[RIGHT] == true)
-			turnCameraRight(VIEW_ANGLE_DELTA);
+			turnCameraRight(VIEW_ANGLE_SPEED * timeDelta);
 		if (gameState.keyMap[LEFT] == true)
-			turnCameraLeft(VIEW_ANGLE_DELTA);
+			turnCameraLeft(VIEW_ANGLE_SPEED * timeDelta);
 	}
 
-	//update bats
-	gameObjects.bat01->currentTime = elapsedTime;
-	float bat01CurveParamT = gameObjects.bat01->speed * (gameObjects.bat01->currentTime - gameObjects.bat01->startTime);
-	gameObjects.bat01->position = evaluateClosedCurve(bat01CurveData, bat01CurveSize, bat01CurveParamT); //+ gameObjects.bat->initPosition;
-	gameObjects.bat01->direction = glm::normalize(evaluateClosedCurve_1stDerivative(bat01CurveData, bat01CurveSize, bat01CurveParamT));
-	
-	gameObjects.bat02->currentTime = elapsedTime;
-	float bat02CurveParamT = gameObjects.bat02->speed * (gameObjects.bat02->currentTime - gameObjects.bat02->startTime);
-	gameObjects.bat02->position = evaluateClosedCurve(bat02CurveData, bat02CurveSize, bat02CurveParamT); 
-	gameObjects.bat02->direction = glm::normalize(evaluateClosedCurve_1stDerivative(bat02CurveData, bat02CurveSize, bat02CurveParamT));
-	
-	gameObjects.bat03->currentTime = elapsedTime;
-	float bat03CurveParamT = gameObjects.bat03->speed * (gameObjects.bat03->currentTime - gameObjects.bat03->startTime);
-	gameObjects.bat03->position = evaluateClosedCurve(bat03CurveData, bat03CurveSize, bat03CurveParamT);
-	gameObjects.bat03->direction = glm::normalize(evaluateClosedCurve_1stDerivative(bat03CurveData, bat03CurveSize, bat03CurveParamT));
-
-	//update ghost
-	gameObjects.ghost->currentTime = elapsedTime;
-	float ghostCurveParamT = gameObjects.ghost->speed * (gameObjects.ghost->currentTime - gameObjects.ghost->startTime);
-	gameObjects.ghost->position = evaluateClosedCurve(ghostCurveData, ghostCurveSize, ghostCurveParamT);
-	gameObjects.ghost->direction = glm::normalize(evaluateClosedCurve_1stDerivative(ghostCurveData, ghostCurveSize, ghostCurveParamT));
+	// bats and ghost follow their curves, chunks of entities are updated in parallel
+	runSystem(gameObjects.entities, COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_SPLINE_FOLLOWER), &workerThreads,
+		[elapsedTime](EcsChunk& chunk) { updateCurveFollowers(chunk, elapsedTime); });
 
 	//DO NOT FORGET UPDATE RAIN!!!!
 	gameObjects.rain->currentTime = elapsedTime;
 	if ((!gameState.sunForced) && gameState.rain)
 		lightning(elapsedTime);
 
-	//update smoke
-	if (gameObjects.smoke != NULL)
+	//update smoke, finished animations are removed
+	runSystem(gameObjects.entities, COMPONENT_BIT(COMPONENT_PARTICLE_EMITTER), &workerThreads,
+		[elapsedTime](EcsChunk& chunk) { updateParticleEmitters(chunk, elapsedTime); });
+	flushDestroyedEntities(gameObjects.entities);
+}
+
+// reacts to clicked still object
+void handlePick(const PickHit& hit)
+{
+	unsigned int index = getSceneObjectIndex(gameObjects.stillObjects, hit.object);
+	switch (gameObjects.stillObjects.meshes[index])
+	{
+	case MESH_MUSHROOM:
 	{
-		gameObjects.smoke->currentTime = elapsedTime;
-		if ( (gameObjects.smoke->currentTime) > (gameObjects.smoke->startTime + gameObjects.smoke->texFrames * gameObjects.smoke->frameDuration) )
-			gameObjects.smoke = NULL;
+		gameState.attemptCnt++;
+		std::cout << "You've found mushroom but it got away!" << std::endl;
+		std::cout << "# of attempt: " << gameState.attemptCnt << std::endl;
+		unsigned int mush = getSceneObjectIndex(gameObjects.stillObjects, gameObjects.mush);
+		glm::vec3 position;
+		if (!generateRandomPosition(1, 0, MUSH_PLACEMENT_RADIUS, glm::vec2(SCENE_WIDTH, SCENE_HEIGHT), false, position)) {
+			std::cerr << "No free space for mushroom, it stays in place" << std::endl;
+			break;
+		}
+		position.z = -0.23f;
+		gameObjects.stillObjects.positions[mush] = position;
+		setStillObjectTransform(gameObjects.stillObjects, mush);
+		gameState.cullingDirty = true;
+		break;
 	}
+	case MESH_EXTRA: //extra object
+	case MESH_EXTRA_NEG:
+		gameState.diffColor = !gameState.diffColor;
+		gameState.staticBatchDirty = true;
+		break;
+	case MESH_SKULL: //skull, spawns a ghost if clicked
+		gameState.ghost = !gameState.ghost;
+		if (!isEntityAlive(gameObjects.entities, gameObjects.smoke))
+		{
+			glm::vec3 smokePosition = gameObjects.stillObjects.positions[getSceneObjectIndex(gameObjects.stillObjects, gameObjects.skull)];
+			smokePosition.z = 0.0f;
+			gameObjects.smoke = createSmoke(smokePosition);
+		}
+		break;
+	default:
+		break;
+	} //end switch
 }
 
-// update scene time
-void timerCallback(int)
+// simulate in fixed steps up to the current time, the rest is left for the next frame and used for interpolation
+void advanceSimulation(float currentTime)
 {
-	gameState.elapsedTime = 0.001f * (float)glutGet(GLUT_ELAPSED_TIME); // milliseconds => seconds
-	updateObjects(gameState.elapsedTime); // update objects in the scene
+	float frameTime = std::min(currentTime - gameState.lastFrameTime, SIMULATION_MAX_FRAME_TIME);
+	gameState.lastFrameTime = currentTime;
+	gameState.simulationAccumulator += frameTime;
+
+	while (gameState.simulationAccumulator >= SIMULATION_STEP) {
+		gameState.elapsedTime += SIMULATION_STEP;
+		updateObjects(gameState.elapsedTime); // update objects in the scene
+		gameState.simulationAccumulator -= SIMULATION_STEP;
+	}
+	gameState.interpolation = gameState.simulationAccumulator / SIMULATION_STEP;
+}
 
-	glutTimerFunc(33, timerCallback, 0);
+// next frame is drawn as soon as the previous one is shown (rate limited only by vsync of the driver)
+void idleCallback(void)
+{
 	glutPostRedisplay();
 }
 
+// camera of the benchmark flies along closed curve, \a time is from the start of the benchmark
+void placeBenchCamera(float time)
+{
+	float curveParamT = BENCH_CAMERA_SPEED * time;
+	glm::vec3 tangent = evaluateClosedCurve_1stDerivative(benchCurveData, benchCurveSize, curveParamT);
+
+	gameObjects.camera->position = evaluateClosedCurve(benchCurveData, benchCurveSize, curveParamT);
+	gameObjects.camera->viewAngle = glm::degrees(atan2(tangent.y, tangent.x));
+	gameObjects.camera->direction = glm::normalize(glm::vec3(tangent.x, tangent.y, 0.0f));
+	gameState.cameraElevationAngle = BENCH_CAMERA_ELEVATION;
+	gameState.cameraSetup = false;
+	snapCamera();
+}
+
+// renders to the offscreen target, the scene is not shown
+void startBench(void)
+{
+	if (!createBenchTarget(bench.target, BENCH_WIDTH, BENCH_HEIGHT))
+		pgr::dieWithError("benchmark framebuffer is not complete");
+	gameState.windowWidth = BENCH_WIDTH;
+	gameState.windowHeight = BENCH_HEIGHT;
+	bench.frame = 0;
+	bench.startTime = gameState.elapsedTime;
+	gameState.interpolation = 1.0f;
+	initBenchStats(bench.stats, bench.frames);
+}
+
+// benchmark frame at \a time ~ camera on its curve, objects updated without fixed steps
+void stepBench(float time)
+{
+	gameState.elapsedTime = time;
+	updateObjects(time);
+	placeBenchCamera(time - bench.startTime);
+}
+
+// simulation and building of packet ~ simulation thread
+void buildFrame(FramePacket& packet, float time)
+{
+	if (bench.frames > 0)
+		stepBench(time);
+	else
+		advanceSimulation(time);
+	buildFramePacket(packet);
+}
+
+// the simulation thread starts building the packet not drawn last, GL thread draws in the meantime
+void startFrameBuild(float time)
+{
+	FramePacket* packet = &framePipeline.packets[1 - framePipeline.drawn];
+	submitTask(simulationThread, [packet, time]() { buildFrame(*packet, time); });
+	framePipeline.building = true;
+}
+
+// packet to draw ~ built during the previous frame, the first one is built right away
+FramePacket& takeFramePacket(float time)
+{
+	if (!framePipeline.building)
+		startFrameBuild(time);
+	waitForFrameBuild();
+	framePipeline.building = false;
+	framePipeline.drawn = 1 - framePipeline.drawn;
+	return framePipeline.packets[framePipeline.drawn];
+}
+
+// update the display ~ the packet of the previous frame is drawn while the next one is built
+void displayCallback()
+{
+	float time = 0.001f * (float)glutGet(GLUT_ELAPSED_TIME); // milliseconds => seconds
+	FramePacket& packet = takeFramePacket(time);
+	startFrameBuild(time);
+
+	lastFrameStateStats = beginStateFrame();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	drawFramePacket(packet);
+	glutSwapBuffers();
+}
+
+// time of benchmark frame
+float benchTime(int frame)
+{
+	return bench.startTime + frame * BENCH_FRAME_TIME;
+}
+
+// writes report and quits
+void finishBench(void)
+{
+	waitForFrameBuild();
+	framePipeline.building = false;
+
+	BenchInfo info;
+	info.seed = gameState.seed;
+	info.layoutChecksum = getLayoutChecksum();
+	info.width = bench.target.width;
+	info.height = bench.target.height;
+	info.warmupFrames = BENCH_WARMUP_FRAMES;
+	bench.failed = !writeBenchReport(bench.reportFile, bench.stats, info);
+
+	std::cout << "benchmark: " << bench.frames << " frames, p50 " << getPercentile(bench.stats.frameTimes, 50.0f)
+		<< " ms, p99 " << getPercentile(bench.stats.frameTimes, 99.0f) << " ms" << std::endl;
+	destroyBenchTarget(bench.target);
+	bench.frames = 0;
+	glutLeaveMainLoop();
+}
+
+// one benchmark frame as soon as the previous one is finished, time advances by BENCH_FRAME_TIME
+void benchIdleCallback(void)
+{
+	if (bench.frames == 0)
+		return;
+	if (bench.frame == BENCH_WARMUP_FRAMES + bench.frames) {
+		finishBench();
+		return;
+	}
+
+	// frame time covers waiting for the packet and drawing until GL has finished the frame, the next packet is built meanwhile
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	FramePacket& packet = takeFramePacket(benchTime(bench.frame));
+	startFrameBuild(benchTime(bench.frame + 1));
+	glBindFramebuffer(GL_FRAMEBUFFER, bench.target.framebuffer);
+	glViewport(0, 0, bench.target.width, bench.target.height);
+	beginStateFrame();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	drawFramePacket(packet);
+	glFinish();
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	if (bench.frame >= BENCH_WARMUP_FRAMES)
+		addBenchFrame(bench.stats, elapsed.count(), getStateStats());
+	bench.frame++;
+}
+
 // mouse moving ~ turn camera left/right
 void passiveMouseMotionCallback(int mouseX, int mouseY)
 {
+	waitForFrameBuild();
 	//mouse has to always be in the center of window
 	if (mouseY != gameState.windowHeight / 2) {
 
@@ -812,6 +1285,7 @@ void passiveMouseMotionCallback(int mouseX, int mouseY)
 // key pressed ~ 27: call glutLeaveMainLoop() to exit the program
 void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY)
 {
+	waitForFrameBuild();
 	switch (keyPressed) {
 	case 27: //ESC (ASCII value 27)
 		glutLeaveMainLoop();
@@ -858,6 +1332,18 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY)
 		gameState.reflectorOn = !gameState.reflectorOn;
 		break;
 
+	// print GL state changes of the last frame (issued/skipped) and the last occlusion culling
+	case 'i':
+		std::cout << "program " << lastFrameStateStats.programIssued << "/" << lastFrameStateStats.programSkipped
+			<< ", vao " << lastFrameStateStats.vertexArrayIssued << "/" << lastFrameStateStats.vertexArraySkipped
+			<< ", texture " << lastFrameStateStats.textureIssued << "/" << lastFrameStateStats.textureSkipped
+			<< ", blend " << lastFrameStateStats.blendIssued << "/" << lastFrameStateStats.blendSkipped
+			<< ", depth " << lastFrameStateStats.depthIssued << "/" << lastFrameStateStats.depthSkipped << std::endl;
+		std::cout << "occlusion: " << occlusionBuffer.stats.occluded << "/" << occlusionBuffer.stats.tested << " objects culled, "
+			<< occlusionBuffer.stats.occluders << " occluders, " << occlusionBuffer.stats.triangles << " triangles, "
+			<< occlusionBuffer.stats.rasterTime << " ms" << std::endl;
+		break;
+
 	// move forward
 	case 'w':
 		gameState.keyMap[UP] = true;
@@ -882,6 +1368,7 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY)
 // key release
 void keyboardUpCallback(unsigned char keyPressed, int mouseX, int mouseY)
 {
+	waitForFrameBuild();
 	switch (keyPressed) {
 	case 'w':
 		gameState.keyMap[UP] = false;
@@ -902,13 +1389,17 @@ void keyboardUpCallback(unsigned char keyPressed, int mouseX, int mouseY)
 // special key pressed - ghost appears, restart
 void specialKeyboardCallback(int specKeyPressed, int mouseX, int mouseY)
 {
+	waitForFrameBuild();
 	if (specKeyPressed == GLUT_KEY_F1) gameState.ghost = !gameState.ghost;
 	if (specKeyPressed == GLUT_KEY_F2) restart();
+	if (specKeyPressed == GLUT_KEY_F5) saveScene(SCENE_SNAPSHOT_FILE);
+	if (specKeyPressed == GLUT_KEY_F9) loadScene(SCENE_SNAPSHOT_FILE);
 }
 
 // reaction on menu item
 void menu(int choice)
 {
+	waitForFrameBuild();
 	switch (choice) {
 	case 1:
 		restart();
@@ -1012,107 +1503,138 @@ void createMenu(void)
 	glutAttachMenu(GLUT_RIGHT_BUTTON);
 }
 
-// mouse is clicked ~ reads from stencil buffer
+// mouse is clicked ~ casts ray into the scene
 void mouseCallback(int buttonPressed, int buttonState, int mouseX, int mouseY)
 {
+	waitForFrameBuild();
 	if ((buttonPressed == GLUT_LEFT_BUTTON) && (buttonState == GLUT_DOWN)) {
-		// stores value from the stencil buffer (byte)
-		unsigned char objectID = 0;
+		// ray through the clicked pixel of the last drawn frame, the nearest still object or the ground is hit
 		int y = gameState.windowHeight - mouseY - 1; //otocene Y [0,0] v levem hornim rohu (jeste -1!!!!)
-		glReadPixels(mouseX, y, 1, 1, GL_STENCIL_INDEX, GL_BYTE, &objectID);
-		//GLfloat depth = 0.0f;
-		//glReadPixels(mouseX, mouseY, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
-
-		int res;
-
-		switch (objectID)
-		{
-		case 1: //mushroom
-			gameState.attemptCnt++;
-			std::cout << "You've found mushroom but it got away!" << std::endl;
-			std::cout << "# of attempt: " << gameState.attemptCnt << std::endl;
-			gameObjects.mush->position = generateRandomPosition(1, 0, false);
-			do 	//generate in reachable area
-			{
-				gameObjects.mush->position = generateRandomPosition(1, 0, false);
-			} while (fabs(gameObjects.mush->position.x) >= SCENE_WIDTH || fabs(gameObjects.mush->position.y) >= SCENE_HEIGHT);
-			gameObjects.mush->position.z = -0.23f;
-			break;
-		case 2: //ground
-			std::cout << "You've clicked on this particular place." << std::endl;
-			break;
-		case 3: //extra object
-			gameState.diffColor = !gameState.diffColor;
-			break;
-		case 4: //skull, spawns a ghost if clicked
-			gameState.ghost = !gameState.ghost;
-			if (gameObjects.smoke == NULL)
-			{
-				glm::vec3 smokePosition = gameObjects.skull->position;
-				smokePosition.z = 0.0f;
-				gameObjects.smoke = createSmoke(smokePosition);
-			}
-			break;
-		default:
-			break;
-		} //end switch
+		PickRay ray = makePickRay(framePipeline.packets[framePipeline.drawn].inversePVmatrix, mouseX, y, gameState.windowWidth, gameState.windowHeight);
+
+		PickHit hit;
+		pickStillObject(sceneBvh, gameObjects.stillObjects, ray, 1.0f, hit);
+		const PositionMesh* groundMesh = getGroundPositionMesh();
+		float groundDistance;
+		if (groundMesh != NULL && intersectRayMesh(ray, *groundMesh, getGroundModelMatrix(gameObjects.ground), hit.distance, groundDistance)) {
+			glm::vec3 point = ray.origin + groundDistance * ray.direction;
+			std::cout << "You've clicked on this particular place (" << point.x << ", " << point.y << ")." << std::endl;
+		}
+		else if (hit.object != INVALID_OBJECT_HANDLE)
+			handlePick(hit);
 	} //end if
 }
 
 // inicialize whole application
 void initializeApplication()
 {
-	// initialize random seed
-	srand((unsigned int)time(NULL));
+	initSpatialGrid(gameObjectsGrid, TRESHOLD_RADIUS);
+	initThreadPool(workerThreads, 0);
+	initThreadPool(simulationThread, 1);
+	initOcclusionBuffer(occlusionBuffer, OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+	initMemoryArena(sceneMemory, SCENE_MEMORY_SIZE);
+	for (int i = 0; i < 2; i++)
+		initMemoryArena(framePipeline.packets[i].memory, FRAME_MEMORY_SIZE);
+	framePipeline.drawn = 0;
+	framePipeline.building = false;
 
 	// initialize OpenGL
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 	glEnable(GL_DEPTH_TEST);
-	glClearStencil(0);
 
 	// initialize shaders
 	initializeShaderPrograms();
 	// create geometry for all models used
-	initializeModels();
+	initializeModels(workerThreads);
 
 	gameObjects.fog = NULL;
-	gameObjects.skull = NULL;
-	gameObjects.mush = NULL;
+	initSceneStorage(gameObjects.stillObjects);
+	gameObjects.skull = INVALID_OBJECT_HANDLE;
+	gameObjects.mush = INVALID_OBJECT_HANDLE;
+	gameObjects.rock = INVALID_OBJECT_HANDLE;
 	gameObjects.camera = NULL;
-	gameObjects.bat01 = NULL;
-	gameObjects.bat02 = NULL;
-	gameObjects.bat03 = NULL;
-	gameObjects.ghost = NULL;
-	gameObjects.smoke = NULL;
+	initEcsWorld(gameObjects.entities);
+	gameObjects.ghost = INVALID_ENTITY;
+	gameObjects.smoke = INVALID_ENTITY;
 
 	gameState.sunOn = false;
 	gameState.reflectorOn = false;
-	restart();
+	if (gameState.sceneFile == NULL || !loadScene(gameState.sceneFile))
+		restart();
 }
 
 // finalize whole application
 void finalizeApplication(void)
 {
+	// simulation thread is stopped first, it may be building a packet
+	destroyThreadPool(simulationThread);
 	cleanUpObjects();
-	delete gameObjects.camera;
-	gameObjects.camera = NULL;
+	destroyMemoryArena(sceneMemory);
+	for (int i = 0; i < 2; i++)
+		destroyMemoryArena(framePipeline.packets[i].memory);
 
 	// delete buffers 
 	clearModels();
 
 	// delete shaders
 	cleanupShaderPrograms();
+
+	destroyThreadPool(workerThreads);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
+// models converted to cooked meshes by --cook
+const char* const cookedModels[] = {
+	TREE_MODEL_01, TREE_MODEL_02, TREE_MODEL_03, TREE_MODEL_04,
+	EXTRA_OBJECT_MODEL, EXTRANEG_OBJECT_MODEL, SKULL_MODEL, MUSHROOM_MODEL, BAT_MODEL, GHOST_MODEL
+};
+
 int main(int argc, char** argv)
 {
+	// offline conversion of models, no window or GL context is needed
+	if (argc > 1 && strcmp(argv[1], "--cook") == 0)
+		return cookMeshes(cookedModels, sizeof(cookedModels) / sizeof(cookedModels[0])) == 0 ? 0 : 1;
+	// self-test of the scene generator, layouts depend on it being identical on every build
+	if (argc > 1 && strcmp(argv[1], "--check-random") == 0) {
+		bool matches = checkRandom();
+		std::cout << "PCG32 reference sequence " << (matches ? "matches" : "does not match") << std::endl;
+		return matches ? 0 : 1;
+	}
+
+	// --seed N selects the scene layout, --scene FILE loads saved one, --bench N measures N frames (report to --bench-report FILE)
+	gameState.seed = SCENE_SEED;
+	gameState.sceneFile = NULL;
+	bench.frames = 0;
+	bench.failed = false;
+	bench.reportFile = BENCH_REPORT_FILE;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--seed") == 0)
+			gameState.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--scene") == 0)
+			gameState.sceneFile = argv[++i];
+		else if (strcmp(argv[i], "--bench") == 0) {
+			bench.frames = atoi(argv[++i]);
+			if (bench.frames <= 0) {
+				std::cerr << "--bench needs a positive number of frames" << std::endl;
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--bench-report") == 0) {
+			// standard output carries the log, the report always goes to a file
+			bench.reportFile = argv[++i];
+			if (strcmp(bench.reportFile, "-") == 0) {
+				std::cerr << "--bench-report needs a file name" << std::endl;
+				return 1;
+			}
+		}
+	}
+
 	// initialize windowing system
 	glutInit(&argc, argv);
 
 	glutInitContextVersion(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR);
 	glutInitContextFlags(GLUT_FORWARD_COMPATIBLE);
-	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH | GLUT_STENCIL);
+	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
 
 	// initial window size
 	glutInitWindowSize(WIDTH, HEIGHT);
@@ -1120,23 +1642,36 @@ int main(int argc, char** argv)
 	//glutPositionWindow(0, 0);
 
 	glutDisplayFunc(displayCallback);
-	// register callback for change of window size
-	glutReshapeFunc(reshapeCallback);
 	// register callbacks for keyboard
 	glutKeyboardFunc(keyboardCallback);
 	glutKeyboardUpFunc(keyboardUpCallback);
 	glutSpecialFunc(specialKeyboardCallback);
 	glutMouseFunc(mouseCallback);
 	createMenu();
-	glutTimerFunc(33, timerCallback, 0);
+
+	// benchmark renders frames back to back from idle callback, the window stays hidden and its size does not affect the offscreen target
+	// (a display server is still needed for the GL context, Xvfb on headless machines)
+	if (bench.frames > 0) {
+		// main loop returns after the report so the exit status can tell whether it was written
+		glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+		glutHideWindow();
+		glutIdleFunc(benchIdleCallback);
+	}
+	else {
+		// register callback for change of window size
+		glutReshapeFunc(reshapeCallback);
+		glutIdleFunc(idleCallback);
+	}
 
 	// initialize GL
 	if (!pgr::initialize(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR))
 		pgr::dieWithError("pgr init failed, required OpenGL not supported?");
 
 	initializeApplication();
+	if (bench.frames > 0)
+		startBench();
 	glutCloseFunc(finalizeApplication);
 	glutMainLoop();
 
-	return 0;
+	return bench.failed ? 1 : 0;
 }
@@ -0,0 +1,106 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mapped_file.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Sets file to closed state (nothing mapped).
+void initMappedFile(MappedFile& file)
+{
+	file.data = NULL;
+	file.size = 0;
+#ifdef _WIN32
+	file.fileHandle = NULL;
+	file.mappingHandle = NULL;
+#else
+	file.fileDescriptor = -1;
+#endif
+}
+
+/// Maps whole file to memory.
+bool openMappedFile(MappedFile& file, const std::string& fileName)
+{
+	initMappedFile(file);
+
+#ifdef _WIN32
+	file.fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file.fileHandle == INVALID_HANDLE_VALUE) {
+		file.fileHandle = NULL;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file.fileHandle, &size) || size.QuadPart == 0) {
+		closeMappedFile(file);
+		return false;
+	}
+
+	file.mappingHandle = CreateFileMappingA(file.fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (file.mappingHandle == NULL) {
+		closeMappedFile(file);
+		return false;
+	}
+
+	file.data = (const unsigned char*)MapViewOfFile(file.mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (file.data == NULL) {
+		closeMappedFile(file);
+		return false;
+	}
+	file.size = (size_t)size.QuadPart;
+#else
+	file.fileDescriptor = open(fileName.c_str(), O_RDONLY);
+	if (file.fileDescriptor < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(file.fileDescriptor, &info) != 0 || info.st_size == 0) {
+		closeMappedFile(file);
+		return false;
+	}
+
+	void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file.fileDescriptor, 0);
+	if (data == MAP_FAILED) {
+		closeMappedFile(file);
+		return false;
+	}
+	file.data = (const unsigned char*)data;
+	file.size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+/// Unmaps file, data pointer is no longer valid. Can be called on closed or initialized file.
+void closeMappedFile(MappedFile& file)
+{
+#ifdef _WIN32
+	if (file.data != NULL)
+		UnmapViewOfFile(file.data);
+	if (file.mappingHandle != NULL)
+		CloseHandle(file.mappingHandle);
+	if (file.fileHandle != NULL)
+		CloseHandle(file.fileHandle);
+	file.mappingHandle = NULL;
+	file.fileHandle = NULL;
+#else
+	if (file.data != NULL)
+		munmap((void*)file.data, file.size);
+	if (file.fileDescriptor >= 0)
+		close(file.fileDescriptor);
+	file.fileDescriptor = -1;
+#endif
+	file.data = NULL;
+	file.size = 0;
+}
@@ -0,0 +1,40 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mapped_file.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __MAPPED_FILE_H
+#define __MAPPED_FILE_H
+
+#include <string>
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Read only file mapped to memory.
+typedef struct MappedFile {
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+} MappedFile;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Sets file to closed state (nothing mapped).
+void initMappedFile(MappedFile& file);
+
+/// Maps whole file to memory.
+/**
+\param[out] file               Mapping, data is NULL if the file could not be mapped.
+\param[in]  fileName           File to map.
+\return                        True on success.
+*/
+bool openMappedFile(MappedFile& file, const std::string& fileName);
+
+/// Unmaps file, data pointer is no longer valid. Can be called on closed or initialized file.
+void closeMappedFile(MappedFile& file);
+
+#endif // __MAPPED_FILE_H
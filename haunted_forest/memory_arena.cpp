@@ -0,0 +1,78 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		memory_arena.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cassert>
+#include "memory_arena.h"
+
+// sizes of blocks are rounded up to multiple of this
+#define MEMORY_ARENA_GRANULARITY 4096
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// value rounded up to multiple of alignment (power of two)
+static size_t alignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Allocates block of the arena.
+void initMemoryArena(MemoryArena& arena, size_t capacity)
+{
+	arena.capacity = alignUp(capacity, MEMORY_ARENA_GRANULARITY);
+	arena.memory = (unsigned char*)::operator new(arena.capacity);
+	arena.used = 0;
+	arena.overflowSize = 0;
+	arena.peak = 0;
+	arena.overflow.clear();
+}
+
+/// Frees all memory of the arena.
+void destroyMemoryArena(MemoryArena& arena)
+{
+	resetMemoryArena(arena);
+	::operator delete(arena.memory);
+	arena.memory = NULL;
+	arena.capacity = 0;
+}
+
+/// Frees all allocations at once, grows the block if the overflow was used.
+void resetMemoryArena(MemoryArena& arena)
+{
+	if (!arena.overflow.empty()) {
+		for (size_t i = 0; i < arena.overflow.size(); i++)
+			::operator delete(arena.overflow[i]);
+		arena.overflow.clear();
+
+		// next time everything fits into the block
+		::operator delete(arena.memory);
+		arena.capacity = alignUp(arena.used + arena.overflowSize + arena.overflowSize / 2, MEMORY_ARENA_GRANULARITY);
+		arena.memory = (unsigned char*)::operator new(arena.capacity);
+	}
+	arena.used = 0;
+	arena.overflowSize = 0;
+}
+
+/// Allocates uninitialized memory.
+void* arenaAllocate(MemoryArena& arena, size_t size, size_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	// the address is aligned, not the offset, so the block itself may have any alignment
+	size_t offset = alignUp((size_t)arena.memory + arena.used, alignment) - (size_t)arena.memory;
+	if (offset + size <= arena.capacity) {
+		arena.used = offset + size;
+		if (arena.used + arena.overflowSize > arena.peak)
+			arena.peak = arena.used + arena.overflowSize;
+		return arena.memory + offset;
+	}
+
+	// block is full, the allocation gets its own block until the next reset
+	unsigned char* block = (unsigned char*)::operator new(size + alignment);
+	arena.overflow.push_back(block);
+	arena.overflowSize += size + alignment;
+	if (arena.used + arena.overflowSize > arena.peak)
+		arena.peak = arena.used + arena.overflowSize;
+	return (void*)alignUp((size_t)block, alignment);
+}
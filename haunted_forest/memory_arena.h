@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		memory_arena.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __MEMORY_ARENA_H
+#define __MEMORY_ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Linear allocator, all allocations are freed at once by resetMemoryArena().
+/**
+Allocations are taken from one block by moving the offset. When the block is full, the rest
+of the allocations goes to overflow blocks and the next reset replaces the block by one large
+enough for all of them, so a steady workload does not touch the heap. Destructors are never
+called, only objects with trivial destructors may be stored.
+*/
+typedef struct MemoryArena {
+	unsigned char* memory;
+	size_t capacity;
+	size_t used;
+	size_t overflowSize;						// bytes allocated in overflow blocks since the last reset
+	size_t peak;								// the most bytes used between two resets
+	std::vector<unsigned char*> overflow;
+} MemoryArena;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Allocates block of the arena.
+/**
+\param[out] arena              Arena.
+\param[in]  capacity           Size of the block in bytes.
+*/
+void initMemoryArena(MemoryArena& arena, size_t capacity);
+
+/// Frees all memory of the arena.
+void destroyMemoryArena(MemoryArena& arena);
+
+/// Frees all allocations at once, grows the block if the overflow was used.
+void resetMemoryArena(MemoryArena& arena);
+
+/// Allocates uninitialized memory.
+/**
+\param[in,out] arena           Arena.
+\param[in]  size               Bytes to allocate.
+\param[in]  alignment          Power of two.
+\return                        Memory valid until the next reset of the arena.
+*/
+void* arenaAllocate(MemoryArena& arena, size_t size, size_t alignment);
+
+/// Allocates value initialized object.
+template <typename T>
+T* arenaNew(MemoryArena& arena)
+{
+	return new (arenaAllocate(arena, sizeof(T), alignof(T))) T();
+}
+
+/// Allocates uninitialized array.
+template <typename T>
+T* arenaArray(MemoryArena& arena, size_t count)
+{
+	return (T*)arenaAllocate(arena, (count > 0 ? count : 1) * sizeof(T), alignof(T));
+}
+
+#endif // __MEMORY_ARENA_H
@@ -0,0 +1,342 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mesh_cache.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "const.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// size and modification time of the source model, false if it does not exist
+static bool getSourceInfo(const std::string& fileName, long long& size, long long& time)
+{
+	struct stat info;
+	if (stat(fileName.c_str(), &info) != 0)
+		return false;
+
+	size = (long long)info.st_size;
+	time = (long long)info.st_mtime;
+	return true;
+}
+
+// vertex size of format
+static unsigned int getVertexStride(unsigned int vertexFormat)
+{
+	return vertexFormat == MESH_FORMAT_PACKED ? MESH_PACKED_VERTEX_SIZE : MESH_FLOATS_PER_VERTEX * sizeof(float);
+}
+
+// offset rounded up to multiple of 16 bytes
+static unsigned int alignOffset(unsigned int offset)
+{
+	return (offset + 15u) & ~15u;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Sets mesh to empty state.
+void initMeshData(MeshData& data)
+{
+	data.vertices = NULL;
+	data.indices = NULL;
+	data.numVertices = 0;
+	data.numIndices = 0;
+	data.numLods = 1;
+	data.lodNumIndices[0] = 0;
+	data.vertexStride = 0;
+	data.vertexFormat = MESH_FORMAT_FLOAT;
+	data.indexSize = sizeof(unsigned int);
+	data.shininess = 0.0f;
+	data.texture.clear();
+	data.vertexStorage.clear();
+	data.indexStorage.clear();
+	initMappedFile(data.file);
+}
+
+/// Frees storage or unmaps the cooked file.
+void releaseMeshData(MeshData& data)
+{
+	closeMappedFile(data.file);
+	std::vector<unsigned char>().swap(data.vertexStorage);
+	std::vector<unsigned char>().swap(data.indexStorage);
+	data.vertices = NULL;
+	data.indices = NULL;
+}
+
+/** Load mesh using assimp library
+* \param fileName [in] file to open/load
+* \param data [out] interleaved vertices |VNT|VNT|..., triangle indices, material and bounds
+*/
+bool importMesh(const std::string& fileName, MeshData& data)
+{
+	// released by the caller even if the import fails
+	initMeshData(data);
+
+	Assimp::Importer importer;
+
+	importer.SetPropertyInteger(AI_CONFIG_PP_PTV_NORMALIZE, 1); // Unitize object in size (scale the model to fit into (-1..1)^3)
+																// Load asset from the file - you can play with various processing steps
+	const aiScene* scn = importer.ReadFile(fileName.c_str(), 0
+		| aiProcess_Triangulate // Triangulate polygons (if any).
+		| aiProcess_PreTransformVertices // Transforms scene hierarchy into one root with geometry-leafs only. For more see Doc.
+		| aiProcess_GenSmoothNormals // Calculate normals per vertex.
+		| aiProcess_JoinIdenticalVertices);
+	// abort if the loader fails
+	if (scn == NULL) {
+		std::cerr << "assimp error: " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	// some formats store whole scene (multiple meshes and materials, lights, cameras, ...) in one file, we cannot handle that in our simplified example
+	if (scn->mNumMeshes != 1) {
+		std::cerr << "this simplified loader can only process files with only one mesh" << std::endl;
+		return false;
+	}
+	const aiMesh* mesh = scn->mMeshes[0];
+	if (mesh->mNumVertices == 0) {
+		std::cerr << "mesh has no vertices" << std::endl;
+		return false;
+	}
+
+	// interleave positions, normals and texture coordinates (just texture 0)
+	data.vertexStorage.resize(MESH_FLOATS_PER_VERTEX * sizeof(float) * mesh->mNumVertices, 0);
+	float* vertices = (float*)&data.vertexStorage[0];
+	for (unsigned int idx = 0; idx < mesh->mNumVertices; idx++) {
+		float* vertex = &vertices[MESH_FLOATS_PER_VERTEX * idx];
+		vertex[0] = mesh->mVertices[idx].x;
+		vertex[1] = mesh->mVertices[idx].y;
+		vertex[2] = mesh->mVertices[idx].z;
+		vertex[3] = mesh->mNormals[idx].x;
+		vertex[4] = mesh->mNormals[idx].y;
+		vertex[5] = mesh->mNormals[idx].z;
+		if (mesh->HasTextureCoords(0)) {
+			// we use 2D textures with 2 coordinates and ignore the third coordinate
+			vertex[6] = mesh->mTextureCoords[0][idx].x;
+			vertex[7] = mesh->mTextureCoords[0][idx].y;
+		}
+	}
+
+	// copy all mesh faces into one big array (assimp supports faces with ordinary number of vertices, we use only 3 -> triangles)
+	data.indexStorage.resize(mesh->mNumFaces * 3 * sizeof(unsigned int));
+	unsigned int* indices = (unsigned int*)&data.indexStorage[0];
+	for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+		indices[f * 3 + 0] = mesh->mFaces[f].mIndices[0];
+		indices[f * 3 + 1] = mesh->mFaces[f].mIndices[1];
+		indices[f * 3 + 2] = mesh->mFaces[f].mIndices[2];
+	}
+
+	data.vertices = data.vertexStorage.empty() ? NULL : &data.vertexStorage[0];
+	data.indices = data.indexStorage.empty() ? NULL : &data.indexStorage[0];
+	data.numVertices = mesh->mNumVertices;
+	data.numIndices = mesh->mNumFaces * 3;
+	data.lodNumIndices[0] = data.numIndices;
+	data.vertexStride = getVertexStride(MESH_FORMAT_FLOAT);
+
+	// bounds for view frustum culling
+	data.bounds.min = data.bounds.max = glm::vec3(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z);
+	for (unsigned int idx = 1; idx < mesh->mNumVertices; idx++) {
+		glm::vec3 vertex = glm::vec3(mesh->mVertices[idx].x, mesh->mVertices[idx].y, mesh->mVertices[idx].z);
+		data.bounds.min = glm::min(data.bounds.min, vertex);
+		data.bounds.max = glm::max(data.bounds.max, vertex);
+	}
+
+	// copy the material info
+	const aiMaterial* mat = scn->mMaterials[mesh->mMaterialIndex];
+	aiColor3D color;
+	aiString name;
+
+	// Get returns: aiReturn_SUCCESS 0 | aiReturn_FAILURE -1 | aiReturn_OUTOFMEMORY -3
+	mat->Get(AI_MATKEY_NAME, name); // may be "" after the input mesh processing. Must be aiString type!
+	mat->Get<aiColor3D>(AI_MATKEY_COLOR_DIFFUSE, color);
+	data.diffuse = glm::vec3(color.r, color.g, color.b);
+	mat->Get<aiColor3D>(AI_MATKEY_COLOR_AMBIENT, color);
+	data.ambient = glm::vec3(color.r, color.g, color.b);
+	mat->Get<aiColor3D>(AI_MATKEY_COLOR_SPECULAR, color);
+	data.specular = glm::vec3(color.r, color.g, color.b);
+	float shininess;
+
+	mat->Get<float>(AI_MATKEY_SHININESS, shininess);
+	data.shininess = shininess / 4.0f; // shininess divisor-not descibed anywhere
+
+	// texture image name
+	if (mat->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
+		mat->Get<aiString>(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), name);
+		data.texture = name.data;
+
+		size_t found = fileName.find_last_of("/\\");
+		// insert correct texture file path
+		if (found != std::string::npos)
+			data.texture.insert(0, fileName.substr(0, found + 1));
+	}
+
+	return true;
+}
+
+/// Maps cooked mesh of model \a fileName, fails if it does not exist, has other version or is older than the model.
+bool loadCookedMesh(const std::string& fileName, MeshData& data)
+{
+	initMeshData(data);
+
+	if (!openMappedFile(data.file, fileName + COOKED_MESH_EXTENSION))
+		return false;
+
+	const CookedMeshHeader* header = (const CookedMeshHeader*)data.file.data;
+	bool valid = data.file.size >= sizeof(CookedMeshHeader)
+		&& header->magic == COOKED_MESH_MAGIC
+		&& header->version == COOKED_MESH_VERSION
+		&& header->vertexFormat == (OPTIMIZE_MESHES ? MESH_FORMAT_PACKED : MESH_FORMAT_FLOAT)
+		&& header->vertexStride == getVertexStride(header->vertexFormat)
+		&& (header->indexSize == sizeof(unsigned short) || header->indexSize == sizeof(unsigned int))
+		&& header->numLods >= 1 && header->numLods <= MESH_MAX_LODS
+		&& header->texture[COOKED_MESH_TEXTURE_LENGTH - 1] == '\0'
+		&& (size_t)header->vertexOffset + (size_t)header->numVertices * header->vertexStride <= data.file.size
+		&& (size_t)header->indexOffset + (size_t)header->numIndices * header->indexSize <= data.file.size;
+
+	// model has changed since the mesh was cooked (models do not have to be present, cooked meshes are enough)
+	long long sourceSize, sourceTime;
+	if (valid && getSourceInfo(fileName, sourceSize, sourceTime))
+		valid = (sourceSize == header->sourceSize && sourceTime == header->sourceTime);
+
+	// levels of detail must cover all indices
+	unsigned int lodIndices = 0;
+	for (unsigned int lod = 0; valid && lod < header->numLods; lod++)
+		lodIndices += header->lodNumIndices[lod];
+	valid = valid && lodIndices == header->numIndices;
+
+	if (!valid) {
+		releaseMeshData(data);
+		return false;
+	}
+
+	data.vertices = data.file.data + header->vertexOffset;
+	data.indices = data.file.data + header->indexOffset;
+	data.numVertices = header->numVertices;
+	data.numIndices = header->numIndices;
+	data.numLods = header->numLods;
+	for (unsigned int lod = 0; lod < header->numLods; lod++)
+		data.lodNumIndices[lod] = header->lodNumIndices[lod];
+	data.vertexStride = header->vertexStride;
+	data.vertexFormat = header->vertexFormat;
+	data.indexSize = header->indexSize;
+	data.ambient = glm::vec3(header->ambient[0], header->ambient[1], header->ambient[2]);
+	data.diffuse = glm::vec3(header->diffuse[0], header->diffuse[1], header->diffuse[2]);
+	data.specular = glm::vec3(header->specular[0], header->specular[1], header->specular[2]);
+	data.shininess = header->shininess;
+	data.bounds.min = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+	data.bounds.max = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+	data.texture = header->texture;
+	return true;
+}
+
+/// Writes cooked mesh of model \a fileName.
+bool writeCookedMesh(const std::string& fileName, const MeshData& data)
+{
+	if (data.texture.size() >= COOKED_MESH_TEXTURE_LENGTH) {
+		std::cerr << "texture path too long to be cooked: " << data.texture << std::endl;
+		return false;
+	}
+
+	CookedMeshHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = COOKED_MESH_MAGIC;
+	header.version = COOKED_MESH_VERSION;
+	getSourceInfo(fileName, header.sourceSize, header.sourceTime);
+	header.numVertices = data.numVertices;
+	header.numIndices = data.numIndices;
+	header.vertexStride = data.vertexStride;
+	header.vertexFormat = data.vertexFormat;
+	header.indexSize = data.indexSize;
+	header.vertexOffset = alignOffset(sizeof(CookedMeshHeader));
+	header.indexOffset = alignOffset(header.vertexOffset + data.numVertices * data.vertexStride);
+	header.numLods = data.numLods;
+	for (unsigned int lod = 0; lod < data.numLods; lod++)
+		header.lodNumIndices[lod] = data.lodNumIndices[lod];
+	for (int i = 0; i < 3; i++) {
+		header.ambient[i] = data.ambient[i];
+		header.diffuse[i] = data.diffuse[i];
+		header.specular[i] = data.specular[i];
+		header.boundsMin[i] = data.bounds.min[i];
+		header.boundsMax[i] = data.bounds.max[i];
+	}
+	header.shininess = data.shininess;
+	strcpy(header.texture, data.texture.c_str());
+
+	std::string cookedName = fileName + COOKED_MESH_EXTENSION;
+	FILE* file = fopen(cookedName.c_str(), "wb");
+	if (file == NULL) {
+		std::cerr << "cannot write cooked mesh: " << cookedName << std::endl;
+		return false;
+	}
+
+	static const char padding[16] = { 0 };
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(padding, header.vertexOffset - sizeof(header), 1, file) <= 1
+		&& fwrite(data.vertices, data.vertexStride, data.numVertices, file) == data.numVertices
+		&& fwrite(padding, header.indexOffset - (header.vertexOffset + data.numVertices * data.vertexStride), 1, file) <= 1
+		&& fwrite(data.indices, data.indexSize, data.numIndices, file) == data.numIndices;
+	fclose(file);
+
+	if (!written) {
+		std::cerr << "cannot write cooked mesh: " << cookedName << std::endl;
+		remove(cookedName.c_str());
+	}
+	return written;
+}
+
+/// Maps cooked mesh, the model is imported (with levels of detail) and cooked when the cooked mesh is missing or stale. Can be called from any thread.
+bool loadMeshData(const std::string& fileName, MeshData& data)
+{
+	if (loadCookedMesh(fileName, data))
+		return true;
+
+	if (!importMesh(fileName, data))
+		return false;
+	if (GENERATE_MESH_LODS)
+		generateMeshLods(data);
+	if (OPTIMIZE_MESHES)
+		optimizeMesh(data);
+
+	// next start will skip assimp
+	if (writeCookedMesh(fileName, data))
+		std::cout << "Cooked mesh: " << fileName << COOKED_MESH_EXTENSION << std::endl;
+	return true;
+}
+
+// vertex cache miss ratio of level 0, indices of any size
+static float getMeshCacheMissRatio(const MeshData& data)
+{
+	std::vector<unsigned int> indices(data.lodNumIndices[0]);
+	for (unsigned int i = 0; i < data.lodNumIndices[0]; i++)
+		indices[i] = data.indexSize == sizeof(unsigned short) ? ((const unsigned short*)data.indices)[i] : ((const unsigned int*)data.indices)[i];
+	return getVertexCacheMissRatio(indices, data.numVertices);
+}
+
+/// Imports and writes cooked meshes of given models.
+int cookMeshes(const char* const fileNames[], int count)
+{
+	int failed = 0;
+	for (int i = 0; i < count; i++) {
+		MeshData data;
+		bool imported = importMesh(fileNames[i], data);
+		if (imported && GENERATE_MESH_LODS)
+			generateMeshLods(data);
+
+		// ACMR (transformed vertices per triangle) shows the effect of the vertex cache optimization
+		float importedCacheMissRatio = imported ? getMeshCacheMissRatio(data) : 0.0f;
+		if (imported && OPTIMIZE_MESHES)
+			optimizeMesh(data);
+
+		if (imported && writeCookedMesh(fileNames[i], data))
+			std::cout << "Cooked " << fileNames[i] << COOKED_MESH_EXTENSION << ": " << data.numVertices << " vertices, " << data.lodNumIndices[0] / 3 << " triangles, " << data.numLods << " levels of detail, ACMR "
+				<< importedCacheMissRatio << " -> " << getMeshCacheMissRatio(data) << std::endl;
+		else {
+			std::cerr << "Cooking " << fileNames[i] << " failed" << std::endl;
+			failed++;
+		}
+		releaseMeshData(data);
+	}
+	return failed;
+}
@@ -0,0 +1,110 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mesh_cache.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __MESH_CACHE_H
+#define __MESH_CACHE_H
+
+#include <string>
+#include <vector>
+#include "pgr.h"
+#include "render_stuff.h"
+#include "mapped_file.h"
+
+#define COOKED_MESH_MAGIC 0x4853454Du		// "MESH"
+#define COOKED_MESH_VERSION 3
+#define COOKED_MESH_EXTENSION ".mesh"		// appended to the name of the source model
+#define COOKED_MESH_TEXTURE_LENGTH 256
+
+// vertex formats
+#define MESH_FORMAT_FLOAT 0					// |position (3 floats) normal (3 floats) texture coordinates (2 floats)|
+#define MESH_FORMAT_PACKED 1				// |position (3 floats) normal (10:10:10:2 snorm) texture coordinates (2 half floats)|
+#define MESH_FLOATS_PER_VERTEX 8
+#define MESH_PACKED_VERTEX_SIZE 20
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Header of cooked mesh file (little endian), vertex and index data follow at given offsets.
+typedef struct CookedMeshHeader {
+	unsigned int magic;
+	unsigned int version;
+	// source model, mesh is cooked again when it changes
+	long long sourceSize;
+	long long sourceTime;
+
+	unsigned int numVertices;
+	unsigned int numIndices;
+	unsigned int vertexStride;		// bytes per vertex
+	unsigned int vertexFormat;
+	unsigned int indexSize;			// bytes per index (2 or 4)
+	unsigned int vertexOffset;		// bytes from the beginning of the file
+	unsigned int indexOffset;
+	unsigned int numLods;
+	unsigned int lodNumIndices[MESH_MAX_LODS];	// levels of detail follow each other in indices
+
+	float ambient[3];
+	float diffuse[3];
+	float specular[3];
+	float shininess;
+	float boundsMin[3];
+	float boundsMax[3];
+	char texture[COOKED_MESH_TEXTURE_LENGTH];	// path of diffuse texture, empty if none
+} CookedMeshHeader;
+
+/// Mesh in CPU memory, ready to be copied to buffers.
+/**
+Data points either to the storage vectors (imported by assimp) or directly to the mapped
+cooked file. Indices of levels of detail follow each other, all levels use the same vertices.
+*/
+typedef struct MeshData {
+	const void* vertices;			// interleaved in vertexFormat
+	const void* indices;			// triangles
+	unsigned int numVertices;
+	unsigned int numIndices;		// of all levels
+	unsigned int numLods;
+	unsigned int lodNumIndices[MESH_MAX_LODS];
+	unsigned int vertexStride;
+	unsigned int vertexFormat;
+	unsigned int indexSize;
+
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float shininess;
+	BoundingBox bounds;
+	std::string texture;
+
+	std::vector<unsigned char> vertexStorage;
+	std::vector<unsigned char> indexStorage;
+	MappedFile file;
+} MeshData;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Sets mesh to empty state.
+void initMeshData(MeshData& data);
+
+/// Frees storage or unmaps the cooked file.
+void releaseMeshData(MeshData& data);
+
+/// Loads mesh from model file using assimp library (one mesh per file).
+bool importMesh(const std::string& fileName, MeshData& data);
+
+/// Maps cooked mesh of model \a fileName, fails if it does not exist, has other version or is older than the model.
+bool loadCookedMesh(const std::string& fileName, MeshData& data);
+
+/// Writes cooked mesh of model \a fileName.
+bool writeCookedMesh(const std::string& fileName, const MeshData& data);
+
+/// Maps cooked mesh, the model is imported (with levels of detail if GENERATE_MESH_LODS is set, optimized if OPTIMIZE_MESHES is set) and cooked when the cooked mesh is missing or stale. Can be called from any thread.
+bool loadMeshData(const std::string& fileName, MeshData& data);
+
+/// Imports and writes cooked meshes of given models.
+/**
+\param[in]  fileNames          Source models.
+\param[in]  count              Number of models.
+\return                        Number of models which failed.
+*/
+int cookMeshes(const char* const fileNames[], int count);
+
+#endif // __MESH_CACHE_H
@@ -0,0 +1,390 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mesh_optimizer.cpp
+*	   source	|		T. Forsyth - Linear-Speed Vertex Cache Optimisation
+*/
+//----------------------------------------------------------------------------------------
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "mesh_optimizer.h"
+
+// scoring of vertices (values from the paper)
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+// scores are precomputed up to this number of remaining triangles
+#define VALENCE_SCORES 32
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// score tables
+static float cacheScores[VERTEX_CACHE_SIZE];
+static float valenceScores[VALENCE_SCORES];
+
+static bool initScoreTables()
+{
+	for (int i = 0; i < VERTEX_CACHE_SIZE; i++) {
+		// vertices of the last triangle get fixed score so that the triangle is not used twice in a row
+		if (i < 3)
+			cacheScores[i] = LAST_TRIANGLE_SCORE;
+		else
+			cacheScores[i] = powf(1.0f - (i - 3) / (float)(VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	for (int i = 0; i < VALENCE_SCORES; i++)
+		valenceScores[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+	return true;
+}
+
+// vertex with few remaining triangles is preferred, so that lonely vertices do not stay behind
+static float getVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+	if (remainingTriangles < VALENCE_SCORES)
+		return score + valenceScores[remainingTriangles];
+	return score + VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+}
+
+// IEEE half float, rounded to nearest
+static unsigned short floatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000u;
+	int exponent = (int)((bits >> 23) & 0xFFu) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFFu;
+
+	// too small ~ denormal or zero
+	if (exponent <= 0) {
+		if (exponent < -10)
+			return (unsigned short)sign;
+		mantissa |= 0x800000u;
+		unsigned int shift = (unsigned int)(14 - exponent);
+		unsigned int half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1u)
+			half++;
+		return (unsigned short)(sign | half);
+	}
+	// too large ~ infinity
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7C00u);
+
+	unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+	// carry from mantissa correctly increases exponent
+	if (mantissa & 0x1000u)
+		half++;
+	return (unsigned short)half;
+}
+
+static float halfToFloat(unsigned short half)
+{
+	int exponent = (half >> 10) & 0x1F;
+	unsigned int mantissa = half & 0x3FFu;
+
+	float value;
+	if (exponent == 0)
+		value = mantissa * (1.0f / 16777216.0f);
+	else
+		value = ldexpf(1.0f + mantissa / 1024.0f, exponent - 15);
+	return (half & 0x8000u) ? -value : value;
+}
+
+// signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV), x in the lowest bits, w = 0
+static unsigned int packNormal(const float* normal)
+{
+	unsigned int packed = 0;
+	for (int i = 0; i < 3; i++) {
+		float component = normal[i] < -1.0f ? -1.0f : (normal[i] > 1.0f ? 1.0f : normal[i]);
+		int value = (int)floorf(component * 511.0f + 0.5f);
+		packed |= ((unsigned int)value & 0x3FFu) << (10 * i);
+	}
+	return packed;
+}
+
+static void unpackNormal(unsigned int packed, float* normal)
+{
+	for (int i = 0; i < 3; i++) {
+		// sign extension of 10-bit value
+		int value = (int)((packed >> (10 * i)) << 22) >> 22;
+		normal[i] = value / 511.0f;
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Reorders triangles so that consecutive triangles share recently transformed vertices.
+void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int numVertices)
+{
+	// meshes are optimized on loader threads, initialization of static is thread safe
+	static const bool tablesReady = initScoreTables();
+	(void)tablesReady;
+
+	const unsigned int numTriangles = (unsigned int)(indices.size() / 3);
+	if (numTriangles == 0)
+		return;
+
+	// triangles using every vertex
+	std::vector<unsigned int> remaining(numVertices, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> firstTriangle(numVertices + 1, 0);
+	for (unsigned int v = 0; v < numVertices; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (unsigned int t = 0; t < numTriangles; t++)
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[3 * t + k]]++] = t;
+
+	std::vector<int> cachePosition(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++)
+		vertexScores[v] = getVertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScores(numTriangles);
+	std::vector<bool> emitted(numTriangles, false);
+	for (unsigned int t = 0; t < numTriangles; t++)
+		triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+
+	// cache has 3 extra entries for vertices pushed out by the new triangle
+	unsigned int cache[VERTEX_CACHE_SIZE + 3];
+	unsigned int cacheSize = 0;
+	unsigned int newCache[VERTEX_CACHE_SIZE + 3];
+
+	unsigned int scanPosition = 0;
+	int best = -1;
+	float bestScore = -1.0f;
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		if (triangleScores[t] > bestScore) {
+			bestScore = triangleScores[t];
+			best = (int)t;
+		}
+	}
+
+	while (best >= 0) {
+		const unsigned int* triangle = &indices[3 * best];
+		emitted[best] = true;
+		output.push_back(triangle[0]);
+		output.push_back(triangle[1]);
+		output.push_back(triangle[2]);
+
+		// new triangle goes to the front of the cache
+		unsigned int newSize = 0;
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = triangle[k];
+			newCache[newSize++] = v;
+
+			// remove triangle from adjacency of its vertices
+			unsigned int* begin = &adjacency[firstTriangle[v]];
+			unsigned int* end = begin + remaining[v];
+			for (unsigned int* a = begin; a != end; a++) {
+				if (*a == (unsigned int)best) {
+					*a = *(end - 1);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+		for (unsigned int i = 0; i < cacheSize; i++) {
+			unsigned int v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache[newSize++] = v;
+		}
+
+		// update scores of vertices in the cache and of those which just left it
+		for (unsigned int i = 0; i < newSize; i++) {
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < VERTEX_CACHE_SIZE ? (int)i : -1;
+			vertexScores[v] = getVertexScore(cachePosition[v], remaining[v]);
+		}
+		cacheSize = newSize < VERTEX_CACHE_SIZE ? newSize : VERTEX_CACHE_SIZE;
+		memcpy(cache, newCache, cacheSize * sizeof(unsigned int));
+
+		// next triangle is the best one touching the cache
+		best = -1;
+		bestScore = -1.0f;
+		for (unsigned int i = 0; i < newSize; i++) {
+			unsigned int v = newCache[i];
+			for (unsigned int a = 0; a < remaining[v]; a++) {
+				unsigned int t = adjacency[firstTriangle[v] + a];
+				const unsigned int* tri = &indices[3 * t];
+				triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+				if (triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					best = (int)t;
+				}
+			}
+		}
+
+		// nothing touches the cache ~ continue with any remaining triangle
+		if (best < 0) {
+			while (scanPosition < numTriangles && emitted[scanPosition])
+				scanPosition++;
+			if (scanPosition < numTriangles)
+				best = (int)scanPosition;
+		}
+	}
+
+	indices.swap(output);
+}
+
+/// Average number of transformed vertices per triangle with FIFO cache of VERTEX_CACHE_SIZE entries (0.5 is ideal, 3 is worst).
+float getVertexCacheMissRatio(const std::vector<unsigned int>& indices, unsigned int numVertices)
+{
+	if (indices.empty())
+		return 0.0f;
+
+	// time of insertion into FIFO cache
+	std::vector<unsigned int> insertedAt(numVertices, 0);
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+	unsigned int misses = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		unsigned int v = indices[i];
+		if (time - insertedAt[v] > VERTEX_CACHE_SIZE) {
+			insertedAt[v] = time++;
+			misses++;
+		}
+	}
+	return misses / (indices.size() / 3.0f);
+}
+
+/// Optimizes imported mesh for drawing.
+void optimizeMesh(MeshData& data)
+{
+	if (data.vertexFormat != MESH_FORMAT_FLOAT || data.indexSize != sizeof(unsigned int) || data.numVertices == 0 || data.numIndices == 0)
+		return;
+
+	const unsigned int numVertices = data.numVertices;
+	const float* vertices = (const float*)&data.vertexStorage[0];
+	std::vector<unsigned int> indices((const unsigned int*)&data.indexStorage[0], (const unsigned int*)&data.indexStorage[0] + data.numIndices);
+
+	// levels of detail are drawn separately, each one is reordered alone
+	unsigned int lodStart = 0;
+	for (unsigned int lod = 0; lod < data.numLods; lod++) {
+		std::vector<unsigned int> lodIndices(indices.begin() + lodStart, indices.begin() + lodStart + data.lodNumIndices[lod]);
+		optimizeVertexCache(lodIndices, numVertices);
+		std::copy(lodIndices.begin(), lodIndices.end(), indices.begin() + lodStart);
+		lodStart += data.lodNumIndices[lod];
+	}
+
+	// vertices in order of first use (by the full mesh) (fetching stays sequential), unused vertices go last
+	std::vector<unsigned int> remap(numVertices, ~0u);
+	std::vector<unsigned int> order;
+	order.reserve(numVertices);
+	for (size_t i = 0; i < indices.size(); i++) {
+		unsigned int& target = remap[indices[i]];
+		if (target == ~0u) {
+			target = (unsigned int)order.size();
+			order.push_back(indices[i]);
+		}
+		indices[i] = target;
+	}
+	for (unsigned int v = 0; v < numVertices; v++) {
+		if (remap[v] == ~0u) {
+			remap[v] = (unsigned int)order.size();
+			order.push_back(v);
+		}
+	}
+
+	// |position (3 floats) normal (10:10:10:2) texture coordinates (2 halfs)|
+	std::vector<unsigned char> packed(numVertices * MESH_PACKED_VERTEX_SIZE);
+	for (unsigned int i = 0; i < numVertices; i++) {
+		const float* source = vertices + MESH_FLOATS_PER_VERTEX * order[i];
+		unsigned char* target = &packed[i * MESH_PACKED_VERTEX_SIZE];
+
+		unsigned int normal = packNormal(source + 3);
+		unsigned short texCoords[2] = { floatToHalf(source[6]), floatToHalf(source[7]) };
+		memcpy(target, source, 3 * sizeof(float));
+		memcpy(target + 12, &normal, sizeof(normal));
+		memcpy(target + 16, texCoords, sizeof(texCoords));
+	}
+
+	// 16-bit indices whenever all vertices can be addressed
+	std::vector<unsigned char> packedIndices;
+	if (numVertices < 65536) {
+		packedIndices.resize(indices.size() * sizeof(unsigned short));
+		unsigned short* target = (unsigned short*)&packedIndices[0];
+		for (size_t i = 0; i < indices.size(); i++)
+			target[i] = (unsigned short)indices[i];
+		data.indexSize = sizeof(unsigned short);
+	}
+	else {
+		packedIndices.resize(indices.size() * sizeof(unsigned int));
+		memcpy(&packedIndices[0], &indices[0], packedIndices.size());
+	}
+
+	data.vertexStorage.swap(packed);
+	data.indexStorage.swap(packedIndices);
+	data.vertices = data.vertexStorage.empty() ? NULL : &data.vertexStorage[0];
+	data.indices = data.indexStorage.empty() ? NULL : &data.indexStorage[0];
+	data.vertexFormat = MESH_FORMAT_PACKED;
+	data.vertexStride = MESH_PACKED_VERTEX_SIZE;
+}
+
+/// Converts packed mesh back to MESH_FORMAT_FLOAT (for GL without packed vertex formats), indices are kept.
+void unpackMesh(MeshData& data)
+{
+	if (data.vertexFormat != MESH_FORMAT_PACKED)
+		return;
+
+	std::vector<unsigned char> vertices(data.numVertices * MESH_FLOATS_PER_VERTEX * sizeof(float));
+	for (unsigned int i = 0; i < data.numVertices; i++) {
+		const unsigned char* source = (const unsigned char*)data.vertices + i * MESH_PACKED_VERTEX_SIZE;
+		float* target = (float*)&vertices[i * MESH_FLOATS_PER_VERTEX * sizeof(float)];
+
+		unsigned int normal;
+		unsigned short texCoords[2];
+		memcpy(target, source, 3 * sizeof(float));
+		memcpy(&normal, source + 12, sizeof(normal));
+		memcpy(texCoords, source + 16, sizeof(texCoords));
+		unpackNormal(normal, target + 3);
+		target[6] = halfToFloat(texCoords[0]);
+		target[7] = halfToFloat(texCoords[1]);
+	}
+
+	// indices may point to mapped file which is closed
+	std::vector<unsigned char> indices((const unsigned char*)data.indices, (const unsigned char*)data.indices + data.numIndices * data.indexSize);
+	closeMappedFile(data.file);
+
+	data.vertexStorage.swap(vertices);
+	data.indexStorage.swap(indices);
+	data.vertices = data.vertexStorage.empty() ? NULL : &data.vertexStorage[0];
+	data.indices = data.indexStorage.empty() ? NULL : &data.indexStorage[0];
+	data.vertexFormat = MESH_FORMAT_FLOAT;
+	data.vertexStride = MESH_FLOATS_PER_VERTEX * sizeof(float);
+}
+
+/// Converts mesh to \a vertexFormat (MESH_FORMAT_*), float meshes are optimized when packed.
+void convertMesh(MeshData& data, unsigned int vertexFormat)
+{
+	if (data.vertexFormat == vertexFormat)
+		return;
+	if (vertexFormat == MESH_FORMAT_FLOAT) {
+		unpackMesh(data);
+		return;
+	}
+
+	// optimizeMesh() expects owned float vertices and 32-bit indices
+	std::vector<unsigned char> vertices((const unsigned char*)data.vertices, (const unsigned char*)data.vertices + data.numVertices * data.vertexStride);
+	std::vector<unsigned char> indices(data.numIndices * sizeof(unsigned int));
+	for (unsigned int i = 0; i < data.numIndices; i++) {
+		unsigned int index = data.indexSize == sizeof(unsigned short) ? ((const unsigned short*)data.indices)[i] : ((const unsigned int*)data.indices)[i];
+		memcpy(&indices[i * sizeof(unsigned int)], &index, sizeof(index));
+	}
+	closeMappedFile(data.file);
+
+	data.vertexStorage.swap(vertices);
+	data.indexStorage.swap(indices);
+	data.vertices = data.vertexStorage.empty() ? NULL : &data.vertexStorage[0];
+	data.indices = data.indexStorage.empty() ? NULL : &data.indexStorage[0];
+	data.indexSize = sizeof(unsigned int);
+	optimizeMesh(data);
+}
@@ -0,0 +1,39 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mesh_optimizer.h
+*	   source	|		T. Forsyth - Linear-Speed Vertex Cache Optimisation
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __MESH_OPTIMIZER_H
+#define __MESH_OPTIMIZER_H
+
+#include <vector>
+#include "mesh_cache.h"
+
+// size of simulated post-transform cache
+#define VERTEX_CACHE_SIZE 32
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Reorders triangles so that consecutive triangles share recently transformed vertices.
+void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int numVertices);
+
+/// Average number of transformed vertices per triangle with FIFO cache of VERTEX_CACHE_SIZE entries (0.5 is ideal, 3 is worst).
+float getVertexCacheMissRatio(const std::vector<unsigned int>& indices, unsigned int numVertices);
+
+/// Optimizes imported mesh for drawing.
+/**
+Triangles of each level of detail are reordered for post-transform cache, vertices in order of first use and packed to
+MESH_FORMAT_PACKED (normal as 10:10:10:2, texture coordinates as half floats), indices are
+stored in 16 bits when there are less than 65536 vertices.
+\param[in,out] data            Mesh in MESH_FORMAT_FLOAT with 32-bit indices stored in its storage vectors.
+*/
+void optimizeMesh(MeshData& data);
+
+/// Converts packed mesh back to MESH_FORMAT_FLOAT (for GL without packed vertex formats), indices are kept.
+void unpackMesh(MeshData& data);
+
+/// Converts mesh to \a vertexFormat (MESH_FORMAT_*), float meshes are optimized when packed.
+void convertMesh(MeshData& data, unsigned int vertexFormat);
+
+#endif // __MESH_OPTIMIZER_H
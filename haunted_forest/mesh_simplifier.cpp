@@ -0,0 +1,371 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mesh_simplifier.cpp
+*	   source	|		M. Garland, P. Heckbert - Surface Simplification Using Quadric Error Metrics
+*/
+//----------------------------------------------------------------------------------------
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <queue>
+#include "mesh_simplifier.h"
+#include "const.h"
+
+// symmetric 4x4 matrix, sum of squared distances to planes (upper triangle row by row)
+typedef struct Quadric {
+	double a[10];
+} Quadric;
+
+// candidate collapse of vertex u onto vertex v (welded ids)
+typedef struct Collapse {
+	double cost;
+	unsigned int u;
+	unsigned int v;
+	unsigned int versionU;		// versions of both vertices when the cost was computed
+	unsigned int versionV;
+} Collapse;
+
+// cheapest collapse on top of the priority queue
+struct CollapseGreater {
+	bool operator()(const Collapse& first, const Collapse& second) const
+	{
+		return first.cost > second.cost;
+	}
+};
+
+// state of simplification, vertices with the same position are welded together
+typedef struct SimplifierState {
+	const float* vertices;
+	std::vector<unsigned int> weld;						// original vertex -> welded vertex
+	std::vector<bool> seam;								// welded vertex has more original vertices (texture seam)
+	std::vector<bool> locked;							// never collapsed (border, seam, non-manifold edge)
+	std::vector<bool> removed;
+	std::vector<unsigned int> versions;					// incremented when quadric or neighbourhood changes
+	std::vector<Quadric> quadrics;
+	std::vector<std::vector<unsigned int> > triangles;	// welded vertex -> triangles using it (may contain removed ones)
+	std::vector<unsigned int> indices;					// original vertices of triangles
+	std::vector<bool> deleted;
+	std::priority_queue<Collapse, std::vector<Collapse>, CollapseGreater> queue;
+} SimplifierState;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+static glm::vec3 getPosition(const SimplifierState& state, unsigned int vertex)
+{
+	const float* position = state.vertices + MESH_FLOATS_PER_VERTEX * vertex;
+	return glm::vec3(position[0], position[1], position[2]);
+}
+
+static void addPlane(Quadric& quadric, const glm::vec3& normal, float distance)
+{
+	const double plane[4] = { normal.x, normal.y, normal.z, distance };
+	int k = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = i; j < 4; j++)
+			quadric.a[k++] += plane[i] * plane[j];
+}
+
+static void addQuadric(Quadric& target, const Quadric& source)
+{
+	for (int k = 0; k < 10; k++)
+		target.a[k] += source.a[k];
+}
+
+// squared distance of point to planes of quadric
+static double evaluateQuadric(const Quadric& quadric, const glm::vec3& point)
+{
+	const double p[4] = { point.x, point.y, point.z, 1.0 };
+	const double* a = quadric.a;
+	double result = 0.0;
+	int k = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = i; j < 4; j++)
+			result += (i == j ? 1.0 : 2.0) * a[k++] * p[i] * p[j];
+	return result;
+}
+
+// orders original vertices by position
+struct PositionLess {
+	const float* vertices;
+	bool operator()(unsigned int first, unsigned int second) const
+	{
+		const float* a = vertices + MESH_FLOATS_PER_VERTEX * first;
+		const float* b = vertices + MESH_FLOATS_PER_VERTEX * second;
+		if (a[0] != b[0])
+			return a[0] < b[0];
+		if (a[1] != b[1])
+			return a[1] < b[1];
+		return a[2] < b[2];
+	}
+};
+
+// welded vertices of triangle
+static void getWeldedTriangle(const SimplifierState& state, unsigned int triangle, unsigned int* welded)
+{
+	for (int k = 0; k < 3; k++)
+		welded[k] = state.weld[state.indices[3 * triangle + k]];
+}
+
+// queues collapses of both directions of edge (a, b)
+static void pushEdge(SimplifierState& state, unsigned int a, unsigned int b)
+{
+	Quadric quadric = state.quadrics[a];
+	addQuadric(quadric, state.quadrics[b]);
+
+	if (!state.locked[a]) {
+		Collapse collapse = { evaluateQuadric(quadric, getPosition(state, b)), a, b, state.versions[a], state.versions[b] };
+		state.queue.push(collapse);
+	}
+	if (!state.locked[b]) {
+		Collapse collapse = { evaluateQuadric(quadric, getPosition(state, a)), b, a, state.versions[b], state.versions[a] };
+		state.queue.push(collapse);
+	}
+}
+
+// distinct welded neighbours of vertex over live triangles
+static void getNeighbours(const SimplifierState& state, unsigned int vertex, std::vector<unsigned int>& neighbours)
+{
+	neighbours.clear();
+	const std::vector<unsigned int>& around = state.triangles[vertex];
+	for (size_t i = 0; i < around.size(); i++) {
+		if (state.deleted[around[i]])
+			continue;
+		unsigned int welded[3];
+		getWeldedTriangle(state, around[i], welded);
+		for (int k = 0; k < 3; k++)
+			if (welded[k] != vertex)
+				neighbours.push_back(welded[k]);
+	}
+	std::sort(neighbours.begin(), neighbours.end());
+	neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+// welds vertices, locks borders and seams, computes quadrics and queues all edges
+static void initSimplifier(SimplifierState& state, const float* vertices, unsigned int numVertices, const std::vector<unsigned int>& indices)
+{
+	state.vertices = vertices;
+	state.indices = indices;
+	const unsigned int numTriangles = (unsigned int)(indices.size() / 3);
+	state.deleted.assign(numTriangles, false);
+
+	// vertices sorted by position, each run of equal positions is welded to its first vertex
+	std::vector<unsigned int> order(numVertices);
+	for (unsigned int i = 0; i < numVertices; i++)
+		order[i] = i;
+	PositionLess less = { vertices };
+	std::sort(order.begin(), order.end(), less);
+
+	state.weld.resize(numVertices);
+	state.seam.assign(numVertices, false);
+	for (unsigned int i = 0; i < numVertices; i++) {
+		bool same = i > 0 && !less(order[i - 1], order[i]);
+		state.weld[order[i]] = same ? state.weld[order[i - 1]] : order[i];
+		if (same)
+			state.seam[state.weld[order[i]]] = true;
+	}
+
+	state.locked = state.seam;
+	state.removed.assign(numVertices, false);
+	state.versions.assign(numVertices, 0);
+	Quadric zero;
+	memset(&zero, 0, sizeof(zero));
+	state.quadrics.assign(numVertices, zero);
+	state.triangles.assign(numVertices, std::vector<unsigned int>());
+
+	// edges used by one triangle are borders, by more than two are non-manifold
+	std::vector<unsigned long long> edges;
+	edges.reserve(indices.size());
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		unsigned int welded[3];
+		getWeldedTriangle(state, t, welded);
+		for (int k = 0; k < 3; k++) {
+			unsigned int a = std::min(welded[k], welded[(k + 1) % 3]);
+			unsigned int b = std::max(welded[k], welded[(k + 1) % 3]);
+			edges.push_back(((unsigned long long)a << 32) | b);
+			state.triangles[welded[k]].push_back(t);
+		}
+
+		glm::vec3 p0 = getPosition(state, welded[0]);
+		glm::vec3 normal = glm::cross(getPosition(state, welded[1]) - p0, getPosition(state, welded[2]) - p0);
+		float length = glm::length(normal);
+		if (length > 0.0f) {
+			normal /= length;
+			for (int k = 0; k < 3; k++)
+				addPlane(state.quadrics[welded[k]], normal, -glm::dot(normal, p0));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size();) {
+		size_t count = 1;
+		while (i + count < edges.size() && edges[i + count] == edges[i])
+			count++;
+		if (count != 2) {
+			state.locked[(unsigned int)(edges[i] >> 32)] = true;
+			state.locked[(unsigned int)edges[i]] = true;
+		}
+		i += count;
+	}
+
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+	for (size_t i = 0; i < edges.size(); i++)
+		if ((unsigned int)(edges[i] >> 32) != (unsigned int)edges[i])
+			pushEdge(state, (unsigned int)(edges[i] >> 32), (unsigned int)edges[i]);
+}
+
+// collapses u onto v if the mesh stays manifold and no triangle flips, returns number of removed triangles
+static unsigned int collapseEdge(SimplifierState& state, unsigned int u, unsigned int v)
+{
+	std::vector<unsigned int>& aroundU = state.triangles[u];
+	unsigned int target = ~0u;		// original vertex of v which replaces u
+	unsigned int shared = 0;
+	for (size_t i = 0; i < aroundU.size(); i++) {
+		unsigned int t = aroundU[i];
+		if (state.deleted[t])
+			continue;
+		for (int k = 0; k < 3; k++) {
+			unsigned int vertex = state.indices[3 * t + k];
+			if (state.weld[vertex] != v)
+				continue;
+			// both sides of the edge must use the same texture coordinates of v
+			if (target != ~0u && target != vertex)
+				return 0;
+			target = vertex;
+			shared++;
+		}
+	}
+	if (shared == 0)
+		return 0;
+
+	// link condition ~ common neighbours are only the opposite vertices of the shared triangles
+	std::vector<unsigned int> neighboursU, neighboursV, common;
+	getNeighbours(state, u, neighboursU);
+	getNeighbours(state, v, neighboursV);
+	std::set_intersection(neighboursU.begin(), neighboursU.end(), neighboursV.begin(), neighboursV.end(), std::back_inserter(common));
+	if (common.size() != shared)
+		return 0;
+
+	// remaining triangles around u must keep their orientation
+	glm::vec3 positionV = getPosition(state, v);
+	for (size_t i = 0; i < aroundU.size(); i++) {
+		unsigned int t = aroundU[i];
+		unsigned int welded[3];
+		getWeldedTriangle(state, t, welded);
+		if (state.deleted[t] || welded[0] == v || welded[1] == v || welded[2] == v)
+			continue;
+
+		glm::vec3 before[3], after[3];
+		for (int k = 0; k < 3; k++) {
+			before[k] = getPosition(state, welded[k]);
+			after[k] = welded[k] == u ? positionV : before[k];
+		}
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+			return 0;
+	}
+
+	unsigned int removedTriangles = 0;
+	for (size_t i = 0; i < aroundU.size(); i++) {
+		unsigned int t = aroundU[i];
+		if (state.deleted[t])
+			continue;
+		unsigned int welded[3];
+		getWeldedTriangle(state, t, welded);
+		if (welded[0] == v || welded[1] == v || welded[2] == v) {
+			state.deleted[t] = true;
+			removedTriangles++;
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+			if (welded[k] == u)
+				state.indices[3 * t + k] = target;
+		state.triangles[v].push_back(t);
+	}
+
+	addQuadric(state.quadrics[v], state.quadrics[u]);
+	state.removed[u] = true;
+	std::vector<unsigned int>().swap(aroundU);
+
+	// drop removed triangles from the list of v, costs of all edges around v have changed
+	std::vector<unsigned int>& aroundV = state.triangles[v];
+	size_t live = 0;
+	for (size_t i = 0; i < aroundV.size(); i++)
+		if (!state.deleted[aroundV[i]])
+			aroundV[live++] = aroundV[i];
+	aroundV.resize(live);
+
+	state.versions[v]++;
+	getNeighbours(state, v, neighboursV);
+	for (size_t i = 0; i < neighboursV.size(); i++)
+		pushEdge(state, v, neighboursV[i]);
+	return removedTriangles;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Reduces number of triangles by quadric error edge collapses, vertices are not changed.
+void simplifyMesh(const float* vertices, unsigned int numVertices, const std::vector<unsigned int>& indices, unsigned int targetTriangles, float maxError, std::vector<unsigned int>& result)
+{
+	result = indices;
+	if (indices.empty() || numVertices == 0)
+		return;
+
+	SimplifierState state;
+	initSimplifier(state, vertices, numVertices, indices);
+
+	// error is squared distance, limit is relative to diagonal of bounds
+	glm::vec3 boundsMin = getPosition(state, 0), boundsMax = boundsMin;
+	for (unsigned int i = 1; i < numVertices; i++) {
+		boundsMin = glm::min(boundsMin, getPosition(state, i));
+		boundsMax = glm::max(boundsMax, getPosition(state, i));
+	}
+	double errorLimit = maxError * glm::length(boundsMax - boundsMin);
+	errorLimit *= errorLimit;
+
+	unsigned int numTriangles = (unsigned int)(indices.size() / 3);
+	while (numTriangles > targetTriangles && !state.queue.empty()) {
+		Collapse collapse = state.queue.top();
+		state.queue.pop();
+		if (collapse.cost > errorLimit)
+			break;
+
+		// outdated by previous collapses
+		if (state.removed[collapse.u] || state.removed[collapse.v]
+			|| collapse.versionU != state.versions[collapse.u] || collapse.versionV != state.versions[collapse.v])
+			continue;
+
+		numTriangles -= collapseEdge(state, collapse.u, collapse.v);
+	}
+
+	result.clear();
+	for (size_t t = 0; t < state.deleted.size(); t++)
+		if (!state.deleted[t])
+			result.insert(result.end(), &state.indices[3 * t], &state.indices[3 * t] + 3);
+}
+
+/// Appends levels of detail to imported mesh, each has MESH_LOD_RATIO of triangles of the previous one.
+void generateMeshLods(MeshData& data)
+{
+	if (data.vertexFormat != MESH_FORMAT_FLOAT || data.indexSize != sizeof(unsigned int) || data.numLods != 1 || data.numVertices == 0 || data.numIndices == 0)
+		return;
+
+	const float* vertices = (const float*)&data.vertexStorage[0];
+	std::vector<unsigned int> indices((const unsigned int*)&data.indexStorage[0], (const unsigned int*)&data.indexStorage[0] + data.numIndices);
+	std::vector<unsigned int> level(indices), simplified;
+
+	// each level is simplified from the previous one, coarser levels may move the surface further
+	for (int lod = 1; lod < MESH_LOD_COUNT && lod < MESH_MAX_LODS; lod++) {
+		unsigned int levelTriangles = (unsigned int)(level.size() / 3);
+		simplifyMesh(vertices, data.numVertices, level, (unsigned int)(levelTriangles * MESH_LOD_RATIO), MESH_LOD_MAX_ERROR * lod, simplified);
+		if (simplified.size() / 3 > levelTriangles * MESH_LOD_MIN_REDUCTION)
+			break;
+
+		level.swap(simplified);
+		indices.insert(indices.end(), level.begin(), level.end());
+		data.lodNumIndices[data.numLods++] = (unsigned int)level.size();
+	}
+
+	data.indexStorage.resize(indices.size() * sizeof(unsigned int));
+	memcpy(&data.indexStorage[0], &indices[0], data.indexStorage.size());
+	data.indices = &data.indexStorage[0];
+	data.numIndices = (unsigned int)indices.size();
+}
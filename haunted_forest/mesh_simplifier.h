@@ -0,0 +1,36 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		mesh_simplifier.h
+*	   source	|		M. Garland, P. Heckbert - Surface Simplification Using Quadric Error Metrics
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __MESH_SIMPLIFIER_H
+#define __MESH_SIMPLIFIER_H
+
+#include <vector>
+#include "mesh_cache.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Reduces number of triangles by quadric error edge collapses, vertices are not changed.
+/**
+Collapses move a vertex onto its neighbour (half-edge collapse), so the result uses a subset
+of the original vertices and all levels of detail can share one vertex buffer. Vertices on
+open borders and texture seams stay in place, collapses flipping triangles are rejected.
+\param[in]  vertices           Vertices in MESH_FORMAT_FLOAT.
+\param[in]  numVertices        Number of vertices.
+\param[in]  indices            Triangles.
+\param[in]  targetTriangles    Simplification stops when the number of triangles drops to this.
+\param[in]  maxError           Simplification stops when collapse would move surface further than this (relative to mesh size).
+\param[out] result             Triangles of simplified mesh.
+*/
+void simplifyMesh(const float* vertices, unsigned int numVertices, const std::vector<unsigned int>& indices, unsigned int targetTriangles, float maxError, std::vector<unsigned int>& result);
+
+/// Appends levels of detail to imported mesh, each has MESH_LOD_RATIO of triangles of the previous one.
+/**
+Levels which would not remove enough triangles are not added.
+\param[in,out] data            Mesh in MESH_FORMAT_FLOAT with one level and 32-bit indices stored in its storage vectors.
+*/
+void generateMeshLods(MeshData& data);
+
+#endif // __MESH_SIMPLIFIER_H
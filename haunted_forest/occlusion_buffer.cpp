@@ -0,0 +1,252 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		occlusion_buffer.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include "occlusion_buffer.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define OCCLUSION_USE_SSE
+#endif
+
+// vertices closer to the camera plane are not projected (w in view units)
+#define OCCLUSION_NEAR_W 1e-3f
+// bands thinner than this are not worth a task
+#define OCCLUSION_MIN_BAND_ROWS 8
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// rasterizes all occluders into rows [firstRow, endRow), bands of different threads do not overlap
+static void rasterizeBand(OcclusionBuffer& buffer, int firstRow, int endRow)
+{
+	const int width = buffer.width;
+	for (size_t t = 0; t < buffer.triangles.size(); t++) {
+		const OcclusionTriangle& triangle = buffer.triangles[t];
+		const float* x = triangle.x;
+		const float* y = triangle.y;
+
+		float minY = std::min(y[0], std::min(y[1], y[2]));
+		float maxY = std::max(y[0], std::max(y[1], y[2]));
+		int rowBegin = std::max(firstRow, (int)floorf(minY));
+		int rowEnd = std::min(endRow, (int)ceilf(maxY));
+		if (rowBegin >= rowEnd)
+			continue;
+
+		// columns aligned to 4 pixels
+		float minX = std::min(x[0], std::min(x[1], x[2]));
+		float maxX = std::max(x[0], std::max(x[1], x[2]));
+		int columnBegin = std::max(0, (int)floorf(minX)) & ~3;
+		int columnEnd = std::min(width, (int)ceilf(maxX));
+		if (columnBegin >= columnEnd)
+			continue;
+
+		// edge functions are positive inside (triangles are counter-clockwise), pixels on shared edges are
+		// covered by both triangles so there are no cracks, overlap does not matter for the nearest depth
+		float edgeA[3], edgeB[3], edgeC[3];
+		for (int i = 0; i < 3; i++) {
+			int j = (i + 1) % 3;
+			edgeA[i] = y[i] - y[j];
+			edgeB[i] = x[j] - x[i];
+			edgeC[i] = x[i] * y[j] - x[j] * y[i];
+		}
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		float d1 = triangle.depth[1] - triangle.depth[0];
+		float d2 = triangle.depth[2] - triangle.depth[0];
+		float depthDx = (d1 * (y[2] - y[0]) - d2 * (y[1] - y[0])) / area;
+		float depthDy = (d2 * (x[1] - x[0]) - d1 * (x[2] - x[0])) / area;
+		float depthC = triangle.depth[0] - depthDx * x[0] - depthDy * y[0];
+
+		for (int row = rowBegin; row < rowEnd; row++) {
+			float* pixels = &buffer.depth[row * width];
+			float py = row + 0.5f;
+#ifdef OCCLUSION_USE_SSE
+			const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 zero = _mm_setzero_ps();
+			__m128 rowEdge[3], stepEdge[3], edgeDx[3];
+			for (int i = 0; i < 3; i++) {
+				edgeDx[i] = _mm_set1_ps(edgeA[i]);
+				rowEdge[i] = _mm_set1_ps(edgeB[i] * py + edgeC[i]);
+				stepEdge[i] = _mm_set1_ps(4.0f * edgeA[i]);
+			}
+			const __m128 depthStep = _mm_set1_ps(4.0f * depthDx);
+
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)columnBegin), offsets);
+			__m128 e0 = _mm_add_ps(rowEdge[0], _mm_mul_ps(edgeDx[0], px));
+			__m128 e1 = _mm_add_ps(rowEdge[1], _mm_mul_ps(edgeDx[1], px));
+			__m128 e2 = _mm_add_ps(rowEdge[2], _mm_mul_ps(edgeDx[2], px));
+			__m128 depth = _mm_add_ps(_mm_set1_ps(depthDy * py + depthC), _mm_mul_ps(_mm_set1_ps(depthDx), px));
+
+			for (int column = columnBegin; column < columnEnd; column += 4) {
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				if (_mm_movemask_ps(inside) != 0) {
+					__m128 old = _mm_loadu_ps(pixels + column);
+					__m128 nearer = _mm_max_ps(old, depth);
+					_mm_storeu_ps(pixels + column, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+				}
+				e0 = _mm_add_ps(e0, stepEdge[0]);
+				e1 = _mm_add_ps(e1, stepEdge[1]);
+				e2 = _mm_add_ps(e2, stepEdge[2]);
+				depth = _mm_add_ps(depth, depthStep);
+			}
+#else
+			for (int column = columnBegin; column < columnEnd; column++) {
+				float px = column + 0.5f;
+				if (edgeA[0] * px + edgeB[0] * py + edgeC[0] >= 0.0f
+					&& edgeA[1] * px + edgeB[1] * py + edgeC[1] >= 0.0f
+					&& edgeA[2] * px + edgeB[2] * py + edgeC[2] >= 0.0f)
+					pixels[column] = std::max(pixels[column], depthDx * px + depthDy * py + depthC);
+			}
+#endif
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Allocates buffer, \a width is rounded up to multiple of 4.
+void initOcclusionBuffer(OcclusionBuffer& buffer, int width, int height)
+{
+	buffer.width = (width + 3) & ~3;
+	buffer.height = height;
+	buffer.depth.assign(buffer.width * buffer.height, 0.0f);
+	buffer.PVmatrix = glm::mat4(1.0f);
+	buffer.triangles.clear();
+	memset(&buffer.stats, 0, sizeof(buffer.stats));
+}
+
+/// Clears depth, occluders and stats for new view.
+void beginOcclusionPass(OcclusionBuffer& buffer, const glm::mat4& PVmatrix)
+{
+	std::fill(buffer.depth.begin(), buffer.depth.end(), 0.0f);
+	buffer.PVmatrix = PVmatrix;
+	buffer.triangles.clear();
+	memset(&buffer.stats, 0, sizeof(buffer.stats));
+}
+
+/// Projects triangles of occluder, they are rasterized by rasterizeOccluders().
+void addOccluder(OcclusionBuffer& buffer, const PositionMesh& mesh, const glm::mat4& modelMatrix)
+{
+	const glm::mat4 matrix = buffer.PVmatrix * modelMatrix;
+	buffer.clipVertices.resize(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+		buffer.clipVertices[i] = matrix * glm::vec4(mesh.vertices[i], 1.0f);
+
+	const float halfWidth = 0.5f * buffer.width;
+	const float halfHeight = 0.5f * buffer.height;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		const glm::vec4* vertices[3] = {
+			&buffer.clipVertices[mesh.indices[i]], &buffer.clipVertices[mesh.indices[i + 1]], &buffer.clipVertices[mesh.indices[i + 2]]
+		};
+		// skipping an occluder is always safe, clipping is not needed
+		if (vertices[0]->w < OCCLUSION_NEAR_W || vertices[1]->w < OCCLUSION_NEAR_W || vertices[2]->w < OCCLUSION_NEAR_W)
+			continue;
+
+		OcclusionTriangle triangle;
+		for (int k = 0; k < 3; k++) {
+			float inverseW = 1.0f / vertices[k]->w;
+			triangle.x[k] = (vertices[k]->x * inverseW + 1.0f) * halfWidth;
+			triangle.y[k] = (vertices[k]->y * inverseW + 1.0f) * halfHeight;
+			triangle.depth[k] = inverseW;
+		}
+
+		// both sides are drawn, clockwise triangles are turned around
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (fabsf(area) < 1e-6f)
+			continue;
+		if (area < 0.0f) {
+			std::swap(triangle.x[1], triangle.x[2]);
+			std::swap(triangle.y[1], triangle.y[2]);
+			std::swap(triangle.depth[1], triangle.depth[2]);
+		}
+		buffer.triangles.push_back(triangle);
+	}
+	buffer.stats.occluders++;
+}
+
+/// Rasterizes added occluders.
+void rasterizeOccluders(OcclusionBuffer& buffer, ThreadPool* pool)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	buffer.stats.triangles = (int)buffer.triangles.size();
+
+	// the calling thread takes the first band
+	int numBands = pool != NULL ? (int)pool->workers.size() + 1 : 1;
+	numBands = std::max(1, std::min(numBands, buffer.height / OCCLUSION_MIN_BAND_ROWS));
+	int bandRows = (buffer.height + numBands - 1) / numBands;
+
+	std::mutex mutex;
+	std::condition_variable bandFinished;
+	int remaining = numBands - 1;
+	OcclusionBuffer* target = &buffer;
+	for (int band = 1; band < numBands; band++) {
+		submitTask(*pool, [target, band, bandRows, &mutex, &bandFinished, &remaining]() {
+			rasterizeBand(*target, band * bandRows, std::min(target->height, (band + 1) * bandRows));
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0)
+				bandFinished.notify_one();
+		});
+	}
+	rasterizeBand(buffer, 0, std::min(buffer.height, bandRows));
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (remaining > 0)
+		bandFinished.wait(lock);
+
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	buffer.stats.rasterTime = elapsed.count();
+}
+
+/// Tests world space box against rasterized occluders.
+bool isBoxOccluded(OcclusionBuffer& buffer, const BoundingBox& box)
+{
+	buffer.stats.tested++;
+
+	// screen rectangle and the nearest depth of the corners
+	float minX = (float)buffer.width, maxX = 0.0f;
+	float minY = (float)buffer.height, maxY = 0.0f;
+	float nearest = 0.0f;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 position((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = buffer.PVmatrix * glm::vec4(position, 1.0f);
+		if (clip.w < OCCLUSION_NEAR_W)
+			return false;
+
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW + 1.0f) * 0.5f * buffer.width;
+		float y = (clip.y * inverseW + 1.0f) * 0.5f * buffer.height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::max(nearest, inverseW);
+	}
+
+	int columnBegin = std::max(0, (int)floorf(minX));
+	int columnEnd = std::min(buffer.width, (int)floorf(maxX) + 1);
+	int rowBegin = std::max(0, (int)floorf(minY));
+	int rowEnd = std::min(buffer.height, (int)floorf(maxY) + 1);
+	if (columnBegin >= columnEnd || rowBegin >= rowEnd)
+		return false;
+
+	for (int row = rowBegin; row < rowEnd; row++) {
+		const float* pixels = &buffer.depth[row * buffer.width];
+#ifdef OCCLUSION_USE_SSE
+		// whole groups of 4 pixels are tested, extra pixels can only keep the box visible
+		const __m128 boxDepth = _mm_set1_ps(nearest);
+		for (int column = columnBegin & ~3; column < columnEnd; column += 4)
+			if (_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(pixels + column), boxDepth)) != 0)
+				return false;
+#else
+		for (int column = columnBegin; column < columnEnd; column++)
+			if (pixels[column] <= nearest)
+				return false;
+#endif
+	}
+
+	buffer.stats.occluded++;
+	return true;
+}
@@ -0,0 +1,75 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		occlusion_buffer.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __OCCLUSION_BUFFER_H
+#define __OCCLUSION_BUFFER_H
+
+#include <vector>
+#include "geometry_types.h"
+#include "thread_pool.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Work of the last occlusion pass.
+typedef struct OcclusionStats {
+	int occluders;						// meshes rasterized
+	int triangles;						// triangles rasterized (those crossing the near plane are skipped)
+	int tested;							// boxes tested
+	int occluded;						// boxes hidden behind occluders
+	float rasterTime;					// milliseconds spent by rasterization
+} OcclusionStats;
+
+/// Occluder triangle in buffer coordinates.
+typedef struct OcclusionTriangle {
+	float x[3];
+	float y[3];
+	float depth[3];						// 1/w, larger is closer
+} OcclusionTriangle;
+
+/// Low resolution depth buffer rasterized on CPU.
+/**
+Pixels keep 1/w of the nearest occluder (0 where nothing is drawn), 1/w is linear in screen
+space so it is interpolated directly. Rows are rasterized in bands on worker threads, four
+pixels of a row at once using SSE when available. No GL calls are made, the buffer works
+without GL context.
+*/
+typedef struct OcclusionBuffer {
+	int width;							// multiple of 4
+	int height;
+	std::vector<float> depth;			// row by row, bottom row first
+	glm::mat4 PVmatrix;
+	std::vector<OcclusionTriangle> triangles;	// occluders of the current pass
+	std::vector<glm::vec4> clipVertices;		// scratch of addOccluder()
+	OcclusionStats stats;
+} OcclusionBuffer;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Allocates buffer, \a width is rounded up to multiple of 4.
+void initOcclusionBuffer(OcclusionBuffer& buffer, int width, int height);
+
+/// Clears depth, occluders and stats for new view.
+void beginOcclusionPass(OcclusionBuffer& buffer, const glm::mat4& PVmatrix);
+
+/// Projects triangles of occluder, they are rasterized by rasterizeOccluders().
+void addOccluder(OcclusionBuffer& buffer, const PositionMesh& mesh, const glm::mat4& modelMatrix);
+
+/// Rasterizes added occluders.
+/**
+\param[in,out] buffer          Buffer with occluders.
+\param[in]  pool               Workers sharing the bands of rows with the calling thread, NULL to rasterize on the calling thread only.
+*/
+void rasterizeOccluders(OcclusionBuffer& buffer, ThreadPool* pool);
+
+/// Tests world space box against rasterized occluders.
+/**
+Box is occluded if all pixels of its screen rectangle have occluder closer than the nearest
+corner of the box. Boxes crossing the near plane or outside the buffer are never occluded.
+\param[in,out] buffer          Rasterized buffer, stats are updated.
+\param[in]  box                Tested box.
+\return                        True if the box is hidden.
+*/
+bool isBoxOccluded(OcclusionBuffer& buffer, const BoundingBox& box);
+
+#endif // __OCCLUSION_BUFFER_H
@@ -0,0 +1,150 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		picking.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "picking.h"
+
+// triangles nearly parallel to the ray are not hit
+#define PICK_PARALLEL_EPSILON 1e-9f
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// Moller-Trumbore test, \a distance is the ray parameter of the hit
+static bool intersectRayTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& distance)
+{
+	glm::vec3 edge1 = v1 - v0;
+	glm::vec3 edge2 = v2 - v0;
+	glm::vec3 p = glm::cross(direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (std::fabs(determinant) < PICK_PARALLEL_EPSILON)
+		return false;
+
+	float inverseDeterminant = 1.0f / determinant;
+	glm::vec3 s = origin - v0;
+	float u = glm::dot(s, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	distance = glm::dot(edge2, q) * inverseDeterminant;
+	return distance >= 0.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Ray through the center of window pixel.
+PickRay makePickRay(const glm::mat4& inversePVmatrix, int x, int y, int width, int height)
+{
+	float ndcX = 2.0f * (x + 0.5f) / width - 1.0f;
+	float ndcY = 2.0f * (y + 0.5f) / height - 1.0f;
+	glm::vec4 nearPoint = inversePVmatrix * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 farPoint = inversePVmatrix * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+
+	PickRay ray;
+	ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+	ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+	// division by zero gives infinity, which the slab test handles
+	ray.inverseDirection = glm::vec3(1.0f) / ray.direction;
+	return ray;
+}
+
+/// Tests ray against box (slab method).
+bool intersectRayBox(const PickRay& ray, const BoundingBox& box, float maxDistance, float& distance)
+{
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int axis = 0; axis < 3; axis++) {
+		float t0 = (box.min[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+		float t1 = (box.max[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		// NaN (origin on the slab plane of parallel ray) keeps the interval unchanged
+		tMin = t0 > tMin ? t0 : tMin;
+		tMax = t1 < tMax ? t1 : tMax;
+		if (tMin > tMax)
+			return false;
+	}
+	distance = tMin;
+	return true;
+}
+
+/// Tests ray against triangles of mesh placed by \a modelMatrix (both sides of triangles are hit).
+bool intersectRayMesh(const PickRay& ray, const PositionMesh& mesh, const glm::mat4& modelMatrix, float maxDistance, float& distance)
+{
+	// ray is moved to model space instead of transforming all vertices, the parameter t stays the same
+	glm::mat4 inverseModelMatrix = glm::inverse(modelMatrix);
+	glm::vec3 origin = glm::vec3(inverseModelMatrix * glm::vec4(ray.origin, 1.0f));
+	glm::vec3 direction = glm::vec3(inverseModelMatrix * glm::vec4(ray.direction, 0.0f));
+
+	bool hit = false;
+	distance = maxDistance;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		float t;
+		if (intersectRayTriangle(origin, direction, mesh.vertices[mesh.indices[i]], mesh.vertices[mesh.indices[i + 1]], mesh.vertices[mesh.indices[i + 2]], t) && t < distance) {
+			distance = t;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+/// Finds the nearest still object hit by ray, bounds in the hierarchy are tested first and then triangles of objects.
+bool pickStillObject(const Bvh& bvh, const SceneStorage& scene, const PickRay& ray, float maxDistance, PickHit& hit)
+{
+	hit.object = INVALID_OBJECT_HANDLE;
+	hit.distance = maxDistance;
+	if (bvh.nodes.empty())
+		return false;
+
+	// node index and distance where the ray enters its bounds, nodes behind the nearest hit are skipped
+	std::vector<std::pair<int, float> > stack;
+	float rootDistance;
+	if (intersectRayBox(ray, bvh.nodes[0].bounds, hit.distance, rootDistance))
+		stack.push_back(std::make_pair(0, rootDistance));
+
+	while (!stack.empty()) {
+		const BvhNode& node = bvh.nodes[stack.back().first];
+		float nodeDistance = stack.back().second;
+		stack.pop_back();
+		if (nodeDistance > hit.distance)
+			continue;
+
+		if (node.left < 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				float distance;
+				if (!intersectRayBox(ray, bvh.objects[i].bounds, hit.distance, distance))
+					continue;
+				unsigned int index = bvh.objects[i].index;
+				const PositionMesh* mesh = getMeshPositionMesh(scene.meshes[index]);
+				if (mesh != NULL && intersectRayMesh(ray, *mesh, scene.transforms[index].modelMatrix, hit.distance, distance)) {
+					hit.object = scene.handles[index];
+					hit.distance = distance;
+				}
+			}
+		}
+		else {
+			// the nearer child is pushed last so it is tested first
+			float leftDistance, rightDistance;
+			bool leftHit = intersectRayBox(ray, bvh.nodes[node.left].bounds, hit.distance, leftDistance);
+			bool rightHit = intersectRayBox(ray, bvh.nodes[node.right].bounds, hit.distance, rightDistance);
+			if (leftHit && rightHit && leftDistance < rightDistance) {
+				stack.push_back(std::make_pair(node.right, rightDistance));
+				stack.push_back(std::make_pair(node.left, leftDistance));
+			}
+			else {
+				if (leftHit)
+					stack.push_back(std::make_pair(node.left, leftDistance));
+				if (rightHit)
+					stack.push_back(std::make_pair(node.right, rightDistance));
+			}
+		}
+	}
+
+	hit.point = ray.origin + hit.distance * ray.direction;
+	return hit.object != INVALID_OBJECT_HANDLE;
+}
@@ -0,0 +1,75 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		picking.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __PICKING_H
+#define __PICKING_H
+
+#include "pgr.h"
+#include "render_stuff.h"
+#include "scene_storage.h"
+#include "culling.h"
+#include "geometry_types.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Ray in world space, its points are origin + t * direction.
+typedef struct PickRay {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 inverseDirection;			// 1 / direction per component for box tests
+} PickRay;
+
+/// The nearest object hit by ray.
+typedef struct PickHit {
+	ObjectHandle object;				// INVALID_OBJECT_HANDLE if no still object was hit
+	float distance;						// ray parameter t of the hit
+	glm::vec3 point;					// world space
+} PickHit;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Ray through the center of window pixel.
+/**
+\param[in]  inversePVmatrix    Inverse of projection * view matrix the window was drawn with.
+\param[in]  x                  Window x coordinate.
+\param[in]  y                  Window y coordinate, origin in the lower left corner.
+\param[in]  width              Window width.
+\param[in]  height             Window height.
+\return                        Ray from the near (t 0) to the far plane (t 1).
+*/
+PickRay makePickRay(const glm::mat4& inversePVmatrix, int x, int y, int width, int height);
+
+/// Tests ray against box (slab method).
+/**
+\param[in]  ray                Tested ray.
+\param[in]  box                World space box.
+\param[in]  maxDistance        Hits farther than this are ignored.
+\param[out] distance           Ray parameter where the ray enters the box, 0 if it starts inside.
+\return                        True if the box is hit.
+*/
+bool intersectRayBox(const PickRay& ray, const BoundingBox& box, float maxDistance, float& distance);
+
+/// Tests ray against triangles of mesh placed by \a modelMatrix (both sides of triangles are hit).
+/**
+\param[in]  ray                Tested ray.
+\param[in]  mesh               Model space triangles.
+\param[in]  modelMatrix        Placement of the mesh.
+\param[in]  maxDistance        Hits farther than this are ignored.
+\param[out] distance           Ray parameter of the nearest hit.
+\return                        True if a triangle is hit.
+*/
+bool intersectRayMesh(const PickRay& ray, const PositionMesh& mesh, const glm::mat4& modelMatrix, float maxDistance, float& distance);
+
+/// Finds the nearest still object hit by ray, bounds in the hierarchy are tested first and then triangles of objects.
+/**
+\param[in]  bvh                Hierarchy of \a scene built by buildBvh().
+\param[in]  scene              Objects of the hierarchy, meshes and transforms are tested.
+\param[in]  ray                Tested ray.
+\param[in]  maxDistance        Hits farther than this are ignored.
+\param[out] hit                The nearest hit, object is INVALID_OBJECT_HANDLE if nothing was hit.
+\return                        True if an object is hit.
+*/
+bool pickStillObject(const Bvh& bvh, const SceneStorage& scene, const PickRay& ray, float maxDistance, PickHit& hit);
+
+#endif // __PICKING_H
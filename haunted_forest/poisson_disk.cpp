@@ -0,0 +1,84 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		poisson_disk.cpp
+*	   source	|		R. Bridson - Fast Poisson Disk Sampling in Arbitrary Dimensions
+*/
+//----------------------------------------------------------------------------------------
+#include <cmath>
+#include "poisson_disk.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// position lies inside generated area
+static bool isInArea(const glm::vec2& position, const glm::vec2& extent)
+{
+	return fabs(position.x) < extent.x && fabs(position.y) < extent.y;
+}
+
+// position is not too close to anything in the grid
+static bool isFree(PoissonSampler& sampler, const glm::vec2& position, float radius)
+{
+	return !queryGridRadius(*sampler.grid, position, radius);
+}
+
+// stores accepted position
+static void acceptPosition(PoissonSampler& sampler, const glm::vec2& position, bool savePosition)
+{
+	if (!savePosition)
+		return;
+
+	insertIntoGrid(*sampler.grid, glm::vec3(position, 0.0f));
+	sampler.active.push_back(position);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Starts new sampling, all positions stored in \a grid are kept as obstacles.
+void initPoissonSampler(PoissonSampler& sampler, SpatialGrid* grid, Random* random, int attempts)
+{
+	sampler.grid = grid;
+	sampler.active.clear();
+	sampler.random = random;
+	sampler.attempts = attempts;
+}
+
+/// Generates position at least \a radius away from all stored positions.
+bool generatePoissonPosition(PoissonSampler& sampler, float radius, const glm::vec2& extent, bool savePosition, glm::vec2& position)
+{
+	// grow from randomly chosen active position, try candidates in annulus [radius, 2 * radius]
+	int misses = 0;
+	while (!sampler.active.empty() && misses < sampler.attempts) {
+		size_t pick = randomBelow(*sampler.random, (unsigned int)sampler.active.size());
+		glm::vec2 center = sampler.active[pick];
+
+		// active position of another (larger) area
+		if (!isInArea(center, extent)) {
+			misses++;
+			continue;
+		}
+
+		for (int i = 0; i < sampler.attempts; i++) {
+			float angle = 2.0f * 3.14159265f * randomFloat(*sampler.random);
+			float distance = radius * (1.0f + randomFloat(*sampler.random));
+			position = center + distance * glm::vec2(cos(angle), sin(angle));
+
+			if (isInArea(position, extent) && isFree(sampler, position, radius)) {
+				acceptPosition(sampler, position, savePosition);
+				return true;
+			}
+		}
+
+		// no room around this position anymore (for this radius), retire it
+		sampler.active[pick] = sampler.active.back();
+		sampler.active.pop_back();
+	}
+
+	// nothing active in the area (first object of the area or area is full) ~ throw darts
+	for (int i = 0; i < sampler.attempts; i++) {
+		position = glm::vec2((2.0f * randomFloat(*sampler.random) - 1.0f) * extent.x, (2.0f * randomFloat(*sampler.random) - 1.0f) * extent.y);
+
+		if (isFree(sampler, position, radius)) {
+			acceptPosition(sampler, position, savePosition);
+			return true;
+		}
+	}
+	return false;
+}
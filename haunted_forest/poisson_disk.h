@@ -0,0 +1,48 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		poisson_disk.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __POISSON_DISK_H
+#define __POISSON_DISK_H
+
+#include <vector>
+#include "pgr.h"
+#include "spatial_grid.h"
+#include "random.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// State of Bridson's Poisson disk sampling of the ground plane.
+/**
+Accepted positions are stored to \a grid (the same grid is used for collisions), new positions
+are grown from the active ones. Every object type has its own radius, new position must be
+at least the radius of the placed object away from all positions in the grid.
+*/
+typedef struct PoissonSampler {
+	SpatialGrid* grid;
+	std::vector<glm::vec2> active;	// positions which may still have free space around
+	Random* random;					// generator of the scene
+	int attempts;					// candidates tried around one active position
+} PoissonSampler;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Starts new sampling, all positions stored in \a grid are kept as obstacles.
+void initPoissonSampler(PoissonSampler& sampler, SpatialGrid* grid, Random* random, int attempts);
+
+/// Generates position at least \a radius away from all stored positions.
+/**
+Run time is bounded: at most \a attempts candidates are tried around each active position
+(which is retired when all of them fail), at most \a attempts active positions outside
+the area are picked and then at most \a attempts random darts are thrown.
+
+\param[in]  sampler            Sampler state.
+\param[in]  radius             Minimal distance from other objects.
+\param[in]  extent             Position is generated in (-extent.x, extent.x) x (-extent.y, extent.y).
+\param[in]  savePosition       Store accepted position to the grid (and grow from it).
+\param[out] position           Generated position, the last candidate if none was accepted.
+\return                        False if the area is full.
+*/
+bool generatePoissonPosition(PoissonSampler& sampler, float radius, const glm::vec2& extent, bool savePosition, glm::vec2& position);
+
+#endif // __POISSON_DISK_H
@@ -6,7 +6,26 @@
 //----------------------------------------------------------------------------------------
 #version 140
 
-uniform mat4 PVMmatrix; 
+// per-frame data shared by all programs (FrameData in render_stuff.h)
+layout(std140) uniform FrameData
+{
+	mat4 Vmatrix;				// View                       --> world to eye coordinates
+	mat4 Pmatrix;				// Projection
+	mat4 PVmatrix;				// Projection * View          --> world to clip coordinates
+	mat4 inversePVmatrix;		// inverse of Projection * View rotation (skybox)
+	vec4 reflectorPosition;		// lights in eye coordinates
+	vec4 reflectorDirection;
+	vec4 pointlightPosition;
+	vec4 fogColor;
+	float fogDensity;
+	float time;					// app elapsed time in seconds
+	bool fogOn;
+	bool sunOn;
+	bool reflectorOn;
+	bool pointlightOn;
+};
+
+uniform mat4 Mmatrix;			// Model --> model to world coordinates
 uniform mat4 texTransMatrix;
 in vec3 position; // input vertex position
 in vec2 texCoord; // intput vertex texture coordinates
@@ -14,7 +33,7 @@ smooth out vec2 texCoord_v; //output vertex texture coordinates
 
 void main() 
 {
-	gl_Position = PVMmatrix * vec4(position, 1);   
+	gl_Position = PVmatrix * Mmatrix * vec4(position, 1);
 	vec4 transCoord = texTransMatrix * vec4(texCoord, 1.0f , 1.0f);
 	texCoord_v = transCoord.xy;
 }
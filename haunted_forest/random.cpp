@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		random.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include "random.h"
+
+// multiplier of the LCG
+#define PCG_MULTIPLIER 6364136223846793005ull
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Starts sequence given by \a seed, generators with different \a stream give independent sequences.
+void seedRandom(Random& random, unsigned long long seed, unsigned long long stream)
+{
+	random.state = 0;
+	random.increment = (stream << 1) | 1;
+	randomUint(random);
+	random.state += seed;
+	randomUint(random);
+}
+
+/// Uniform 32-bit integer.
+unsigned int randomUint(Random& random)
+{
+	unsigned long long state = random.state;
+	random.state = state * PCG_MULTIPLIER + random.increment;
+
+	unsigned int xorShifted = (unsigned int)(((state >> 18) ^ state) >> 27);
+	unsigned int rotation = (unsigned int)(state >> 59);
+	return (xorShifted >> rotation) | (xorShifted << ((0u - rotation) & 31));
+}
+
+/// Uniform integer in [0, bound), without modulo bias.
+unsigned int randomBelow(Random& random, unsigned int bound)
+{
+	// values below threshold would make the low results more likely
+	unsigned int threshold = (0u - bound) % bound;
+	for (;;) {
+		unsigned int value = randomUint(random);
+		if (value >= threshold)
+			return value % bound;
+	}
+}
+
+/// Uniform float in [0, 1) with 24 random bits.
+float randomFloat(Random& random)
+{
+	return (randomUint(random) >> 8) * (1.0f / 16777216.0f);
+}
+
+/// Uniform float in [min, max).
+float randomRange(Random& random, float min, float max)
+{
+	return min + (max - min) * randomFloat(random);
+}
+
+/// Compares the first outputs with the reference PCG32 implementation (seed 42, stream 54).
+bool checkRandom(void)
+{
+	static const unsigned int reference[] = { 0xa15c02b7u, 0x7b47f409u, 0xba1d3330u, 0x83d2f293u, 0xbfa4784bu, 0xcbed606eu };
+
+	Random random;
+	seedRandom(random, 42, 54);
+	for (int i = 0; i < (int)(sizeof(reference) / sizeof(reference[0])); i++)
+		if (randomUint(random) != reference[i])
+			return false;
+	return true;
+}
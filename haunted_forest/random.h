@@ -0,0 +1,41 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		random.h
+*	   source	|		M. E. O'Neill - PCG: A Family of Simple Fast Space-Efficient Statistically Good Algorithms for Random Number Generation
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __RANDOM_H
+#define __RANDOM_H
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// PCG32 generator (XSH RR output of 64-bit LCG).
+/**
+The sequence is fully defined by the seed and the stream and does not depend on the compiler
+or the standard library, so the same seed gives the same numbers on every build.
+*/
+typedef struct Random {
+	unsigned long long state;
+	unsigned long long increment;		// odd, selects the stream
+} Random;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Starts sequence given by \a seed, generators with different \a stream give independent sequences.
+void seedRandom(Random& random, unsigned long long seed, unsigned long long stream);
+
+/// Uniform 32-bit integer.
+unsigned int randomUint(Random& random);
+
+/// Uniform integer in [0, bound), without modulo bias.
+unsigned int randomBelow(Random& random, unsigned int bound);
+
+/// Uniform float in [0, 1) with 24 random bits.
+float randomFloat(Random& random);
+
+/// Uniform float in [min, max).
+float randomRange(Random& random, float min, float max);
+
+/// Compares the first outputs with the reference PCG32 implementation (seed 42, stream 54).
+bool checkRandom(void);
+
+#endif // __RANDOM_H
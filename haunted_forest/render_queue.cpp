@@ -0,0 +1,107 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		render_queue.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cstring>
+#include "render_queue.h"
+
+// bits of sort key fields
+#define SORT_KEY_PASS_BITS 2
+#define SORT_KEY_PROGRAM_BITS 8
+#define SORT_KEY_VERTEX_ARRAY_BITS 12
+#define SORT_KEY_TEXTURE_BITS 12
+#define SORT_KEY_DEPTH_BITS 24
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// depth quantized to SORT_KEY_DEPTH_BITS ~ bits of non-negative float compare as integers, top bits are sign, exponent and start of mantissa
+static unsigned long long quantizeDepth(float depth)
+{
+	if (!(depth > 0.0f))
+		return 0;
+
+	unsigned int bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return bits >> (32 - SORT_KEY_DEPTH_BITS);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Builds 64-bit sort key of packet.
+unsigned long long makeSortKey(int pass, GLuint program, GLuint vertexArray, GLuint texture, float depth)
+{
+	const unsigned long long depthMask = (1ull << SORT_KEY_DEPTH_BITS) - 1;
+
+	unsigned long long state = program & ((1u << SORT_KEY_PROGRAM_BITS) - 1);
+	state = (state << SORT_KEY_VERTEX_ARRAY_BITS) | (vertexArray & ((1u << SORT_KEY_VERTEX_ARRAY_BITS) - 1));
+	state = (state << SORT_KEY_TEXTURE_BITS) | (texture & ((1u << SORT_KEY_TEXTURE_BITS) - 1));
+
+	unsigned long long key = (unsigned long long)pass << (64 - SORT_KEY_PASS_BITS);
+	if (pass == RENDER_PASS_BLENDED) {
+		// back-to-front is required for correct blending, state order only among equal depths
+		key |= (depthMask - quantizeDepth(depth)) << (64 - SORT_KEY_PASS_BITS - SORT_KEY_DEPTH_BITS);
+		key |= state << (64 - SORT_KEY_PASS_BITS - SORT_KEY_DEPTH_BITS - SORT_KEY_PROGRAM_BITS - SORT_KEY_VERTEX_ARRAY_BITS - SORT_KEY_TEXTURE_BITS);
+	}
+	else {
+		// fewest state changes, front-to-back among draws with the same state for early depth test
+		key |= state << (64 - SORT_KEY_PASS_BITS - SORT_KEY_PROGRAM_BITS - SORT_KEY_VERTEX_ARRAY_BITS - SORT_KEY_TEXTURE_BITS);
+		key |= quantizeDepth(depth) << (64 - SORT_KEY_PASS_BITS - SORT_KEY_PROGRAM_BITS - SORT_KEY_VERTEX_ARRAY_BITS - SORT_KEY_TEXTURE_BITS - SORT_KEY_DEPTH_BITS);
+	}
+	return key;
+}
+
+/// Removes all packets, keeps allocated storage.
+void clearRenderQueue(RenderQueue& queue)
+{
+	queue.packets.clear();
+}
+
+/// Adds packet, its key must be already set.
+void pushDrawPacket(RenderQueue& queue, const DrawPacket& packet)
+{
+	queue.packets.push_back(packet);
+}
+
+/// Sorts packets by key (LSD radix sort, bytes equal in all keys are skipped).
+void sortRenderQueue(RenderQueue& queue)
+{
+	size_t count = queue.packets.size();
+	if (count < 2)
+		return;
+
+	// bits which differ in some keys, digits without them keep the order
+	unsigned long long firstKey = queue.packets[0].key;
+	unsigned long long differentBits = 0;
+	for (size_t i = 1; i < count; i++)
+		differentBits |= queue.packets[i].key ^ firstKey;
+
+	queue.scratch.resize(count);
+	DrawPacket* source = &queue.packets[0];
+	DrawPacket* target = &queue.scratch[0];
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		if (((differentBits >> shift) & 0xff) == 0)
+			continue;
+
+		size_t offsets[256] = { 0 };
+		for (size_t i = 0; i < count; i++)
+			offsets[(source[i].key >> shift) & 0xff]++;
+
+		size_t sum = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			size_t digitCount = offsets[digit];
+			offsets[digit] = sum;
+			sum += digitCount;
+		}
+
+		// stable scatter keeps the order of previous digits
+		for (size_t i = 0; i < count; i++)
+			target[offsets[(source[i].key >> shift) & 0xff]++] = source[i];
+
+		DrawPacket* swap = source;
+		source = target;
+		target = swap;
+	}
+
+	if (source != &queue.packets[0])
+		queue.packets.swap(queue.scratch);
+}
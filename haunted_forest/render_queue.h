@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		render_queue.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __RENDER_QUEUE_H
+#define __RENDER_QUEUE_H
+
+#include <vector>
+#include "pgr.h"
+#include "render_stuff.h"
+#include "ecs.h"
+
+/// Render passes in order of drawing.
+enum { RENDER_PASS_OPAQUE, RENDER_PASS_SKYBOX, RENDER_PASS_BLENDED, RENDER_PASS_COUNT };
+
+/// What is drawn by a packet, selects the draw function.
+enum { PACKET_STATIC, PACKET_BAT, PACKET_GROUND, PACKET_GHOST, PACKET_SKYBOX, PACKET_RAIN, PACKET_SMOKE, PACKET_IMPOSTOR };
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// One draw call waiting in the render queue.
+typedef struct DrawPacket {
+	unsigned long long key;			// packets are drawn in ascending order of keys, see makeSortKey()
+	int pass;
+	int kind;
+	int variant;					// kind specific: mesh of still objects (MESH_*), sun on for skybox
+	MeshGeometry* geometry;
+	void* object;					// type depends on kind, EntityDraw for entities (bats, ghost, smoke), NULL for still objects and skybox
+} DrawPacket;
+
+/// Components of entity copied for drawing, the entity keeps changing while the queue waits for drawing.
+typedef struct EntityDraw {
+	TransformComponent transform;				// interpolated between the last two simulation steps
+	ParticleEmitterComponent emitter;			// zero for entities without emitter
+} EntityDraw;
+
+/// Draw packets of one frame, storage is kept between frames.
+typedef struct RenderQueue {
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;	// second buffer of radix sort
+} RenderQueue;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Builds 64-bit sort key of packet.
+/**
+Opaque packets are ordered by pass, program, vertex array, texture and then front-to-back,
+blended packets by pass and back-to-front first, state comes after the depth there.
+Ids are truncated to 8 (program) and 12 bits (vertex array, texture), which only affects the order.
+\param[in]  pass               RENDER_PASS_*.
+\param[in]  program            Shader program used by the draw.
+\param[in]  vertexArray        Vertex array object used by the draw.
+\param[in]  texture            Texture bound to unit 0.
+\param[in]  depth              Distance from the camera along the view direction.
+\return                        Key, packets with lower keys are drawn first.
+*/
+unsigned long long makeSortKey(int pass, GLuint program, GLuint vertexArray, GLuint texture, float depth);
+
+/// Removes all packets, keeps allocated storage.
+void clearRenderQueue(RenderQueue& queue);
+
+/// Adds packet, its key must be already set.
+void pushDrawPacket(RenderQueue& queue, const DrawPacket& packet);
+
+/// Sorts packets by key (LSD radix sort, bytes equal in all keys are skipped).
+void sortRenderQueue(RenderQueue& queue);
+
+#endif // __RENDER_QUEUE_H
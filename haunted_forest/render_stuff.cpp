@@ -4,11 +4,22 @@
 */
 //----------------------------------------------------------------------------------------
 #include <iostream>
+#include <cstddef>
 #include "pgr.h"
 #include "render_stuff.h"
 #include "data.h"
 #include "const.h"
 #include "spline.h"
+#include "mesh_cache.h"
+#include "asset_loader.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "geometry_arena.h"
+#include "mesh_optimizer.h"
+#include "impostor_atlas.h"
+#include "occlusion_buffer.h"
+#include "scene_storage.h"
+#include "ecs.h"
 
 // mesh geometry for all object in scene
 MeshGeometry* tree01MeshGeometry;
@@ -27,152 +38,100 @@ MeshGeometry* batMeshGeometry;
 MeshGeometry* ghostMeshGeometry;
 MeshGeometry* smokeGeometry;
 MeshGeometry* rockMeshGeometry;
+MeshGeometry* impostorGeometry;
+
+// view of the current frame, used for depth sorting and level of detail selection
+glm::mat4 cachedViewMatrix;
+glm::mat4 cachedProjectionMatrix;
+glm::vec3 cachedCameraPosition;
+
+// uniform buffer with FrameData, bound to FRAME_DATA_BINDING
+GLuint frameDataBuffer = 0;
+
+// vertices and indices of all meshes drawn by shaderProgram
+GeometryArena sceneArena;
+// first command of each still object mesh (MESH_*) in the batch of the arena (-1 if nothing is drawn), one command per used level of detail
+int staticBatchCommands[MESH_COUNT];
+int staticBatchCommandCounts[MESH_COUNT];
+// pre-rendered views of tree meshes and instances of distant trees
+ImpostorAtlas treeImpostors;
+// still object meshes with impostors, index is the row in the atlas
+static const int impostorMeshes[] = { MESH_TREE01, MESH_TREE02, MESH_TREE03, MESH_TREE04 };
+static const int impostorNumMeshes = sizeof(impostorMeshes) / sizeof(impostorMeshes[0]);
 
 // used shader program
 SCommonShaderProgram shaderProgram;
 SSkyboxShaderProgram skyboxShaderProgram;
 SRainShaderProgram rainShaderProgram;
 SSmokeShaderProgram smokeShaderProgram;
+SImpostorShaderProgram impostorShaderProgram;
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // LOAD MESH, SET UNIFORMS
 
-/** Load mesh using assimp library
-* \param filename [in] file to open/load
-* \param shader [in] vao will connect loaded data to shader
-* \param vbo [out] vertex and normal data |VVVVV...|NNNNN...| (no interleaving)
-* \param eao [out] triangle indices
-* \param vao [out] vao connects data to shader input
-* \param numTriangles [out] how many triangles have been loaded and stored into index array eao
-*/
-bool loadSingleMesh(const std::string& fileName, SCommonShaderProgram& shader, MeshGeometry** geometry)
-{
-	Assimp::Importer importer;
-
-	importer.SetPropertyInteger(AI_CONFIG_PP_PTV_NORMALIZE, 1); // Unitize object in size (scale the model to fit into (-1..1)^3)
-																// Load asset from the file - you can play with various processing steps
-	const aiScene* scn = importer.ReadFile(fileName.c_str(), 0
-		| aiProcess_Triangulate // Triangulate polygons (if any).
-		| aiProcess_PreTransformVertices // Transforms scene hierarchy into one root with geometry-leafs only. For more see Doc.
-		| aiProcess_GenSmoothNormals // Calculate normals per vertex.
-		| aiProcess_JoinIdenticalVertices);
-	// abort if the loader fails
-	if (scn == NULL) {
-		std::cerr << "assimp error: " << importer.GetErrorString() << std::endl;
-		*geometry = NULL;
-		return false;
-	}
-	// some formats store whole scene (multiple meshes and materials, lights, cameras, ...) in one file, we cannot handle that in our simplified example
-	if (scn->mNumMeshes != 1) {
-		std::cerr << "this simplified loader can only process files with only one mesh" << std::endl;
-		*geometry = NULL;
-		return false;
-	}
-	// in this phase we know we have one mesh in our loaded scene, we can directly copy its data to opengl ...
-	const aiMesh* mesh = scn->mMeshes[0];
-
-	*geometry = new MeshGeometry;
-
-	// vertex buffer object, store all vertex positions and normals
-	glGenBuffers(1, &((*geometry)->vertexBufferObject));
-	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float) * mesh->mNumVertices, 0, GL_STATIC_DRAW); // allocate memory for vertices, normals, and texture coordinates
-																								// first store all vertices
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * sizeof(float) * mesh->mNumVertices, mesh->mVertices);
-	// then store all normals
-	glBufferSubData(GL_ARRAY_BUFFER, 3 * sizeof(float) * mesh->mNumVertices, 3 * sizeof(float) * mesh->mNumVertices, mesh->mNormals);
-
-	// just texture 0 for now
-	float* textureCoords = new float[2 * mesh->mNumVertices]; // 2 floats per vertex
-	float* currentTextureCoord = textureCoords;
-
-	// copy texture coordinates
-	aiVector3D vect;
-
-	if (mesh->HasTextureCoords(0)) {
-		// we use 2D textures with 2 coordinates and ignore the third coordinate
-		for (unsigned int idx = 0; idx < mesh->mNumVertices; idx++) {
-			vect = (mesh->mTextureCoords[0])[idx];
-			*currentTextureCoord++ = vect.x;
-			*currentTextureCoord++ = vect.y;
+// copies positions and triangles of level of detail, positions are the first 3 floats of vertices in all formats
+static PositionMesh* createPositionMesh(const MeshData& data, unsigned int lod)
+{
+	PositionMesh* positionMesh = new PositionMesh();
+	unsigned int firstIndex = 0;
+	for (unsigned int level = 0; level < lod; level++)
+		firstIndex += data.lodNumIndices[level];
+	unsigned int endIndex = firstIndex + data.lodNumIndices[lod];
+
+	// only vertices used by the level are kept
+	std::vector<unsigned int> remap(data.numVertices, ~0u);
+	positionMesh->indices.reserve(endIndex - firstIndex);
+	for (unsigned int i = firstIndex; i < endIndex; i++) {
+		unsigned int index = data.indexSize == sizeof(unsigned short) ? ((const unsigned short*)data.indices)[i] : ((const unsigned int*)data.indices)[i];
+		if (remap[index] == ~0u) {
+			remap[index] = (unsigned int)positionMesh->vertices.size();
+			const float* position = (const float*)((const unsigned char*)data.vertices + index * data.vertexStride);
+			positionMesh->vertices.push_back(glm::vec3(position[0], position[1], position[2]));
 		}
+		positionMesh->indices.push_back(remap[index]);
 	}
+	return positionMesh;
+}
 
-	// finally store all texture coordinates
-	glBufferSubData(GL_ARRAY_BUFFER, 6 * sizeof(float) * mesh->mNumVertices, 2 * sizeof(float) * mesh->mNumVertices, textureCoords);
-
-	// copy all mesh faces into one big array (assimp supports faces with ordinary number of vertices, we use only 3 -> triangles)
-	unsigned int* indices = new unsigned int[mesh->mNumFaces * 3];
-	for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
-		indices[f * 3 + 0] = mesh->mFaces[f].mIndices[0];
-		indices[f * 3 + 1] = mesh->mFaces[f].mIndices[1];
-		indices[f * 3 + 2] = mesh->mFaces[f].mIndices[2];
-	}
-	// copy our temporary index array to OpenGL and free the array
-	glGenBuffers(1, &((*geometry)->elementBufferObject));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (*geometry)->elementBufferObject);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3 * sizeof(unsigned) * mesh->mNumFaces, indices, GL_STATIC_DRAW);
-
-	delete[] indices;
+/** Place loaded mesh to the scene arena, texture is not loaded here
+* \param data [in] interleaved vertex data |VNT|VNT|... in format of the arena, triangle indices (16 or 32 bits) and material
+* \param geometry [out] place in the arena (vao is set when the arena is uploaded) and material
+*/
+void createMeshGeometry(const MeshData& data, MeshGeometry** geometry)
+{
+	*geometry = new MeshGeometry();
+	addArenaMesh(sceneArena, data, *geometry);
+	(*geometry)->bounds = data.bounds;
+	(*geometry)->positionMesh = createPositionMesh(data, 0);
 
 	// copy the material info to MeshGeometry structure
-	const aiMaterial* mat = scn->mMaterials[mesh->mMaterialIndex];
-	aiColor3D color;
-	aiString name;
-
-	// Get returns: aiReturn_SUCCESS 0 | aiReturn_FAILURE -1 | aiReturn_OUTOFMEMORY -3
-	mat->Get(AI_MATKEY_NAME, name); // may be "" after the input mesh processing. Must be aiString type!
-	mat->Get<aiColor3D>(AI_MATKEY_COLOR_DIFFUSE, color);
-	(*geometry)->diffuse = glm::vec3(color.r, color.g, color.b);
-	mat->Get<aiColor3D>(AI_MATKEY_COLOR_AMBIENT, color);
-	(*geometry)->ambient = glm::vec3(color.r, color.g, color.b);
-	mat->Get<aiColor3D>(AI_MATKEY_COLOR_SPECULAR, color);
-	(*geometry)->specular = glm::vec3(color.r, color.g, color.b);
-	float shininess;
-
-	mat->Get<float>(AI_MATKEY_SHININESS, shininess);
-	(*geometry)->shininess = shininess / 4.0f; // shininess divisor-not descibed anywhere
-
+	(*geometry)->ambient = data.ambient;
+	(*geometry)->diffuse = data.diffuse;
+	(*geometry)->specular = data.specular;
+	(*geometry)->shininess = data.shininess;
 	(*geometry)->texture = 0;
+}
 
-	// load texture image
-	if (mat->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-		// get texture name
-		mat->Get<aiString>(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), name);
-		std::string textureName = name.data;
-
-		size_t found = fileName.find_last_of("/\\");
-		// insert correct texture file path
-		if (found != std::string::npos) { // not found
-											//subMesh_p->textureName.insert(0, "/");
-			textureName.insert(0, fileName.substr(0, found + 1));
-		}
-
-		std::cout << "Loading texture file: " << textureName << std::endl;
-
-		(*geometry)->texture = pgr::createTexture(textureName);
-	}
-
-	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
-	glBindVertexArray((*geometry)->vertexArrayObject);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (*geometry)->elementBufferObject); // bind our element array buffer (indices) to vao
-	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
-
-	glEnableVertexAttribArray(shader.posLocation);
-	glVertexAttribPointer(shader.posLocation, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-	glEnableVertexAttribArray(shader.texCoordLocation);
-
-	glVertexAttribPointer(shader.texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, (void*)(6 * sizeof(float) * mesh->mNumVertices));
-
-	glEnableVertexAttribArray(shader.normalLocation);
-	glVertexAttribPointer(shader.normalLocation, 3, GL_FLOAT, GL_FALSE, 0, (void*)(3 * sizeof(float) * mesh->mNumVertices));
-
-	glBindVertexArray(0);
-
-	(*geometry)->numTriangles = mesh->mNumFaces;
-
-	return true;
+// places mesh from data.h (float vertices |VNT|, 32-bit indices) to the scene arena
+static void createStaticMeshGeometry(const float* vertices, int numVertices, const unsigned* triangles, int numTriangles, MeshGeometry* geometry)
+{
+	MeshData data;
+	initMeshData(data);
+	data.vertexStorage.assign((const unsigned char*)vertices, (const unsigned char*)(vertices + numVertices * MESH_FLOATS_PER_VERTEX));
+	data.indexStorage.assign((const unsigned char*)triangles, (const unsigned char*)(triangles + numTriangles * 3));
+	data.vertices = data.vertexStorage.empty() ? NULL : &data.vertexStorage[0];
+	data.indices = data.indexStorage.empty() ? NULL : &data.indexStorage[0];
+	data.numVertices = numVertices;
+	data.numIndices = numTriangles * 3;
+	data.lodNumIndices[0] = data.numIndices;
+	data.vertexStride = MESH_FLOATS_PER_VERTEX * sizeof(float);
+	data.vertexFormat = MESH_FORMAT_FLOAT;
+	data.indexSize = sizeof(unsigned int);
+
+	convertMesh(data, sceneArena.vertexFormat);
+	addArenaMesh(sceneArena, data, geometry);
+	geometry->positionMesh = createPositionMesh(data, 0);
+	releaseMeshData(data);
 }
 
 /**
@@ -187,7 +146,6 @@ void setTransformUniforms(const glm::mat4& modelMatrix, const glm::mat4& viewMat
 
 	glm::mat4 PVM = projectionMatrix * viewMatrix * modelMatrix;
 	glUniformMatrix4fv(shaderProgram.PVMmatrixLocation, 1, GL_FALSE, glm::value_ptr(PVM)); //value_ptr vraci pointer
-	glUniformMatrix4fv(shaderProgram.VmatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
 	glUniformMatrix4fv(shaderProgram.MmatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
 	glm::mat4 normalMatrix = glm::transpose(glm::inverse(viewMatrix * modelMatrix));
 	glUniformMatrix4fv(shaderProgram.normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix)); // correct matrix for non-rigid transform
@@ -210,15 +168,332 @@ void setMaterialUniforms(const glm::vec3& ambient, const glm::vec3& diffuse, con
 
 	if (texture != 0) {
 		glUniform1i(shaderProgram.useTextureLocation, 1); // do texture sampling
-		glUniform1i(shaderProgram.texSamplerLocation, 0); // texturing unit 0 -> samplerID   [for the GPU linker]
-		glActiveTexture(GL_TEXTURE0 + 0); // texturing unit 0 -> to be bound [for OpenGL BindTexture]
-		glBindTexture(GL_TEXTURE_2D, texture);
+		bindTexture(0, GL_TEXTURE_2D, texture); // texturing unit 0, texSampler is set to it once at initialization
 	}
 	else {
 		glUniform1i(shaderProgram.useTextureLocation, 0); // do not sample the texture
 	}
 }
 
+/**
+Model matrix of still objects (trees, skull, mushrooms) placed on the ground.
+\param[in] position
+\param[in] direction
+\param[in] size
+*/
+glm::mat4 getStillObjectModelMatrix(glm::vec3 position, const glm::vec3& direction, float size)
+{
+	glm::mat4 modelMatrix = alignObject(position, direction, glm::vec3(0.0f, 0.0f, 1.0f));
+	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 0.2f, 0.0f));
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(size));
+	return modelMatrix;
+}
+
+/**
+Fills the transform cache of object which does not move.
+\param[out] transform
+\param[in] modelMatrix
+*/
+void setTransformCache(TransformCache& transform, const glm::mat4& modelMatrix)
+{
+	transform.modelMatrix = modelMatrix;
+	transform.normalModelMatrix = glm::transpose(glm::inverse(modelMatrix)); // the only inversion, done once per object
+}
+
+// transform of trees, skull, mushrooms (dense index in scene) ~ call whenever the object is placed
+void setStillObjectTransform(SceneStorage& scene, unsigned int index)
+{
+	setTransformCache(scene.transforms[index], getStillObjectModelMatrix(scene.positions[index], scene.directions[index], scene.sizes[index]));
+	scene.lods[index] = 0;
+}
+
+// transform of rock (dense index in scene)
+void setRockTransform(SceneStorage& scene, unsigned int index)
+{
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), scene.positions[index]);
+	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 0.0f, 0.02f));
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(scene.sizes[index]));
+	setTransformCache(scene.transforms[index], modelMatrix);
+	scene.lods[index] = 0;
+}
+
+/**
+Sets view and projection of current frame.
+\param[in] viewMatrix
+\param[in] projectionMatrix
+\return true if the view or projection has changed since the last frame
+*/
+bool setViewProjection(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+	if (viewMatrix == cachedViewMatrix && projectionMatrix == cachedProjectionMatrix)
+		return false;
+
+	cachedViewMatrix = viewMatrix;
+	cachedProjectionMatrix = projectionMatrix;
+
+	// view matrix is rigid, the camera is at minus its translation rotated back
+	glm::mat4 viewRotation = viewMatrix;
+	viewRotation[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	cachedCameraPosition = -glm::vec3(glm::transpose(viewRotation) * viewMatrix[3]);
+	return true;
+}
+
+/**
+Fills matrices of per-frame uniforms, no GL calls are made.
+\param[in,out] frame matrices are filled here
+\param[in] viewMatrix
+\param[in] projectionMatrix
+*/
+void setFrameMatrices(FrameData& frame, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+	frame.Vmatrix = viewMatrix;
+	frame.Pmatrix = projectionMatrix;
+	frame.PVmatrix = projectionMatrix * viewMatrix;
+
+	// skybox vertex shader translates screen space coordinates (NDC) using inverse PV matrix of view rotation
+	glm::mat4 viewRotation = viewMatrix;
+	viewRotation[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	frame.inversePVmatrix = glm::inverse(projectionMatrix * viewRotation);
+}
+
+/**
+Uploads per-frame uniforms, all programs read the data from the uniform buffer, nothing has to
+be set per program.
+\param[in] frame lights, fog and matrices
+*/
+void uploadFrameData(const FrameData& frame)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, frameDataBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_STREAM_DRAW); // orphan buffer still used by previous frame
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+Uploads per-frame uniforms, lights and fog must be already set in \a frame.
+\param[in,out] frame lights and fog, matrices are filled here
+\param[in] viewMatrix
+\param[in] projectionMatrix
+*/
+void setFrameData(FrameData& frame, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+	setFrameMatrices(frame, viewMatrix, projectionMatrix);
+	uploadFrameData(frame);
+}
+
+// connects uniform block FrameData of program to the shared buffer
+static void bindFrameData(GLuint program)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(program, "FrameData");
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, blockIndex, FRAME_DATA_BINDING);
+}
+
+// model space bounds of still object mesh (MESH_*)
+const BoundingBox& getMeshBoundingBox(int mesh)
+{
+	switch (mesh)
+	{
+	case MESH_TREE01:
+		return tree01MeshGeometry->bounds;
+	case MESH_TREE02:
+		return tree02MeshGeometry->bounds;
+	case MESH_TREE03:
+		return tree03MeshGeometry->bounds;
+	case MESH_TREE04:
+		return tree04MeshGeometry->bounds;
+	case MESH_EXTRA:
+		return extraMeshGeometry->bounds;
+	case MESH_EXTRA_NEG:
+		return extraNegMeshGeometry->bounds;
+	case MESH_SKULL:
+		return skullMeshGeometry->bounds;
+	case MESH_MUSHROOM:
+		return mushroomMeshGeometry->bounds;
+	default:
+		return rockMeshGeometry->bounds;
+	}
+}
+
+// geometry of still object mesh (MESH_*)
+static MeshGeometry* getMeshGeometry(int mesh)
+{
+	switch (mesh)
+	{
+	case MESH_TREE01:
+		return tree01MeshGeometry;
+	case MESH_TREE02:
+		return tree02MeshGeometry;
+	case MESH_TREE03:
+		return tree03MeshGeometry;
+	case MESH_TREE04:
+		return tree04MeshGeometry;
+	case MESH_EXTRA:
+		return extraMeshGeometry;
+	case MESH_EXTRA_NEG:
+		return extraNegMeshGeometry;
+	case MESH_SKULL:
+		return skullMeshGeometry;
+	case MESH_MUSHROOM:
+		return mushroomMeshGeometry;
+	default:
+		return rockMeshGeometry;
+	}
+}
+
+// positions of still object (MESH_*) for software occlusion culling and picking by rays
+const PositionMesh* getMeshPositionMesh(int mesh)
+{
+	return getMeshGeometry(mesh)->positionMesh;
+}
+
+// positions of the ground for picking by rays, NULL if not loaded
+const PositionMesh* getGroundPositionMesh(void)
+{
+	return groundMeshGeometry != NULL ? groundMeshGeometry->positionMesh : NULL;
+}
+
+// placement of ground mesh
+glm::mat4 getGroundModelMatrix(const GroundObject* ground)
+{
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), ground->position);
+	modelMatrix = glm::rotate(modelMatrix, ground->viewAngle, glm::vec3(0, 0, 1));
+	return glm::scale(modelMatrix, glm::vec3(ground->size.x, ground->size.y, ground->size.z));
+}
+
+// row of still object mesh (MESH_*) in the impostor atlas, -1 if it is not baked
+static int getImpostorRow(int mesh)
+{
+	if (treeImpostors.texture == 0)
+		return -1;
+	for (int row = 0; row < impostorNumMeshes; row++)
+		if (impostorMeshes[row] == mesh)
+			return row;
+	return -1;
+}
+
+// world bounding sphere of still object (dense index in scene)
+static void getObjectSphere(const SceneStorage& scene, unsigned int index, int mesh, glm::vec3& center, float& radius)
+{
+	const BoundingBox& bounds = getMeshBoundingBox(mesh);
+	const glm::mat4& modelMatrix = scene.transforms[index].modelMatrix;
+	center = glm::vec3(modelMatrix * glm::vec4(0.5f * (bounds.min + bounds.max), 1.0f));
+	radius = 0.5f * glm::length(bounds.max - bounds.min) * glm::length(glm::vec3(modelMatrix[0]));
+}
+
+// start new batch of still objects
+static void clearStaticBatch()
+{
+	clearArenaBatch(sceneArena);
+	clearImpostorInstances(treeImpostors);
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++) {
+		staticBatchCommands[mesh] = -1;
+		staticBatchCommandCounts[mesh] = 0;
+	}
+}
+
+/**
+Selects level of detail of still object by projected size of its bounding sphere, trees
+further than IMPOSTOR_DISTANCE are drawn as impostors. The object keeps its current level
+until it gets LOD_HYSTERESIS past the threshold, so that levels do not switch back and forth
+(pop) while the camera moves around the threshold.
+\param[in,out] scene lod of the object is updated
+\param[in] index dense index of the object
+\param[in] mesh MESH_*
+\return level to draw, 0 is the full mesh, LOD_IMPOSTOR for impostor
+*/
+int selectObjectLod(SceneStorage& scene, unsigned int index, int mesh)
+{
+	static const float screenSizes[] = { LOD_SCREEN_SIZE_1, LOD_SCREEN_SIZE_2 };
+
+	const MeshGeometry* geometry = getMeshGeometry(mesh);
+	glm::vec3 center;
+	float radius;
+	getObjectSphere(scene, index, mesh, center, radius);
+	float depth = -(cachedViewMatrix * glm::vec4(center, 1.0f)).z;
+
+	if (getImpostorRow(mesh) >= 0) {
+		float distance = IMPOSTOR_DISTANCE;
+		if (scene.lods[index] == LOD_IMPOSTOR)
+			distance *= 1.0f - LOD_HYSTERESIS;
+		if (depth > distance) {
+			scene.lods[index] = LOD_IMPOSTOR;
+			return LOD_IMPOSTOR;
+		}
+	}
+
+	// fraction of viewport height covered by the sphere, camera inside the sphere gets the full mesh
+	int lod = 0;
+	if (depth > radius) {
+		float screenSize = radius * cachedProjectionMatrix[1][1] / depth;
+		for (int level = 1; level < geometry->numLods && level <= (int)(sizeof(screenSizes) / sizeof(screenSizes[0])); level++) {
+			float threshold = screenSizes[level - 1];
+			if (scene.lods[index] >= level)
+				threshold *= 1.0f + LOD_HYSTERESIS;
+			if (screenSize < threshold)
+				lod = level;
+		}
+	}
+
+	scene.lods[index] = lod;
+	return lod;
+}
+
+// adds still objects of one mesh to the batch, objects of each level of detail are drawn by one command, commands of the mesh follow each other
+static void addStaticInstances(int mesh, glm::mat4* const modelMatrices[MESH_MAX_LODS], const unsigned int counts[MESH_MAX_LODS])
+{
+	MeshGeometry* geometry = getMeshGeometry(mesh);
+	for (int lod = 0; lod < MESH_MAX_LODS; lod++) {
+		int command = addArenaBatchDraw(sceneArena, geometry, lod, modelMatrices[lod], counts[lod]);
+		if (command < 0)
+			continue;
+		if (staticBatchCommands[mesh] < 0)
+			staticBatchCommands[mesh] = command;
+		staticBatchCommandCounts[mesh]++;
+	}
+}
+
+/**
+Makes impostor instance of distant still object, all of them are drawn by one instanced draw.
+The view of the atlas is the one closest to the direction from the object to the camera,
+setViewProjection() must be called before.
+\param[in] scene
+\param[in] index dense index of the object
+\param[in] mesh MESH_* with impostor
+\param[out] instance
+\return false if the mesh has no impostor
+*/
+bool getStaticImpostor(const SceneStorage& scene, unsigned int index, int mesh, ImpostorInstance& instance)
+{
+	int row = getImpostorRow(mesh);
+	if (row < 0)
+		return false;
+
+	glm::vec3 center;
+	float radius;
+	getObjectSphere(scene, index, mesh, center, radius);
+
+	// inverse of model rotation and scale, normalModelMatrix is the inverse transposed
+	glm::vec3 direction = glm::transpose(glm::mat3(scene.transforms[index].normalModelMatrix)) * (cachedCameraPosition - center);
+	instance = makeImpostorInstance(row, getImpostorView(treeImpostors, direction), center, radius);
+	return true;
+}
+
+/**
+Replaces the batch of still objects and sends it to GPU.
+\param[in] batch visible objects sorted by mesh and level of detail, distant trees as impostors
+*/
+void uploadStaticBatch(const StaticBatch& batch)
+{
+	clearStaticBatch();
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+		addStaticInstances(mesh, batch.modelMatrices[mesh], batch.counts[mesh]);
+	setImpostorInstances(treeImpostors, batch.impostors, batch.numImpostors);
+
+	uploadArenaBatch(sceneArena);
+	uploadImpostorInstances(treeImpostors);
+}
+
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // INITIALIZATION
 
@@ -237,13 +512,15 @@ void initializeShaderPrograms(void)
 	shaderProgram.normalLocation = glGetAttribLocation(shaderProgram.program, "normal");
 	shaderProgram.texCoordLocation = glGetAttribLocation(shaderProgram.program, "texCoord");
 	shaderProgram.colorLocation = glGetAttribLocation(shaderProgram.program, "color");
-	shaderProgram.timeLocation = glGetUniformLocation(shaderProgram.program, "time");
 	
 	// matrix
-	shaderProgram.VmatrixLocation = glGetUniformLocation(shaderProgram.program, "Vmatrix");
 	shaderProgram.PVMmatrixLocation = glGetUniformLocation(shaderProgram.program, "PVMmatrix");
 	shaderProgram.MmatrixLocation = glGetUniformLocation(shaderProgram.program, "Mmatrix");
 	shaderProgram.normalMatrixLocation = glGetUniformLocation(shaderProgram.program, "normalMatrix");
+
+	// instancing
+	shaderProgram.instanceMatrixLocation = glGetAttribLocation(shaderProgram.program, "instanceMatrix");
+	shaderProgram.useInstancingLocation = glGetUniformLocation(shaderProgram.program, "useInstancing");
 	
 	// material
 	shaderProgram.ambientLocation = glGetUniformLocation(shaderProgram.program, "material.ambient");
@@ -255,22 +532,8 @@ void initializeShaderPrograms(void)
 	shaderProgram.texSamplerLocation = glGetUniformLocation(shaderProgram.program, "texSampler");
 	shaderProgram.useTextureLocation = glGetUniformLocation(shaderProgram.program, "material.useTexture");
 	
-	//reflector
-	shaderProgram.reflectorOnLocation = glGetUniformLocation(shaderProgram.program, "reflectorOn");
-	shaderProgram.reflectorPositionLocation = glGetUniformLocation(shaderProgram.program, "reflectorPosition");
-	shaderProgram.reflectorDirectionLocation = glGetUniformLocation(shaderProgram.program, "reflectorDirection");
-	
-	//fog
-	shaderProgram.fogOnLocation = glGetUniformLocation(shaderProgram.program, "fogOn");
-	shaderProgram.fogColorLocation = glGetUniformLocation(shaderProgram.program, "fogColor");
-	shaderProgram.fogDensityLocation = glGetUniformLocation(shaderProgram.program, "fogDensity");
-	
-	//sun
-	shaderProgram.sunOnLocation = glGetUniformLocation(shaderProgram.program, "sunOn");
-	
-	//pointlight
-	shaderProgram.pointlightPositionLocation = glGetUniformLocation(shaderProgram.program, "pointlightPosition");
-	shaderProgram.pointlightOnLocation = glGetUniformLocation(shaderProgram.program, "pointlightOn");
+	// lights, fog and view
+	bindFrameData(shaderProgram.program);
 
 	shaderList.clear();
 
@@ -281,10 +544,10 @@ void initializeShaderPrograms(void)
 
 	rainShaderProgram.posLocation = glGetAttribLocation(rainShaderProgram.program, "position");
 	rainShaderProgram.texCoordLocation = glGetAttribLocation(rainShaderProgram.program, "texCoord");
-	rainShaderProgram.timeLocation = glGetUniformLocation(rainShaderProgram.program, "time");
-	rainShaderProgram.PVMmatrixLocation = glGetUniformLocation(rainShaderProgram.program, "PVMmatrix");
+	rainShaderProgram.MmatrixLocation = glGetUniformLocation(rainShaderProgram.program, "Mmatrix");
 	rainShaderProgram.texSamplerLocation = glGetUniformLocation(rainShaderProgram.program, "texSampler");
 	rainShaderProgram.texTransMatrixLocation = glGetUniformLocation(rainShaderProgram.program, "texTransMatrix");
+	bindFrameData(rainShaderProgram.program);
 
 	shaderList.clear();
 
@@ -296,10 +559,7 @@ void initializeShaderPrograms(void)
 	skyboxShaderProgram.screenCoordLocation = glGetAttribLocation(skyboxShaderProgram.program, "screenCoord");
 
 	skyboxShaderProgram.skyboxSamplerLocation = glGetUniformLocation(skyboxShaderProgram.program, "skyboxSampler");
-	skyboxShaderProgram.inversePVmatrixLocation = glGetUniformLocation(skyboxShaderProgram.program, "inversePVmatrix");
-	skyboxShaderProgram.fogOnLocation = glGetUniformLocation(skyboxShaderProgram.program, "fogOn");
-	skyboxShaderProgram.fogColorLocation = glGetUniformLocation(shaderProgram.program, "fogColor");
-	skyboxShaderProgram.fogDensityLocation = glGetUniformLocation(shaderProgram.program, "fogDensity");
+	bindFrameData(skyboxShaderProgram.program);
 
 	shaderList.clear();
 
@@ -311,59 +571,69 @@ void initializeShaderPrograms(void)
 	smokeShaderProgram.posLocation = glGetAttribLocation(smokeShaderProgram.program, "position");
 	smokeShaderProgram.texCoordLocation = glGetAttribLocation(smokeShaderProgram.program, "texCoord");
 
-	smokeShaderProgram.timeLocation = glGetUniformLocation(smokeShaderProgram.program, "time");
-	smokeShaderProgram.PVMmatrixLocation = glGetUniformLocation(smokeShaderProgram.program, "PVMmatrix");
-	smokeShaderProgram.VmatrixLocation = glGetUniformLocation(smokeShaderProgram.program, "Vmatrix");
+	smokeShaderProgram.timeLocation = glGetUniformLocation(smokeShaderProgram.program, "smokeTime");
+	smokeShaderProgram.MmatrixLocation = glGetUniformLocation(smokeShaderProgram.program, "Mmatrix");
 	smokeShaderProgram.texSamplerLocation = glGetUniformLocation(smokeShaderProgram.program, "texSampler");
 	smokeShaderProgram.frameDurationLocation = glGetUniformLocation(smokeShaderProgram.program, "frameDuration");
+	bindFrameData(smokeShaderProgram.program);
 	
 	shaderList.clear();
+
+	//impostors
+	shaderList.push_back(pgr::createShaderFromFile(GL_VERTEX_SHADER, "impostor.vert"));
+	shaderList.push_back(pgr::createShaderFromFile(GL_FRAGMENT_SHADER, "impostor.frag"));
+	impostorShaderProgram.program = pgr::createProgram(shaderList);
+
+	impostorShaderProgram.cornerLocation = glGetAttribLocation(impostorShaderProgram.program, "corner");
+	impostorShaderProgram.instanceCenterLocation = glGetAttribLocation(impostorShaderProgram.program, "instanceCenter");
+	impostorShaderProgram.instanceTileLocation = glGetAttribLocation(impostorShaderProgram.program, "instanceTile");
+	impostorShaderProgram.atlasTilesLocation = glGetUniformLocation(impostorShaderProgram.program, "atlasTiles");
+	impostorShaderProgram.texSamplerLocation = glGetUniformLocation(impostorShaderProgram.program, "texSampler");
+	bindFrameData(impostorShaderProgram.program);
+
+	shaderList.clear();
+
+	// shared per-frame uniforms
+	glGenBuffers(1, &frameDataBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameDataBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameDataBuffer);
+
+	// all programs sample from texturing unit 0, samplers never change
+	glUseProgram(shaderProgram.program);
+	glUniform1i(shaderProgram.texSamplerLocation, 0);
+	glUseProgram(rainShaderProgram.program);
+	glUniform1i(rainShaderProgram.texSamplerLocation, 0);
+	glUseProgram(skyboxShaderProgram.program);
+	glUniform1i(skyboxShaderProgram.skyboxSamplerLocation, 0);
+	glUseProgram(smokeShaderProgram.program);
+	glUniform1i(smokeShaderProgram.texSamplerLocation, 0);
+	glUseProgram(impostorShaderProgram.program);
+	glUniform1i(impostorShaderProgram.texSamplerLocation, 0);
+	glUniform2i(impostorShaderProgram.atlasTilesLocation, IMPOSTOR_VIEWS, impostorNumMeshes);
+	glUseProgram(0);
 }
 
 // init ground - material
-void initgroundMeshGeometry(SCommonShaderProgram& shader, MeshGeometry** geometry)
+void initgroundMeshGeometry(MeshGeometry** geometry, AssetLoader& loader)
 {
-	*geometry = new MeshGeometry;
-	(*geometry)->texture = pgr::createTexture(GROUND_TEXTURE);
+	*geometry = new MeshGeometry();
+	loadTextureAsync(loader, GROUND_TEXTURE, &(*geometry)->texture);
 	//CHECK_GL_ERROR();
 	(*geometry)->ambient = glm::vec3(0.520f, 0.34f, 0.38f);
 	(*geometry)->diffuse = glm::vec3(1.0f, 1.0f, 0.7f);
 	(*geometry)->specular = glm::vec3(1.0f, 1.0f, 1.0f);
 	(*geometry)->shininess = 0.7f;
-	(*geometry)->numTriangles = planeNTriangles;
 
-	//VAO
-	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
-	glBindVertexArray((*geometry)->vertexArrayObject);
-
-	//VBO
-	glGenBuffers(1, &((*geometry)->vertexBufferObject));
-	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-
-	//EBO
-	glGenBuffers(1, &((*geometry)->elementBufferObject));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (*geometry)->elementBufferObject);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(planeTriangles), planeTriangles, GL_STATIC_DRAW);
-
-	// enable and initialize the attributes array 
-	glEnableVertexAttribArray(shader.posLocation);
-	glVertexAttribPointer(shader.posLocation, 3, GL_FLOAT, GL_FALSE, planeNAttribsPerVertex * sizeof(float), 0);
-
-	glEnableVertexAttribArray(shader.normalLocation);
-	glVertexAttribPointer(shader.normalLocation, 3, GL_FLOAT, GL_FALSE, planeNAttribsPerVertex * sizeof(float), (void*)(3 * sizeof(float)));
-
-	glEnableVertexAttribArray(shader.texCoordLocation);
-	glVertexAttribPointer(shader.texCoordLocation, 2, GL_FLOAT, GL_FALSE, planeNAttribsPerVertex * sizeof(float), (void*)(6 * sizeof(float)));
-
-	glBindVertexArray(0);
+	createStaticMeshGeometry(planeVertices, planeNVertices, planeTriangles, planeNTriangles, *geometry);
 }
 
 // init rain
-void initRainGeometry(GLuint shader, MeshGeometry **geometry) 
+void initRainGeometry(GLuint shader, MeshGeometry **geometry, AssetLoader& loader) 
 {
-	*geometry = new MeshGeometry;
-	(*geometry)->texture = pgr::createTexture(RAIN_TEXTURE);
+	*geometry = new MeshGeometry();
+	loadTextureAsync(loader, RAIN_TEXTURE, &(*geometry)->texture);
 	(*geometry)->numTriangles = 2;
 
 	//VAO
@@ -382,18 +652,15 @@ void initRainGeometry(GLuint shader, MeshGeometry **geometry)
 	//texture coords
 	glVertexAttribPointer(rainShaderProgram.texCoordLocation, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(9 * sizeof(float)));
 
-	glBindTexture(GL_TEXTURE_2D, (*geometry)->texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-
 	glBindVertexArray(0);
 }
 
 //init smoke
-void initSmokeGeometry(GLuint shader, MeshGeometry**geometry)
+void initSmokeGeometry(GLuint shader, MeshGeometry**geometry, AssetLoader& loader)
 {
-	*geometry = new MeshGeometry;
+	*geometry = new MeshGeometry();
 
-	(*geometry)->texture = pgr::createTexture(SMOKE_TEXTURE);
+	loadTextureAsync(loader, SMOKE_TEXTURE, &(*geometry)->texture);
 	(*geometry)->numTriangles = smokeNumQuadVertices;
 
 	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
@@ -412,45 +679,110 @@ void initSmokeGeometry(GLuint shader, MeshGeometry**geometry)
 	glBindVertexArray(0);
 }
 
-//init rock - material
-void initrockMeshGeometry(SCommonShaderProgram& shader, MeshGeometry** geometry)
+// init impostors ~ quad with per-instance center and tile of the atlas, texture is the atlas
+void initImpostorGeometry(MeshGeometry** geometry)
 {
-	*geometry = new MeshGeometry;
-	(*geometry)->texture = pgr::createTexture(ROCK_TEXTURE);
-	(*geometry)->ambient = glm::vec3(0.1f, 0.1f, 0.1f);
-	(*geometry)->diffuse = glm::vec3(0.86f, 0.85f, 0.84f);
-	(*geometry)->specular = glm::vec3(0.18f, 0.31f, 0.31f);
-	(*geometry)->shininess = 0.7f;
-	(*geometry)->numTriangles = rockNTriangles;
+	*geometry = new MeshGeometry();
+	(*geometry)->texture = treeImpostors.texture;
+	(*geometry)->numTriangles = impostorNumQuadVertices;
 
 	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
 	glBindVertexArray((*geometry)->vertexArrayObject);
-
 	glGenBuffers(1, &((*geometry)->vertexBufferObject));
+
 	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(rockVertices), rockVertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(impostorQuad), impostorQuad, GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(impostorShaderProgram.cornerLocation);
+	glVertexAttribPointer(impostorShaderProgram.cornerLocation, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+
+	// advanced once per instance, nothing is drawn if the atlas was not baked
+	if (treeImpostors.instanceBufferObject != 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, treeImpostors.instanceBufferObject);
+		glEnableVertexAttribArray(impostorShaderProgram.instanceCenterLocation);
+		glVertexAttribPointer(impostorShaderProgram.instanceCenterLocation, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, center));
+		glVertexAttribDivisor(impostorShaderProgram.instanceCenterLocation, 1);
+		glEnableVertexAttribArray(impostorShaderProgram.instanceTileLocation);
+		glVertexAttribPointer(impostorShaderProgram.instanceTileLocation, 2, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, tile));
+		glVertexAttribDivisor(impostorShaderProgram.instanceTileLocation, 1);
+	}
 
-	glGenBuffers(1, &((*geometry)->elementBufferObject));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (*geometry)->elementBufferObject);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(rockTriangles), rockTriangles, GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	// enable and initialize the attributes array 
-	glEnableVertexAttribArray(shader.posLocation);
-	glVertexAttribPointer(shader.posLocation, 3, GL_FLOAT, GL_FALSE, rockNAttribsPerVertex * sizeof(float), 0);
+/**
+Renders tree meshes to the impostor atlas, IMPOSTOR_VIEWS views around their vertical axis
+with and without the sun. Other lights and fog are off, fog is added when impostors are drawn.
+Meshes must be in the uploaded scene arena. Without framebuffer support trees keep their meshes.
+*/
+static void bakeTreeImpostors()
+{
+	if (!initImpostorAtlas(treeImpostors, impostorNumMeshes, IMPOSTOR_VIEWS, IMPOSTOR_TILE_SIZE)) {
+		std::cerr << "Impostor atlas cannot be rendered, distant trees use meshes" << std::endl;
+		return;
+	}
 
-	glEnableVertexAttribArray(shader.normalLocation);
-	glVertexAttribPointer(shader.normalLocation, 3, GL_FLOAT, GL_FALSE, rockNAttribsPerVertex * sizeof(float), (void*)(3 * sizeof(float)));
+	FrameData frame;
+	frame.fogColor = glm::vec4(0.0f);
+	frame.fogDensity = 0.0f;
+	frame.time = 0.0f;
+	frame.fogOn = false;
+	frame.reflectorOn = false;
+	frame.pointlightOn = false;
+
+	beginImpostorBake(treeImpostors);
+	setDepthTest(true);
+	setBlend(false);
+	useProgram(shaderProgram.program);
+	glUniform1i(shaderProgram.useInstancingLocation, 0);
+	bindVertexArray(sceneArena.vertexArrayObject);
+
+	for (int sun = 0; sun < 2; sun++) {
+		frame.sunOn = sun == 0;
+		for (int row = 0; row < impostorNumMeshes; row++) {
+			MeshGeometry* geometry = getMeshGeometry(impostorMeshes[row]);
+			if (geometry == NULL)
+				continue;
+			setMaterialUniforms(geometry->ambient, geometry->diffuse, geometry->specular, geometry->shininess, geometry->texture);
+
+			for (int view = 0; view < IMPOSTOR_VIEWS; view++) {
+				glm::mat4 viewMatrix, projectionMatrix;
+				setImpostorTile(treeImpostors, row, view, sun == 0, geometry->bounds, viewMatrix, projectionMatrix);
+				setFrameData(frame, viewMatrix, projectionMatrix);
+				setTransformUniforms(glm::mat4(1.0f), viewMatrix, projectionMatrix);
+				drawArenaMesh(sceneArena, geometry);
+			}
+		}
+	}
 
-	glEnableVertexAttribArray(shader.texCoordLocation);
-	glVertexAttribPointer(shader.texCoordLocation, 2, GL_FLOAT, GL_FALSE, rockNAttribsPerVertex * sizeof(float), (void*)(6 * sizeof(float)));
+	endImpostorBake(treeImpostors);
+}
 
-	glBindVertexArray(0);
+//init rock - material
+void initrockMeshGeometry(MeshGeometry** geometry, AssetLoader& loader)
+{
+	*geometry = new MeshGeometry();
+	loadTextureAsync(loader, ROCK_TEXTURE, &(*geometry)->texture);
+	(*geometry)->ambient = glm::vec3(0.1f, 0.1f, 0.1f);
+	(*geometry)->diffuse = glm::vec3(0.86f, 0.85f, 0.84f);
+	(*geometry)->specular = glm::vec3(0.18f, 0.31f, 0.31f);
+	(*geometry)->shininess = 0.7f;
+
+	(*geometry)->bounds.min = (*geometry)->bounds.max = glm::vec3(rockVertices[0], rockVertices[1], rockVertices[2]);
+	for (int i = 1; i < rockNVertices; i++) {
+		const float* vertex = rockVertices + i * rockNAttribsPerVertex;
+		(*geometry)->bounds.min = glm::min((*geometry)->bounds.min, glm::vec3(vertex[0], vertex[1], vertex[2]));
+		(*geometry)->bounds.max = glm::max((*geometry)->bounds.max, glm::vec3(vertex[0], vertex[1], vertex[2]));
+	}
+
+	createStaticMeshGeometry(rockVertices, rockNVertices, rockTriangles, rockNTriangles, *geometry);
 }
 
 // init skybox
-void initskyboxMeshGeometry(GLuint shader, MeshGeometry** geometry, bool day)
+void initskyboxMeshGeometry(GLuint shader, MeshGeometry** geometry, bool day, AssetLoader& loader)
 {
-	*geometry = new MeshGeometry;
+	*geometry = new MeshGeometry();
 
 	// 2D coordinates of 2 triangles covering the whole screen (NDC), draw using triangle strip
 	static const float screenCoords[] = {
@@ -477,76 +809,60 @@ void initskyboxMeshGeometry(GLuint shader, MeshGeometry** geometry, bool day)
 
 	(*geometry)->numTriangles = 2;
 
-	glActiveTexture(GL_TEXTURE0);
-
-	glGenTextures(1, &((*geometry)->texture));
-	glBindTexture(GL_TEXTURE_CUBE_MAP, (*geometry)->texture);
-
 	const char * suffixes[] = { "posx", "negx", "posy", "negy", "posz", "negz" };
-	GLuint targets[] = {
-		GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-		GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-		GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z
-	};
-
-	std::string texName;
+	std::string texNames[6];
 	for (int i = 0; i < 6; i++) 
 	{
 		if (day)
-			texName = std::string(SKYBOX_CUBE_TEXTURE_FILE_PREFIX_DAY) + "_" + suffixes[i] + ".jpg";
+			texNames[i] = std::string(SKYBOX_CUBE_TEXTURE_FILE_PREFIX_DAY) + "_" + suffixes[i] + ".jpg";
 		else
-			texName = std::string(SKYBOX_CUBE_TEXTURE_FILE_PREFIX_NIGHT) + "_" + suffixes[i] + ".jpg";
-
-		std::cout << "Loading cube map texture: " << texName << std::endl;
-		if (!pgr::loadTexImage2D(texName, targets[i])) {
-			pgr::dieWithError("Skybox cube map loading failed!");
-		}
+			texNames[i] = std::string(SKYBOX_CUBE_TEXTURE_FILE_PREFIX_NIGHT) + "_" + suffixes[i] + ".jpg";
 	}
-
-	glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-	// unbind the texture
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-	CHECK_GL_ERROR();
+	loadCubeMapAsync(loader, texNames, &(*geometry)->texture);
 }
 
 // initialize all models used in scene
-void initializeModels()
+void initializeModels(ThreadPool& pool)
 {
-	initgroundMeshGeometry(shaderProgram, &groundMeshGeometry);
-	initRainGeometry(rainShaderProgram.program, &rainGeometry);
-	initSmokeGeometry(smokeShaderProgram.program, &smokeGeometry);
-	initrockMeshGeometry(shaderProgram, &rockMeshGeometry);
-	//initskyboxMeshGeometry(skyboxShaderProgram.program, &skyboxDayMeshGeometry, true);
-	initskyboxMeshGeometry(skyboxShaderProgram.program, &skyboxNightMeshGeometry, false);
+	// files are decoded on worker threads, GL objects are created here as the data arrive
+	AssetLoader loader;
+	initAssetLoader(loader, &pool);
+	// meshes of shaderProgram share buffers, they are uploaded when all are loaded
+	initGeometryArena(sceneArena, loader.vertexFormat);
+
+	initgroundMeshGeometry(&groundMeshGeometry, loader);
+	initRainGeometry(rainShaderProgram.program, &rainGeometry, loader);
+	initSmokeGeometry(smokeShaderProgram.program, &smokeGeometry, loader);
+	initrockMeshGeometry(&rockMeshGeometry, loader);
+	//initskyboxMeshGeometry(skyboxShaderProgram.program, &skyboxDayMeshGeometry, true, loader);
+	initskyboxMeshGeometry(skyboxShaderProgram.program, &skyboxNightMeshGeometry, false, loader);
 
 	// load models from external file
-	if (loadSingleMesh(TREE_MODEL_01, shaderProgram, &tree01MeshGeometry) != true)
-		std::cerr << "Tree model 01 loading failed" << std::endl;
-	if (loadSingleMesh(TREE_MODEL_02, shaderProgram, &tree02MeshGeometry) != true)
-		std::cerr << "Tree model 02 loading failed" << std::endl;
-	if (loadSingleMesh(TREE_MODEL_03, shaderProgram, &tree03MeshGeometry) != true)
-		std::cerr << "Tree model 03 loading failed" << std::endl;
-	if (loadSingleMesh(TREE_MODEL_04, shaderProgram, &tree04MeshGeometry) != true)
-		std::cerr << "Tree model 04 loading failed" << std::endl;
-	if (loadSingleMesh(SKULL_MODEL, shaderProgram, &skullMeshGeometry) != true)
-		std::cerr << "Skull model loading failed" << std::endl;
-	if (loadSingleMesh(MUSHROOM_MODEL, shaderProgram, &mushroomMeshGeometry) != true)
-		std::cerr << "Mushroom model loading failed" << std::endl;
-	if (loadSingleMesh(BAT_MODEL, shaderProgram, &batMeshGeometry) != true)
-		std::cerr << "Bat model loading failed" << std::endl;
-	if (loadSingleMesh(GHOST_MODEL, shaderProgram, &ghostMeshGeometry) != true)
-		std::cerr << "Ghost model loading failed" << std::endl;
-
-	if (loadSingleMesh(EXTRA_OBJECT_MODEL, shaderProgram, &extraMeshGeometry) != true)
-		std::cerr << "Extra object model loading failed" << std::endl;
-	if (loadSingleMesh(EXTRANEG_OBJECT_MODEL, shaderProgram, &extraNegMeshGeometry) != true)
-		std::cerr << "Extraneg object model loading failed" << std::endl;
+	loadMeshAsync(loader, TREE_MODEL_01, &tree01MeshGeometry);
+	loadMeshAsync(loader, TREE_MODEL_02, &tree02MeshGeometry);
+	loadMeshAsync(loader, TREE_MODEL_03, &tree03MeshGeometry);
+	loadMeshAsync(loader, TREE_MODEL_04, &tree04MeshGeometry);
+	loadMeshAsync(loader, SKULL_MODEL, &skullMeshGeometry);
+	loadMeshAsync(loader, MUSHROOM_MODEL, &mushroomMeshGeometry);
+	loadMeshAsync(loader, BAT_MODEL, &batMeshGeometry);
+	loadMeshAsync(loader, GHOST_MODEL, &ghostMeshGeometry);
+
+	loadMeshAsync(loader, EXTRA_OBJECT_MODEL, &extraMeshGeometry);
+	loadMeshAsync(loader, EXTRANEG_OBJECT_MODEL, &extraNegMeshGeometry);
+
+	if (finishAssetLoading(loader) > 0)
+		std::cerr << "Some models or textures failed to load" << std::endl;
+	uploadGeometryArena(sceneArena, shaderProgram);
+	bakeTreeImpostors();
+	initImpostorGeometry(&impostorGeometry);
+	clearStaticBatch();
+
+	glBindTexture(GL_TEXTURE_2D, rainGeometry->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// uploads have bound buffers and textures directly
+	resetStateCache();
 
 	//change ghosts materials
 	ghostMeshGeometry->ambient = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -561,99 +877,64 @@ void initializeModels()
 // draw ground
 void drawGround(GroundObject* ground, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
 {
-	glUseProgram(shaderProgram.program);
+	useProgram(shaderProgram.program);
 
-	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), ground->position);
-	modelMatrix = glm::rotate(modelMatrix, ground->viewAngle, glm::vec3(0, 0, 1));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(ground->size.x, ground->size.y, ground->size.z));
+	glm::mat4 modelMatrix = getGroundModelMatrix(ground);
 	
 	// setting matrices to the vertex & fragment shader
 	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
 	setMaterialUniforms(groundMeshGeometry->ambient, groundMeshGeometry->diffuse, groundMeshGeometry->specular, groundMeshGeometry->shininess, groundMeshGeometry->texture);
 	
-	glBindVertexArray(groundMeshGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, groundMeshGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
-}
-
-// draw rock
-void drawRock(Object* rock, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
-{
-	glUseProgram(shaderProgram.program);
-
-	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), rock->position);
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 0.0f, 0.02f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(rock->size));
-
-	// setting matrices to the vertex & fragment shader
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
-	setMaterialUniforms(rockMeshGeometry->ambient, rockMeshGeometry->diffuse, rockMeshGeometry->specular, rockMeshGeometry->shininess, rockMeshGeometry->texture);
-
-	glBindVertexArray(rockMeshGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, rockMeshGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
+	bindVertexArray(groundMeshGeometry->vertexArrayObject);
+	drawArenaMesh(sceneArena, groundMeshGeometry);
 }
 
 // draw bat
-void drawBat(MovingObject* bat, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+void drawBat(const TransformComponent& bat, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
 {
-	glUseProgram(shaderProgram.program);
+	useProgram(shaderProgram.program);
 	
-	glm::mat4 modelMatrix = alignObject(bat->position, bat->direction, glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec3 position = bat.position;
+	glm::mat4 modelMatrix = alignObject(position, bat.direction, glm::vec3(0.0f, 0.0f, 1.0f));
 	modelMatrix = glm::rotate(modelMatrix, 180.0f, glm::vec3(0, 1, 0)); //otoceny model
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(bat->size, bat->size, bat->size));
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(bat.size, bat.size, bat.size));
 	
 	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
 	setMaterialUniforms(batMeshGeometry->ambient, batMeshGeometry->diffuse, batMeshGeometry->specular, batMeshGeometry->shininess, batMeshGeometry->texture);
 	
-	glBindVertexArray(batMeshGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, batMeshGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-	
-	glBindVertexArray(0);
-	glUseProgram(0);	
+	bindVertexArray(batMeshGeometry->vertexArrayObject);
+	drawArenaMesh(sceneArena, batMeshGeometry);
 }
 
 // draw ghost
-void drawGhost(MovingObject * ghost, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+void drawGhost(const TransformComponent& ghost, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
 {
-	glUseProgram(shaderProgram.program);
+	useProgram(shaderProgram.program);
 
-	glm::mat4 modelMatrix = alignObject(ghost->position, ghost->direction, glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec3 position = ghost.position;
+	glm::mat4 modelMatrix = alignObject(position, ghost.direction, glm::vec3(0.0f, 0.0f, 1.0f));
 	modelMatrix = glm::rotate(modelMatrix, 180.0f, glm::vec3(0, 1, 0)); //otoceny model
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(ghost->size, ghost->size, ghost->size));
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(ghost.size, ghost.size, ghost.size));
 
 	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
 	setMaterialUniforms(ghostMeshGeometry->ambient, ghostMeshGeometry->diffuse, ghostMeshGeometry->specular, ghostMeshGeometry->shininess, ghostMeshGeometry->texture);
 
-	glBindVertexArray(ghostMeshGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, ghostMeshGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
+	bindVertexArray(ghostMeshGeometry->vertexArrayObject);
+	drawArenaMesh(sceneArena, ghostMeshGeometry);
 }
 
 // draw rain
-void drawRain(RainObject* rain, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) 
+void drawRain(RainObject* rain)
 {
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	setBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glUseProgram(rainShaderProgram.program);
+	useProgram(rainShaderProgram.program);
 	
 	glm::mat4 modelMatrix = alignObject(rain->position, rain->direction, glm::vec3(0.0f, 0.0f, 1.0f));
 	modelMatrix = glm::scale(modelMatrix, glm::vec3(2.0f*rain->size, 2.0f*rain->size, rain->size));
 	
-	glm::mat4 PVMmatrix = projectionMatrix * viewMatrix * modelMatrix;
-	glUniformMatrix4fv(rainShaderProgram.PVMmatrixLocation, 1, GL_FALSE, glm::value_ptr(PVMmatrix)); // model-view-projection
-	glUniform1f(rainShaderProgram.timeLocation, rain->currentTime);
-	glUniform1i(rainShaderProgram.texSamplerLocation, 0); //info for GLSL - which texture unit
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, rainGeometry->texture);
+	glUniformMatrix4fv(rainShaderProgram.MmatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix)); // model, view and projection are in FrameData
+	bindTexture(0, GL_TEXTURE_2D, rainGeometry->texture);
 
 	glm::mat4 TTmatrix = glm::mat4  //texture transform matrix 
 	(1.0f, 0.0f, 0.0f, 0.0f, 
@@ -667,83 +948,36 @@ void drawRain(RainObject* rain, const glm::mat4 & viewMatrix, const glm::mat4 &
 	TTmatrix[2].y = delta;
 
 	glUniformMatrix4fv(rainShaderProgram.texTransMatrixLocation, 1, GL_FALSE, glm::value_ptr(TTmatrix));
-	glBindVertexArray(rainGeometry->vertexArrayObject);
+	bindVertexArray(rainGeometry->vertexArrayObject);
 	glDrawArrays(GL_TRIANGLES, 0, 3 * rainGeometry->numTriangles);
+	countDraw(rainGeometry->numTriangles);
 
 	//CHECK_GL_ERROR();
-	glBindVertexArray(0);
-	glUseProgram(0);
-	glDisable(GL_BLEND);
 }
 
-// draw MeshGeometry - used for trees, skull, mushroom - still objects
-void drawMeshGeometry(MeshGeometry* geometry, glm::vec3 position, glm::vec3 direction, float size, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+// draw all still objects of mesh (MESH_*) added to the static batch, one command per level of detail (one multi draw if supported)
+void drawStaticBatch(int mesh)
 {
-	glUseProgram(shaderProgram.program);
+	MeshGeometry* geometry = getMeshGeometry(mesh);
+	if (geometry == NULL || staticBatchCommands[mesh] < 0)
+		return;
 
-	glm::mat4 modelMatrix = alignObject(position, direction, glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 0.2f, 0.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(size));
+	useProgram(shaderProgram.program);
 
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
+	glUniform1i(shaderProgram.useInstancingLocation, 1);
 	setMaterialUniforms(geometry->ambient, geometry->diffuse, geometry->specular, geometry->shininess, geometry->texture);
 
-	glBindVertexArray(geometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, geometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
-}
-
-// draw tree
-void drawTree(Object * tree, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, int type)
-{
-	switch (type)
-	{
-	case 1:
-		drawMeshGeometry(tree01MeshGeometry, tree->position, tree->direction, tree->size, viewMatrix, projectionMatrix);
-		break;
-	case 2:
-		drawMeshGeometry(tree02MeshGeometry, tree->position, tree->direction, tree->size, viewMatrix, projectionMatrix);
-		break;
-	case 3:
-		drawMeshGeometry(tree03MeshGeometry, tree->position, tree->direction, tree->size, viewMatrix, projectionMatrix);
-		break;
-	case 4:
-		drawMeshGeometry(tree04MeshGeometry, tree->position, tree->direction, tree->size, viewMatrix, projectionMatrix);
-		break;
-	default:
-		break;
-	}
-}
+	bindVertexArray(sceneArena.vertexArrayObject);
+	drawArenaBatch(sceneArena, staticBatchCommands[mesh], staticBatchCommandCounts[mesh]);
 
-//draw extra objects
-void drawExtra(Object* extra, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, bool diffColor)
-{
-	if (!diffColor)
-		drawMeshGeometry(extraMeshGeometry, extra->position, extra->direction, extra->size, viewMatrix, projectionMatrix);
-	else
-		drawMeshGeometry(extraNegMeshGeometry, extra->position, extra->direction, extra->size, viewMatrix, projectionMatrix);
-}
-
-// draw skull
-void drawSkull(Object* skull, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
-{
-	drawMeshGeometry(skullMeshGeometry, skull->position, skull->direction, skull->size, viewMatrix, projectionMatrix);
-}
-
-// draw mushroom
-void drawMushroom(Object* mush, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
-{
-	drawMeshGeometry(mushroomMeshGeometry, mush->position, mush->direction, mush->size, viewMatrix, projectionMatrix);
+	glUniform1i(shaderProgram.useInstancingLocation, 0);
 }
 
 //draw smoke
-void drawSmoke(SmokeObject * smoke, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix)
+void drawSmoke(const TransformComponent& smoke, const ParticleEmitterComponent& emitter, const glm::mat4 & viewMatrix)
 {
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE);
-	glUseProgram(smokeShaderProgram.program);
+	setBlend(true, GL_ONE, GL_ONE);
+	useProgram(smokeShaderProgram.program);
 
 	// just take rotation part of the view transform
 	glm::mat4 billboardRotationMatrix = glm::mat4(
@@ -755,52 +989,50 @@ void drawSmoke(SmokeObject * smoke, const glm::mat4 & viewMatrix, const glm::mat
 	// inverse view rotation
 	billboardRotationMatrix = glm::transpose(billboardRotationMatrix);
 
-	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), smoke->position);
-	matrix = glm::scale(matrix, glm::vec3(smoke->size));
+	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), smoke.position);
+	matrix = glm::scale(matrix, glm::vec3(smoke.size));
 	matrix = matrix*billboardRotationMatrix; // make billboard to face the camera
 
-	glm::mat4 PVMmatrix = projectionMatrix * viewMatrix * matrix;
-	glUniformMatrix4fv(smokeShaderProgram.PVMmatrixLocation, 1, GL_FALSE, glm::value_ptr(PVMmatrix));  // model-view-projection
-	glUniformMatrix4fv(smokeShaderProgram.VmatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));   // view
-	glUniform1f(smokeShaderProgram.timeLocation, smoke->currentTime - smoke->startTime);
-	glUniform1i(smokeShaderProgram.texSamplerLocation, 0);
-	glUniform1f(smokeShaderProgram.frameDurationLocation, smoke->frameDuration);
+	glUniformMatrix4fv(smokeShaderProgram.MmatrixLocation, 1, GL_FALSE, glm::value_ptr(matrix));  // model, view and projection are in FrameData
+	glUniform1f(smokeShaderProgram.timeLocation, emitter.currentTime - emitter.startTime);
+	glUniform1f(smokeShaderProgram.frameDurationLocation, emitter.frameDuration);
 
-	glBindVertexArray(smokeGeometry->vertexArrayObject);
-	glBindTexture(GL_TEXTURE_2D, smokeGeometry->texture);
+	bindVertexArray(smokeGeometry->vertexArrayObject);
+	bindTexture(0, GL_TEXTURE_2D, smokeGeometry->texture);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, smokeGeometry->numTriangles);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
-
-	glDisable(GL_BLEND);
+	countDraw(smokeGeometry->numTriangles - 2);
 }
 
-// draw skybox
-void drawSkybox(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, bool sunOn)
+// draw all distant trees added to the impostors by one instanced draw
+void drawImpostors()
 {
-	glUseProgram(skyboxShaderProgram.program);
+	if (treeImpostors.instances.empty())
+		return;
 
-	// compose transformations
-	glm::mat4 matrix = projectionMatrix * viewMatrix;
+	useProgram(impostorShaderProgram.program);
 
-	// crate view rotation matrix by using view matrix with cleared translation
-	glm::mat4 viewRotation = viewMatrix;
-	viewRotation[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	// view, projection and fog are in FrameData, atlas layout is set once at initialization
+	bindVertexArray(impostorGeometry->vertexArrayObject);
+	bindTexture(0, GL_TEXTURE_2D, impostorGeometry->texture);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, impostorGeometry->numTriangles, (GLsizei)treeImpostors.instances.size());
+	countDraw((impostorGeometry->numTriangles - 2) * (unsigned int)treeImpostors.instances.size());
+}
 
-	// vertex shader will translate screen space coordinates (NDC) using inverse PV matrix
-	glm::mat4 inversePVmatrix = glm::inverse(projectionMatrix * viewRotation);
+// draw skybox
+void drawSkybox(bool sunOn)
+{
+	useProgram(skyboxShaderProgram.program);
 
-	glUniformMatrix4fv(skyboxShaderProgram.inversePVmatrixLocation, 1, GL_FALSE, glm::value_ptr(inversePVmatrix));
-	glUniform1i(skyboxShaderProgram.skyboxSamplerLocation, 0);
+	// inverse PV matrix is in FrameData, skyboxSampler is set once at initialization
 
 	// draw "skybox" rendering 2 triangles covering the far plane
-	glBindVertexArray(skyboxNightMeshGeometry->vertexArrayObject);
+	bindVertexArray(skyboxNightMeshGeometry->vertexArrayObject);
 	//glBindVertexArray(skyboxDayMeshGeometry->vertexArrayObject);
 	
 	//one skybox (night)
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxNightMeshGeometry->texture);
+	bindTexture(0, GL_TEXTURE_CUBE_MAP, skyboxNightMeshGeometry->texture);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, skyboxNightMeshGeometry->numTriangles + 2);
+	countDraw(skyboxNightMeshGeometry->numTriangles);
 
 	//two skyboxes (day/night)
 	/*if (sunOn) {
@@ -812,8 +1044,121 @@ void drawSkybox(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, skyboxNightMeshGeometry->numTriangles + 2);
 	}*/
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// RENDER QUEUE
+
+/**
+Adds draw of object to render queue, sort key is made from the state used by its draw function.
+Nothing is queued if the geometry was not loaded.
+\param[in,out] queue
+\param[in] kind PACKET_* selecting the draw function
+\param[in] object drawn object (type depends on kind), EntityDraw of entities, NULL for still objects and skybox, it must not change until the queue is drawn
+\param[in] position world position used for depth sorting, setViewProjection() must be called before
+\param[in] variant mesh of still objects (MESH_*) or sun on for skybox
+*/
+void queueDraw(RenderQueue& queue, int kind, void* object, const glm::vec3& position, int variant)
+{
+	DrawPacket packet;
+	packet.pass = RENDER_PASS_OPAQUE;
+	packet.kind = kind;
+	packet.variant = variant;
+	packet.object = object;
+
+	GLuint program = shaderProgram.program;
+	switch (kind)
+	{
+	case PACKET_STATIC:
+		// the batch may be uploaded after queueing, meshes without objects are skipped by drawStaticBatch()
+		packet.geometry = getMeshGeometry(variant);
+		break;
+	case PACKET_BAT:
+		packet.geometry = batMeshGeometry;
+		break;
+	case PACKET_GROUND:
+		packet.geometry = groundMeshGeometry;
+		break;
+	case PACKET_GHOST:
+		packet.geometry = ghostMeshGeometry;
+		break;
+	case PACKET_SKYBOX:
+		// drawn after opaque objects, only uncovered pixels pass the depth test
+		packet.pass = RENDER_PASS_SKYBOX;
+		packet.geometry = skyboxNightMeshGeometry;
+		program = skyboxShaderProgram.program;
+		break;
+	case PACKET_RAIN:
+		packet.pass = RENDER_PASS_BLENDED;
+		packet.geometry = rainGeometry;
+		program = rainShaderProgram.program;
+		break;
+	case PACKET_SMOKE:
+		packet.pass = RENDER_PASS_BLENDED;
+		packet.geometry = smokeGeometry;
+		program = smokeShaderProgram.program;
+		break;
+	case PACKET_IMPOSTOR:
+		packet.geometry = impostorGeometry;
+		program = impostorShaderProgram.program;
+		break;
+	default:
+		return;
+	}
+	if (packet.geometry == NULL)
+		return;
+
+	float depth = -(cachedViewMatrix * glm::vec4(position, 1.0f)).z;
+	packet.key = makeSortKey(packet.pass, program, packet.geometry->vertexArrayObject, packet.geometry->texture, depth);
+	pushDrawPacket(queue, packet);
+}
+
+/**
+Draws sorted render queue, blending and depth test are set per pass (smoke is drawn
+without depth test).
+\param[in] queue sorted by sortRenderQueue()
+\param[in] viewMatrix
+\param[in] projectionMatrix
+*/
+void submitRenderQueue(const RenderQueue& queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+	for (size_t i = 0; i < queue.packets.size(); i++) {
+		const DrawPacket& packet = queue.packets[i];
+
+		if (packet.pass != RENDER_PASS_BLENDED)
+			setBlend(false);
+		setDepthTest(packet.kind != PACKET_SMOKE);
+
+		switch (packet.kind)
+		{
+		case PACKET_STATIC:
+			drawStaticBatch(packet.variant);
+			break;
+		case PACKET_BAT:
+			drawBat(((const EntityDraw*)packet.object)->transform, viewMatrix, projectionMatrix);
+			break;
+		case PACKET_GROUND:
+			drawGround((GroundObject*)packet.object, viewMatrix, projectionMatrix);
+			break;
+		case PACKET_GHOST:
+			drawGhost(((const EntityDraw*)packet.object)->transform, viewMatrix, projectionMatrix);
+			break;
+		case PACKET_SKYBOX:
+			drawSkybox(packet.variant != 0);
+			break;
+		case PACKET_RAIN:
+			drawRain((RainObject*)packet.object);
+			break;
+		case PACKET_SMOKE:
+			drawSmoke(((const EntityDraw*)packet.object)->transform, ((const EntityDraw*)packet.object)->emitter, viewMatrix);
+			break;
+		case PACKET_IMPOSTOR:
+			drawImpostors();
+			break;
+		default:
+			break;
+		}
+	}
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
@@ -826,14 +1171,22 @@ void cleanupShaderPrograms(void)
 	pgr::deleteProgramAndShaders(skyboxShaderProgram.program);
 	pgr::deleteProgramAndShaders(rainShaderProgram.program);
 	pgr::deleteProgramAndShaders(smokeShaderProgram.program);
+	pgr::deleteProgramAndShaders(impostorShaderProgram.program);
+
+	glDeleteBuffers(1, &frameDataBuffer);
+	frameDataBuffer = 0;
 }
 
 // clear geometry = clear buffers of geometry
 void clearGeometry(MeshGeometry* geometry)
 {
-	glDeleteVertexArrays(1, &(geometry->vertexArrayObject));
+	// buffers of meshes in the arena are deleted with it
+	if (geometry->vertexArrayObject != sceneArena.vertexArrayObject)
+		glDeleteVertexArrays(1, &(geometry->vertexArrayObject));
 	glDeleteBuffers(1, &(geometry->elementBufferObject));
 	glDeleteBuffers(1, &(geometry->vertexBufferObject));
+	delete geometry->positionMesh;
+	geometry->positionMesh = NULL;
 }
 
 // clear all models used in scene
@@ -855,4 +1208,7 @@ void clearModels()
 	clearGeometry(ghostMeshGeometry);
 	clearGeometry(smokeGeometry);
 	clearGeometry(rockMeshGeometry);
+	clearGeometry(impostorGeometry);
+	destroyGeometryArena(sceneArena);
+	destroyImpostorAtlas(treeImpostors);
 }
\ No newline at end of file
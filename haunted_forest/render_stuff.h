@@ -6,8 +6,40 @@
 #ifndef __RENDER_STUFF_H
 #define __RENDER_STUFF_H
 
+#include "geometry_types.h"
+
+// uniform buffer binding point of FrameData
+#define FRAME_DATA_BINDING 0
+
+/// Per-frame uniforms shared by all programs, layout std140 (uniform block FrameData in shaders).
+typedef struct FrameData {
+	glm::mat4 Vmatrix;
+	glm::mat4 Pmatrix;
+	glm::mat4 PVmatrix;
+	glm::mat4 inversePVmatrix;			// inverse of projection * view rotation (skybox)
+	glm::vec4 reflectorPosition;		// lights in eye coordinates
+	glm::vec4 reflectorDirection;
+	glm::vec4 pointlightPosition;
+	glm::vec4 fogColor;
+	float fogDensity;
+	float time;
+	GLint fogOn;						// bool in std140 takes 4 bytes
+	GLint sunOn;
+	GLint reflectorOn;
+	GLint pointlightOn;
+	float padding[2];					// block size is multiple of vec4
+} FrameData;
+
+// levels of detail of one mesh, level 0 is the full mesh
+#define MESH_MAX_LODS 4
+
+// meshes of still objects
+enum { MESH_TREE01, MESH_TREE02, MESH_TREE03, MESH_TREE04, MESH_EXTRA, MESH_EXTRA_NEG, MESH_SKULL, MESH_MUSHROOM, MESH_ROCK, MESH_COUNT };
+
+struct ImpostorInstance;
+
 typedef struct MeshGeometry {
-	GLuint vertexBufferObject;
+	GLuint vertexBufferObject;		// 0 for meshes in the scene arena
 	GLuint elementBufferObject;
 	GLuint vertexArrayObject;
 	unsigned int numTriangles;
@@ -16,6 +48,14 @@ typedef struct MeshGeometry {
 	glm::vec3 specular;
 	float shininess;
 	GLuint texture;
+	BoundingBox bounds;				// model space bounds of vertices
+	GLenum indexType;				// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLuint firstIndex;				// place in the scene arena, in indices of indexType
+	GLint baseVertex;
+	int numLods;					// levels share vertices, level 0 starts at firstIndex and has numTriangles
+	GLuint lodFirstIndex[MESH_MAX_LODS];
+	unsigned int lodNumTriangles[MESH_MAX_LODS];
+	PositionMesh* positionMesh;		// positions of level 0 for software occlusion culling and picking by rays, NULL if none
 } MeshGeometry;
 
 typedef struct CameraObject {
@@ -24,14 +64,26 @@ typedef struct CameraObject {
 	float startTime;
 	float currentTime;
 	float viewAngle;
+	glm::vec3 previousPosition;		// at the previous simulation step, drawing interpolates between them
+	glm::vec3 previousDirection;
 } CameraObject;
 
-typedef struct Object //tree, skull, mushroom
-{
-	glm::vec3 position;
-	glm::vec3 direction;
-	float size;
-} Object;
+// transforms of objects which do not move, computed when the object is created
+typedef struct TransformCache {
+	glm::mat4 modelMatrix;
+	glm::mat4 normalModelMatrix;	// inverse transposed modelMatrix
+} TransformCache;
+
+// level of detail of objects drawn as impostors
+#define LOD_IMPOSTOR -1
+
+// visible still objects sorted by mesh and level of detail, arrays are owned by the caller
+typedef struct StaticBatch {
+	glm::mat4* modelMatrices[MESH_COUNT][MESH_MAX_LODS];
+	unsigned int counts[MESH_COUNT][MESH_MAX_LODS];
+	ImpostorInstance* impostors;	// distant trees
+	unsigned int numImpostors;
+} StaticBatch;
 
 typedef struct GroundObject{
 	glm::vec3 position;
@@ -54,43 +106,18 @@ typedef struct FogObject {
 	bool fogOn;
 }FogObject;
 
-typedef struct MovingObject {
-	glm::vec3 position;
-	glm::vec3 initPosition;
-	glm::vec3 direction;
-	//glm::vec3 directionForReflector;
-	float speed;
-	float size;
-	float startTime;
-	float currentTime;
-	float viewAngle;
-} MovingObject;
-
-typedef struct SmokeObject : RainObject
-{
-	float speed;
-	int texFrames;
-	float frameDuration;
-	bool destroyed;
-} SmokeObject;
-
 typedef struct skyboxShaderProgram {
 	GLuint program;
 	// vertex attributes locations
 	GLint screenCoordLocation;
-	GLint inversePVmatrixLocation;
 	GLint skyboxSamplerLocation;
-	GLint fogOnLocation;
-	GLint fogColorLocation;
-	GLint fogDensityLocation;
 } SSkyboxShaderProgram;
 
 typedef struct rainShaderProgram {
 	GLuint program;
 	GLint posLocation;
 	GLint texCoordLocation;
-	GLint PVMmatrixLocation;
-	GLint timeLocation;
+	GLint MmatrixLocation;
 	GLint texSamplerLocation;
 	GLint texTransMatrixLocation;
 } SRainShaderProgram;
@@ -100,13 +127,22 @@ typedef struct smokeShaderProgram
 	GLuint program;
 	GLint posLocation;
 	GLint texCoordLocation;
-	GLint PVMmatrixLocation;
-	GLint VmatrixLocation;
+	GLint MmatrixLocation;
 	GLint timeLocation;
 	GLint texSamplerLocation;
 	GLint frameDurationLocation;
 } SSmokeShaderProgram;
 
+typedef struct impostorShaderProgram
+{
+	GLuint program;
+	GLint cornerLocation;
+	GLint instanceCenterLocation;
+	GLint instanceTileLocation;
+	GLint atlasTilesLocation;
+	GLint texSamplerLocation;
+} SImpostorShaderProgram;
+
 typedef struct _commonShaderProgram {
 	GLuint program;
 	GLint posLocation;
@@ -115,14 +151,13 @@ typedef struct _commonShaderProgram {
 	GLint texCoordLocation;
 
 	GLint PVMmatrixLocation;
-	// view/camera matrix
-	GLint VmatrixLocation;
 	//modeling matrix
 	GLint MmatrixLocation;
 	//inverse transposed VMmatrix
 	GLint normalMatrixLocation;
-	//elapsed time in seconds
-	GLint timeLocation;
+	// per-instance modeling matrix (attribute, occupies 4 locations)
+	GLint instanceMatrixLocation;
+	GLint useInstancingLocation;
 
 	// material
 	GLint diffuseLocation;
@@ -133,55 +168,64 @@ typedef struct _commonShaderProgram {
 	GLint useTextureLocation;
 	GLint texSamplerLocation;
 
-	//fog
-	GLint fogColorLocation;
-	GLint fogDensityLocation;
-	GLint fogOnLocation;
-
-	//sun
-	GLint sunOnLocation;
-
-	//reflector
-	GLint reflectorOnLocation;
-	GLint reflectorPositionLocation;
-	GLint reflectorDirectionLocation;
-
-	//pointlight
-	GLint pointlightPositionLocation;
-	GLint pointlightOnLocation;
-
+	// lights and fog are in FrameData
 } SCommonShaderProgram;
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 
-bool loadSingleMesh(const std::string& fileName, SCommonShaderProgram& shader, MeshGeometry** geometry);
+struct MeshData;
+struct AssetLoader;
+struct ThreadPool;
+struct RenderQueue;
+struct SceneStorage;
+struct TransformComponent;
+struct ParticleEmitterComponent;
+
+void createMeshGeometry(const MeshData& data, MeshGeometry** geometry);
 void setTransformUniforms(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
 void setMaterialUniforms(const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, float shininess, GLuint texture);
+glm::mat4 getStillObjectModelMatrix(glm::vec3 position, const glm::vec3& direction, float size);
+void setTransformCache(TransformCache& transform, const glm::mat4& modelMatrix);
+void setStillObjectTransform(SceneStorage& scene, unsigned int index);
+void setRockTransform(SceneStorage& scene, unsigned int index);
+bool setViewProjection(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+void setFrameMatrices(FrameData& frame, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+void uploadFrameData(const FrameData& frame);
+void setFrameData(FrameData& frame, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+const BoundingBox& getMeshBoundingBox(int mesh);
+const PositionMesh* getMeshPositionMesh(int mesh);
+const PositionMesh* getGroundPositionMesh(void);
+glm::mat4 getGroundModelMatrix(const GroundObject* ground);
+int selectObjectLod(SceneStorage& scene, unsigned int index, int mesh);
+bool getStaticImpostor(const SceneStorage& scene, unsigned int index, int mesh, ImpostorInstance& instance);
+void uploadStaticBatch(const StaticBatch& batch);
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 
 void initializeShaderPrograms();
-void initgroundMeshGeometry(SCommonShaderProgram& shader, MeshGeometry** geometry);
-void initRainGeometry(GLuint shader, MeshGeometry **geometry);
-void initSmokeGeometry(GLuint shader, MeshGeometry**geometry);
-void initrockMeshGeometry(SCommonShaderProgram& shader, MeshGeometry** geometry);
-void initskyboxMeshGeometry(GLuint shader, MeshGeometry** geometry, bool day);
-void initializeModels();
+void initgroundMeshGeometry(MeshGeometry** geometry, AssetLoader& loader);
+void initRainGeometry(GLuint shader, MeshGeometry **geometry, AssetLoader& loader);
+void initSmokeGeometry(GLuint shader, MeshGeometry**geometry, AssetLoader& loader);
+void initImpostorGeometry(MeshGeometry** geometry);
+void initrockMeshGeometry(MeshGeometry** geometry, AssetLoader& loader);
+void initskyboxMeshGeometry(GLuint shader, MeshGeometry** geometry, bool day, AssetLoader& loader);
+void initializeModels(ThreadPool& pool);
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 
 void drawGround(GroundObject* ground, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
-void drawRock(Object* rock, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
-void drawMeshGeometry(MeshGeometry* geometry, glm::vec3 position, glm::vec3 direction, float size, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
-void drawTree(Object* tree, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, int type);
-void drawExtra(Object* extra, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, bool diffColor);
-void drawSkull(Object* skull, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
-void drawMushroom(Object* mush, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
-void drawBat(MovingObject* bat, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
-void drawGhost(MovingObject* ghost, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
-void drawSmoke(SmokeObject* smoke, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
-void drawSkybox(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, bool day);
-void drawRain(RainObject* rain, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
+void drawStaticBatch(int mesh);
+void drawBat(const TransformComponent& bat, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+void drawGhost(const TransformComponent& ghost, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+void drawSmoke(const TransformComponent& smoke, const ParticleEmitterComponent& emitter, const glm::mat4 & viewMatrix);
+void drawImpostors();
+void drawSkybox(bool day);
+void drawRain(RainObject* rain);
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+void queueDraw(RenderQueue& queue, int kind, void* object, const glm::vec3& position, int variant = 0);
+void submitRenderQueue(const RenderQueue& queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
 
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 
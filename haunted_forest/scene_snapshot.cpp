@@ -0,0 +1,108 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		scene_snapshot.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "scene_snapshot.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// arrays start at multiples of 16 bytes
+static unsigned int alignOffset(unsigned int offset)
+{
+	return (offset + 15u) & ~15u;
+}
+
+// array of count elements at offset lies inside the file
+static bool isArrayInFile(const MappedFile& file, unsigned int offset, unsigned int count, size_t elementSize)
+{
+	return offset % 4 == 0 && (size_t)offset + (size_t)count * elementSize <= file.size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Writes snapshot in one call.
+bool writeSceneSnapshot(const std::string& fileName, const SceneSnapshotHeader& header, const SceneStorage& scene)
+{
+	unsigned int count = getSceneObjectCount(scene);
+	SceneSnapshotHeader fileHeader = header;
+	fileHeader.magic = SCENE_SNAPSHOT_MAGIC;
+	fileHeader.version = SCENE_SNAPSHOT_VERSION;
+	fileHeader.numObjects = count;
+	fileHeader.positionOffset = alignOffset(sizeof(SceneSnapshotHeader));
+	fileHeader.directionOffset = alignOffset(fileHeader.positionOffset + count * sizeof(glm::vec3));
+	fileHeader.sizeOffset = alignOffset(fileHeader.directionOffset + count * sizeof(glm::vec3));
+	fileHeader.meshOffset = alignOffset(fileHeader.sizeOffset + count * sizeof(float));
+
+	// whole file is composed in memory, padding is zeroed
+	std::vector<unsigned char> contents(fileHeader.meshOffset + count * sizeof(int), 0);
+	memcpy(&contents[0], &fileHeader, sizeof(fileHeader));
+	if (count > 0) {
+		memcpy(&contents[fileHeader.positionOffset], &scene.positions[0], count * sizeof(glm::vec3));
+		memcpy(&contents[fileHeader.directionOffset], &scene.directions[0], count * sizeof(glm::vec3));
+		memcpy(&contents[fileHeader.sizeOffset], &scene.sizes[0], count * sizeof(float));
+		memcpy(&contents[fileHeader.meshOffset], &scene.meshes[0], count * sizeof(int));
+	}
+
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == NULL) {
+		std::cerr << "cannot write scene snapshot: " << fileName << std::endl;
+		return false;
+	}
+	bool written = fwrite(&contents[0], contents.size(), 1, file) == 1;
+	written = (fclose(file) == 0) && written;
+
+	if (!written) {
+		std::cerr << "cannot write scene snapshot: " << fileName << std::endl;
+		remove(fileName.c_str());
+	}
+	return written;
+}
+
+/// Maps snapshot, fails if it does not exist, has other version or is damaged.
+bool openSceneSnapshot(const std::string& fileName, SceneSnapshot& snapshot)
+{
+	snapshot.header = NULL;
+	initMappedFile(snapshot.file);
+	if (!openMappedFile(snapshot.file, fileName))
+		return false;
+
+	const SceneSnapshotHeader* header = (const SceneSnapshotHeader*)snapshot.file.data;
+	bool valid = snapshot.file.size >= sizeof(SceneSnapshotHeader)
+		&& header->magic == SCENE_SNAPSHOT_MAGIC
+		&& header->version == SCENE_SNAPSHOT_VERSION
+		&& isArrayInFile(snapshot.file, header->positionOffset, header->numObjects, sizeof(glm::vec3))
+		&& isArrayInFile(snapshot.file, header->directionOffset, header->numObjects, sizeof(glm::vec3))
+		&& isArrayInFile(snapshot.file, header->sizeOffset, header->numObjects, sizeof(float))
+		&& isArrayInFile(snapshot.file, header->meshOffset, header->numObjects, sizeof(int))
+		&& (header->skull == SCENE_SNAPSHOT_NO_OBJECT || header->skull < header->numObjects)
+		&& (header->mush == SCENE_SNAPSHOT_NO_OBJECT || header->mush < header->numObjects)
+		&& (header->rock == SCENE_SNAPSHOT_NO_OBJECT || header->rock < header->numObjects);
+
+	// meshes index tables of the renderer
+	const int* meshes = valid ? (const int*)(snapshot.file.data + header->meshOffset) : NULL;
+	for (unsigned int i = 0; valid && i < header->numObjects; i++)
+		valid = meshes[i] >= 0 && meshes[i] < MESH_COUNT;
+
+	if (!valid) {
+		std::cerr << "invalid scene snapshot: " << fileName << std::endl;
+		closeSceneSnapshot(snapshot);
+		return false;
+	}
+
+	snapshot.header = header;
+	snapshot.positions = (const glm::vec3*)(snapshot.file.data + header->positionOffset);
+	snapshot.directions = (const glm::vec3*)(snapshot.file.data + header->directionOffset);
+	snapshot.sizes = (const float*)(snapshot.file.data + header->sizeOffset);
+	snapshot.meshes = meshes;
+	return true;
+}
+
+/// Unmaps snapshot, its arrays are no longer valid.
+void closeSceneSnapshot(SceneSnapshot& snapshot)
+{
+	closeMappedFile(snapshot.file);
+	snapshot.header = NULL;
+}
@@ -0,0 +1,84 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		scene_snapshot.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __SCENE_SNAPSHOT_H
+#define __SCENE_SNAPSHOT_H
+
+#include <string>
+#include "pgr.h"
+#include "scene_storage.h"
+#include "mapped_file.h"
+
+#define SCENE_SNAPSHOT_MAGIC 0x454E4353u		// "SCNE"
+#define SCENE_SNAPSHOT_VERSION 1
+#define SCENE_SNAPSHOT_NO_OBJECT 0xffffffffu	// skull, mush or rock missing in the scene
+
+// toggles of the scene
+#define SNAPSHOT_SUN_ON 1
+#define SNAPSHOT_SUN_FORCED 2
+#define SNAPSHOT_REFLECTOR_ON 4
+#define SNAPSHOT_RAIN 8
+#define SNAPSHOT_GHOST 16
+#define SNAPSHOT_DIFF_COLOR 32
+#define SNAPSHOT_FOG_ON 64
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Header of scene snapshot file (little endian), arrays of still objects follow at given offsets.
+typedef struct SceneSnapshotHeader {
+	unsigned int magic;
+	unsigned int version;
+
+	// generator, the layout was generated from seed and the generator continues from the saved state
+	unsigned int seed;
+	unsigned int toggles;					// SNAPSHOT_*
+	unsigned long long randomState;
+	unsigned long long randomIncrement;
+	unsigned long long layoutChecksum;		// checked after loading
+
+	int cameraNumber;
+	int attemptCnt;
+	float cameraPosition[3];
+	float cameraViewAngle;
+	float cameraElevationAngle;
+
+	unsigned int skull;						// dense indices, SCENE_SNAPSHOT_NO_OBJECT if missing
+	unsigned int mush;
+	unsigned int rock;
+
+	unsigned int numObjects;
+	unsigned int positionOffset;			// bytes from the beginning of the file, numObjects elements each
+	unsigned int directionOffset;
+	unsigned int sizeOffset;
+	unsigned int meshOffset;
+} SceneSnapshotHeader;
+
+/// Snapshot mapped to memory, arrays point directly to the file.
+typedef struct SceneSnapshot {
+	const SceneSnapshotHeader* header;
+	const glm::vec3* positions;
+	const glm::vec3* directions;
+	const float* sizes;
+	const int* meshes;						// MESH_*
+	MappedFile file;
+} SceneSnapshot;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Writes snapshot in one call.
+/**
+\param[in]  fileName           Written file.
+\param[in]  header             Everything but magic, version, numObjects and offsets, which are filled here.
+\param[in]  scene              Still objects, dense arrays are written in their order.
+\return                        True on success.
+*/
+bool writeSceneSnapshot(const std::string& fileName, const SceneSnapshotHeader& header, const SceneStorage& scene);
+
+/// Maps snapshot, fails if it does not exist, has other version or is damaged.
+bool openSceneSnapshot(const std::string& fileName, SceneSnapshot& snapshot);
+
+/// Unmaps snapshot, its arrays are no longer valid.
+void closeSceneSnapshot(SceneSnapshot& snapshot);
+
+#endif // __SCENE_SNAPSHOT_H
@@ -0,0 +1,105 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		scene_storage.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cassert>
+#include "scene_storage.h"
+
+// end of the list of free slots
+#define NO_FREE_SLOT 0xffffffffu
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// handle from slot and its generation
+static ObjectHandle makeHandle(unsigned int slot, unsigned int generation)
+{
+	return (generation << OBJECT_HANDLE_SLOT_BITS) | slot;
+}
+
+// next generation of slot, wraps within the bits left by the slot
+static unsigned int nextGeneration(unsigned int generation)
+{
+	return (generation + 1) & (0xffffffffu >> OBJECT_HANDLE_SLOT_BITS);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Empties storage and forgets all handles.
+void initSceneStorage(SceneStorage& scene)
+{
+	scene.slots.clear();
+	scene.generations.clear();
+	clearSceneStorage(scene);
+}
+
+/// Removes all objects at once, allocated memory is kept for the next scene.
+void clearSceneStorage(SceneStorage& scene)
+{
+	scene.positions.clear();
+	scene.directions.clear();
+	scene.sizes.clear();
+	scene.meshes.clear();
+	scene.flags.clear();
+	scene.lods.clear();
+	scene.transforms.clear();
+	scene.handles.clear();
+
+	// all slots are free, generations are kept so handles of removed objects stay invalid
+	scene.firstFreeSlot = NO_FREE_SLOT;
+	for (size_t slot = scene.slots.size(); slot-- > 0;) {
+		scene.generations[slot] = nextGeneration(scene.generations[slot]);
+		scene.slots[slot] = scene.firstFreeSlot;
+		scene.firstFreeSlot = (unsigned int)slot;
+	}
+}
+
+/// Adds object, its transform is left to the caller.
+ObjectHandle addSceneObject(SceneStorage& scene, int mesh, const glm::vec3& position, const glm::vec3& direction, float size)
+{
+	unsigned int slot;
+	if (scene.firstFreeSlot != NO_FREE_SLOT) {
+		slot = scene.firstFreeSlot;
+		scene.firstFreeSlot = scene.slots[slot];
+	}
+	else {
+		slot = (unsigned int)scene.slots.size();
+		assert(slot <= OBJECT_HANDLE_SLOT_MASK);
+		scene.slots.push_back(0);
+		scene.generations.push_back(0);
+	}
+
+	ObjectHandle handle = makeHandle(slot, scene.generations[slot]);
+	scene.slots[slot] = (unsigned int)scene.positions.size();
+
+	scene.positions.push_back(position);
+	scene.directions.push_back(direction);
+	scene.sizes.push_back(size);
+	scene.meshes.push_back(mesh);
+	scene.flags.push_back(0);
+	scene.lods.push_back(0);
+	scene.transforms.push_back(TransformCache());
+	scene.handles.push_back(handle);
+	return handle;
+}
+
+/// Checks whether the handle refers to a live object.
+bool isSceneObjectValid(const SceneStorage& scene, ObjectHandle handle)
+{
+	unsigned int slot = handle & OBJECT_HANDLE_SLOT_MASK;
+	if (handle == INVALID_OBJECT_HANDLE || slot >= scene.slots.size())
+		return false;
+	unsigned int index = scene.slots[slot];
+	return index < scene.handles.size() && scene.handles[index] == handle;
+}
+
+/// Dense index of live object.
+unsigned int getSceneObjectIndex(const SceneStorage& scene, ObjectHandle handle)
+{
+	assert(isSceneObjectValid(scene, handle));
+	return scene.slots[handle & OBJECT_HANDLE_SLOT_MASK];
+}
+
+/// Number of live objects (size of the dense arrays).
+unsigned int getSceneObjectCount(const SceneStorage& scene)
+{
+	return (unsigned int)scene.positions.size();
+}
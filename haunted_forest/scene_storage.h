@@ -0,0 +1,74 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		scene_storage.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __SCENE_STORAGE_H
+#define __SCENE_STORAGE_H
+
+#include <vector>
+#include "pgr.h"
+#include "render_stuff.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Stable reference to object in SceneStorage, slot in the low bits and generation of the slot in the high bits.
+typedef unsigned int ObjectHandle;
+
+#define INVALID_OBJECT_HANDLE 0xffffffffu
+#define OBJECT_HANDLE_SLOT_BITS 20
+#define OBJECT_HANDLE_SLOT_MASK ((1u << OBJECT_HANDLE_SLOT_BITS) - 1)
+
+// flags of objects
+#define OBJECT_VISIBLE 1				// result of view frustum and occlusion culling
+
+/// Still objects (trees, extra objects, skull, mushroom, rock) as structure of arrays.
+/**
+Element i of every dense array belongs to the same object, so passes touching one property
+stream over one array. Objects are removed all at once when the scene is cleared, dense
+indices are valid until then; slots reused by the next scene get new generation so handles
+of the previous scene are detected.
+*/
+typedef struct SceneStorage {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> directions;
+	std::vector<float> sizes;
+	std::vector<int> meshes;					// MESH_*
+	std::vector<unsigned char> flags;			// OBJECT_*
+	std::vector<int> lods;						// level of detail drawn last time (LOD_IMPOSTOR for impostor), keeps the level near thresholds
+	std::vector<TransformCache> transforms;
+	std::vector<ObjectHandle> handles;			// handle of each dense element
+
+	std::vector<unsigned int> slots;			// dense index of live objects, next free slot of free ones
+	std::vector<unsigned int> generations;
+	unsigned int firstFreeSlot;
+} SceneStorage;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Empties storage and forgets all handles.
+void initSceneStorage(SceneStorage& scene);
+
+/// Removes all objects at once, allocated memory is kept for the next scene.
+void clearSceneStorage(SceneStorage& scene);
+
+/// Adds object, its transform is left to the caller.
+/**
+\param[in,out] scene           Storage.
+\param[in]  mesh               MESH_* drawn for the object.
+\param[in]  position           World position.
+\param[in]  direction          Direction the object faces.
+\param[in]  size               Uniform scale.
+\return                        Handle of the new object.
+*/
+ObjectHandle addSceneObject(SceneStorage& scene, int mesh, const glm::vec3& position, const glm::vec3& direction, float size);
+
+/// Checks whether the handle refers to a live object.
+bool isSceneObjectValid(const SceneStorage& scene, ObjectHandle handle);
+
+/// Dense index of live object.
+unsigned int getSceneObjectIndex(const SceneStorage& scene, ObjectHandle handle);
+
+/// Number of live objects (size of the dense arrays).
+unsigned int getSceneObjectCount(const SceneStorage& scene);
+
+#endif // __SCENE_STORAGE_H
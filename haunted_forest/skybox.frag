@@ -7,15 +7,33 @@
 #version 140
 
 uniform samplerCube skyboxSampler;
-uniform bool fogOn;
-//uniform float fogDensity;
-//uniform vec4 fogColor;
+
+// per-frame data shared by all programs (FrameData in render_stuff.h)
+layout(std140) uniform FrameData
+{
+	mat4 Vmatrix;				// View                       --> world to eye coordinates
+	mat4 Pmatrix;				// Projection
+	mat4 PVmatrix;				// Projection * View          --> world to clip coordinates
+	mat4 inversePVmatrix;		// inverse of Projection * View rotation (skybox)
+	vec4 reflectorPosition;		// lights in eye coordinates
+	vec4 reflectorDirection;
+	vec4 pointlightPosition;
+	vec4 fogColor;
+	float fogDensity;
+	float time;					// app elapsed time in seconds
+	bool fogOn;
+	bool sunOn;
+	bool reflectorOn;
+	bool pointlightOn;
+};
+
 
 in vec3 texCoord_v;
 out vec4 color_f;
 
-float fogDensity = 2.0f;
-vec4 fogColor = vec4(0.53f, 0.13f, 0.13f, 1.0f);
+// sky has its own fog, scene fog is too thin at the far plane
+float skyFogDensity = 2.0f;
+vec4 skyFogColor = vec4(0.53f, 0.13f, 0.13f, 1.0f);
 
 void main()
 {
@@ -24,8 +42,8 @@ void main()
 	//source: 08_Misc.pdf
     if (fogOn) {
         float fogMode = 0.0;
-        fogMode = exp(-pow(fogDensity * abs(gl_FragCoord.z / gl_FragCoord.w), 2.0f));
+        fogMode = exp(-pow(skyFogDensity * abs(gl_FragCoord.z / gl_FragCoord.w), 2.0f));
         fogMode = 1.0f - clamp(fogMode, 0.0f, 1.0f);
-        color_f = mix(color_f, fogColor, fogMode);
+        color_f = mix(color_f, skyFogColor, fogMode);
     }
 }
\ No newline at end of file
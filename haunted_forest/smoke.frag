@@ -6,8 +6,7 @@
 //----------------------------------------------------------------------------------------
 #version 140
 
-uniform float time;
-uniform mat4 Vmatrix;         // view (camera) transform
+uniform float smokeTime;       // time since the smoke appeared
 uniform sampler2D texSampler; // sampler for texture access
 
 smooth in vec3 position_v;    // camera space fragment position
@@ -30,7 +29,7 @@ vec4 sampleTexture(int frame) {
 
 void main() {
   // frame of the texture to be used for smoke
-  int frame = int(time / frameDuration);
+  int frame = int(smokeTime / frameDuration);
 
   // sample proper frame of the texture to get a fragment color  
   color_f = sampleTexture(frame);
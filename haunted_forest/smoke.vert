@@ -6,7 +6,26 @@
 //----------------------------------------------------------------------------------------
 #version 140
 
-uniform mat4 PVMmatrix;     // Projection * View * Model --> model to clip coordinates
+// per-frame data shared by all programs (FrameData in render_stuff.h)
+layout(std140) uniform FrameData
+{
+	mat4 Vmatrix;				// View                       --> world to eye coordinates
+	mat4 Pmatrix;				// Projection
+	mat4 PVmatrix;				// Projection * View          --> world to clip coordinates
+	mat4 inversePVmatrix;		// inverse of Projection * View rotation (skybox)
+	vec4 reflectorPosition;		// lights in eye coordinates
+	vec4 reflectorDirection;
+	vec4 pointlightPosition;
+	vec4 fogColor;
+	float fogDensity;
+	float time;					// app elapsed time in seconds
+	bool fogOn;
+	bool sunOn;
+	bool reflectorOn;
+	bool pointlightOn;
+};
+
+uniform mat4 Mmatrix;       // Model --> model to world coordinates
 
 in vec3 position;           // vertex position in world space
 in vec2 texCoord;           // incoming texture coordinates
@@ -15,7 +34,7 @@ smooth out vec2 texCoord_v; // outgoing vertex texture coordinates
 
 void main() {
 
-  gl_Position = PVMmatrix * vec4(position, 1);   // outgoing vertex in clip coordinates
+  gl_Position = PVmatrix * Mmatrix * vec4(position, 1);   // outgoing vertex in clip coordinates
 
   texCoord_v = texCoord;
 }
@@ -0,0 +1,129 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		spatial_grid.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include <cmath>
+#include <cstdlib>
+#include "spatial_grid.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// cell coordinates -> hash key
+static unsigned long long cellKey(int x, int y)
+{
+	return ((unsigned long long)(unsigned int)x << 32) | (unsigned int)y;
+}
+
+// cell containing the coordinate
+static int cellCoord(const SpatialGrid& grid, float coord)
+{
+	return (int)floor(coord / grid.cellSize);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Sets cell size and removes all positions.
+void initSpatialGrid(SpatialGrid& grid, float cellSize)
+{
+	grid.cellSize = cellSize;
+	clearSpatialGrid(grid);
+}
+
+/// Removes all positions, cell size is kept.
+void clearSpatialGrid(SpatialGrid& grid)
+{
+	grid.cells.clear();
+	grid.count = 0;
+}
+
+/// Inserts position into the grid.
+void insertIntoGrid(SpatialGrid& grid, const glm::vec3& position)
+{
+	grid.cells[cellKey(cellCoord(grid, position.x), cellCoord(grid, position.y))].push_back(position);
+	grid.count++;
+}
+
+/// Checks whether any stored position lies within \a radius from \a center (only x, y are compared).
+bool queryGridRadius(const SpatialGrid& grid, const glm::vec2& center, float radius)
+{
+	if (grid.count == 0)
+		return false;
+
+	float radius2 = radius * radius;
+	int minX = cellCoord(grid, center.x - radius);
+	int maxX = cellCoord(grid, center.x + radius);
+	int minY = cellCoord(grid, center.y - radius);
+	int maxY = cellCoord(grid, center.y + radius);
+
+	for (int x = minX; x <= maxX; x++) {
+		for (int y = minY; y <= maxY; y++) {
+			std::unordered_map<unsigned long long, std::vector<glm::vec3> >::const_iterator cell = grid.cells.find(cellKey(x, y));
+			if (cell == grid.cells.end())
+				continue;
+
+			const std::vector<glm::vec3>& positions = cell->second;
+			for (size_t i = 0; i < positions.size(); i++) {
+				float dx = positions[i].x - center.x;
+				float dy = positions[i].y - center.y;
+				if (dx * dx + dy * dy <= radius2)
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+/// Finds stored position nearest to \a center.
+/**
+Cells are searched in growing square rings around the center cell, search stops once the
+ring is further than the best distance found so far.
+
+\param[in]  grid               Searched grid.
+\param[in]  center             Query position (x, y).
+\param[in]  maxRadius          Positions further than this are ignored.
+\param[out] nearest            Nearest position, unchanged if none was found.
+\return                        True if a position within \a maxRadius exists.
+*/
+bool findNearestInGrid(const SpatialGrid& grid, const glm::vec2& center, float maxRadius, glm::vec3& nearest)
+{
+	if (grid.count == 0)
+		return false;
+
+	int centerX = cellCoord(grid, center.x);
+	int centerY = cellCoord(grid, center.y);
+	int maxRing = (int)ceil(maxRadius / grid.cellSize) + 1;
+
+	float bestDistance2 = maxRadius * maxRadius;
+	bool found = false;
+
+	for (int ring = 0; ring <= maxRing; ring++) {
+		// every point in this ring is at least (ring - 1) cells away
+		float ringDistance = (ring - 1) * grid.cellSize;
+		if (ring > 1 && ringDistance * ringDistance > bestDistance2)
+			break;
+
+		for (int x = centerX - ring; x <= centerX + ring; x++) {
+			for (int y = centerY - ring; y <= centerY + ring; y++) {
+				// only the border of the square
+				if (abs(x - centerX) != ring && abs(y - centerY) != ring)
+					continue;
+
+				std::unordered_map<unsigned long long, std::vector<glm::vec3> >::const_iterator cell = grid.cells.find(cellKey(x, y));
+				if (cell == grid.cells.end())
+					continue;
+
+				const std::vector<glm::vec3>& positions = cell->second;
+				for (size_t i = 0; i < positions.size(); i++) {
+					float dx = positions[i].x - center.x;
+					float dy = positions[i].y - center.y;
+					float distance2 = dx * dx + dy * dy;
+					if (distance2 <= bestDistance2) {
+						bestDistance2 = distance2;
+						nearest = positions[i];
+						found = true;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
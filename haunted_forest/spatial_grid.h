@@ -0,0 +1,49 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		spatial_grid.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __SPATIAL_GRID_H
+#define __SPATIAL_GRID_H
+
+#include <vector>
+#include <unordered_map>
+#include "pgr.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Uniform grid hashing positions of objects on the ground plane (x, y).
+/**
+Only cells which contain something are stored, so the grid is not limited by scene size.
+Queries with radius up to the cell size touch only 3x3 cells.
+*/
+typedef struct SpatialGrid {
+	float cellSize;
+	std::unordered_map<unsigned long long, std::vector<glm::vec3> > cells;
+	size_t count;
+} SpatialGrid;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Sets cell size and removes all positions.
+void initSpatialGrid(SpatialGrid& grid, float cellSize);
+
+/// Removes all positions, cell size is kept.
+void clearSpatialGrid(SpatialGrid& grid);
+
+/// Inserts position into the grid.
+void insertIntoGrid(SpatialGrid& grid, const glm::vec3& position);
+
+/// Checks whether any stored position lies within \a radius from \a center (only x, y are compared).
+bool queryGridRadius(const SpatialGrid& grid, const glm::vec2& center, float radius);
+
+/// Finds stored position nearest to \a center.
+/**
+\param[in]  grid               Searched grid.
+\param[in]  center             Query position (x, y).
+\param[in]  maxRadius          Positions further than this are ignored.
+\param[out] nearest            Nearest position, unchanged if none was found.
+\return                        True if a position within \a maxRadius exists.
+*/
+bool findNearestInGrid(const SpatialGrid& grid, const glm::vec2& center, float maxRadius, glm::vec3& nearest);
+
+#endif // __SPATIAL_GRID_H
@@ -259,6 +259,20 @@ glm::vec3 ghostCurveData[] = {
 
 };
 
+const size_t benchCurveSize = 8;
+
+// loop through the forest around the clearing, low above the ground
+glm::vec3 benchCurveData[] = {
+	glm::vec3(2.0, 0.0, 0.15),
+	glm::vec3(1.4, 1.4, 0.25),
+	glm::vec3(0.0, 2.2, 0.15),
+	glm::vec3(-1.4, 1.4, 0.3),
+	glm::vec3(-2.0, 0.0, 0.15),
+	glm::vec3(-1.4, -1.4, 0.25),
+	glm::vec3(0.0, -2.2, 0.15),
+	glm::vec3(1.4, -1.4, 0.3),
+};
+
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 /// Evaluates a position on Catmull-Rom curve segment
 glm::vec3 evaluateCurveSegment(
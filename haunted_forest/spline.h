@@ -40,6 +40,10 @@ extern const size_t bat03CurveSize;
 extern glm::vec3 ghostCurveData[];
 extern const size_t ghostCurveSize;
 
+///Control points of the camera flythrough of --bench
+extern glm::vec3 benchCurveData[];
+extern const size_t benchCurveSize;
+
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 /// Cyclic clamping of a value.
 /**
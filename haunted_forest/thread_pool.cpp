@@ -0,0 +1,77 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		thread_pool.cpp
+*/
+//----------------------------------------------------------------------------------------
+#include "thread_pool.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// worker loop ~ runs tasks until the pool is stopped and the queue is empty
+static void workerLoop(ThreadPool* pool)
+{
+	std::unique_lock<std::mutex> lock(pool->mutex);
+	for (;;) {
+		while (pool->tasks.empty() && !pool->stopping)
+			pool->taskAdded.wait(lock);
+		if (pool->tasks.empty())
+			return;
+
+		std::function<void()> task = pool->tasks.front();
+		pool->tasks.pop_front();
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		if (--pool->pending == 0)
+			pool->taskFinished.notify_all();
+	}
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Starts worker threads.
+void initThreadPool(ThreadPool& pool, unsigned int numThreads)
+{
+	if (numThreads == 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+
+	pool.pending = 0;
+	pool.stopping = false;
+	for (unsigned int i = 0; i < numThreads; i++)
+		pool.workers.push_back(std::thread(workerLoop, &pool));
+}
+
+/// Queues task, it is executed on one of the workers.
+void submitTask(ThreadPool& pool, const std::function<void()>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.tasks.push_back(task);
+		pool.pending++;
+	}
+	pool.taskAdded.notify_one();
+}
+
+/// Blocks until all submitted tasks are finished.
+void waitThreadPool(ThreadPool& pool)
+{
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	while (pool.pending > 0)
+		pool.taskFinished.wait(lock);
+}
+
+/// Finishes queued tasks and joins workers.
+void destroyThreadPool(ThreadPool& pool)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.stopping = true;
+	}
+	pool.taskAdded.notify_all();
+
+	for (size_t i = 0; i < pool.workers.size(); i++)
+		pool.workers[i].join();
+	pool.workers.clear();
+}
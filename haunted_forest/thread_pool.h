@@ -0,0 +1,46 @@
+//----------------------------------------------------------------------------------------
+/**
+*      file	|		thread_pool.h
+*/
+//----------------------------------------------------------------------------------------
+#ifndef __THREAD_POOL_H
+#define __THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+/// Fixed number of worker threads executing queued tasks.
+typedef struct ThreadPool {
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable taskAdded;
+	std::condition_variable taskFinished;
+	int pending;					// tasks queued or running
+	bool stopping;
+} ThreadPool;
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/// Starts worker threads.
+/**
+\param[out] pool               Pool to start.
+\param[in]  numThreads         Number of workers, 0 to use one per hardware thread.
+*/
+void initThreadPool(ThreadPool& pool, unsigned int numThreads);
+
+/// Queues task, it is executed on one of the workers.
+void submitTask(ThreadPool& pool, const std::function<void()>& task);
+
+/// Blocks until all submitted tasks are finished.
+void waitThreadPool(ThreadPool& pool);
+
+/// Finishes queued tasks and joins workers.
+void destroyThreadPool(ThreadPool& pool);
+
+#endif // __THREAD_POOL_H
@@ -6,14 +6,34 @@
 //----------------------------------------------------------------------------------------
 #version 140
 
+// per-frame data shared by all programs (FrameData in render_stuff.h)
+layout(std140) uniform FrameData
+{
+	mat4 Vmatrix;				// View                       --> world to eye coordinates
+	mat4 Pmatrix;				// Projection
+	mat4 PVmatrix;				// Projection * View          --> world to clip coordinates
+	mat4 inversePVmatrix;		// inverse of Projection * View rotation (skybox)
+	vec4 reflectorPosition;		// lights in eye coordinates
+	vec4 reflectorDirection;
+	vec4 pointlightPosition;
+	vec4 fogColor;
+	float fogDensity;
+	float time;					// app elapsed time in seconds
+	bool fogOn;
+	bool sunOn;
+	bool reflectorOn;
+	bool pointlightOn;
+};
+
 uniform mat4 normalMatrix;	// inverse transposed Mmatrix
 uniform mat4 PVMmatrix;		// Projection * View * Model  --> model to clip coordinates
-uniform mat4 Vmatrix;		// View                       --> world to eye coordinates
 uniform mat4 Mmatrix;		// Model                      --> model to world coordinates
+uniform bool useInstancing;	// take Model from instanceMatrix instead of uniforms
 
 in vec3 position;
 in vec3 normal;
 in vec2 texCoord;
+in mat4 instanceMatrix;		// per-instance Model
 
 smooth out vec3 normal_v;
 smooth out vec2 texCoord_v;
@@ -21,10 +41,20 @@ smooth out vec3 position_v;
 
 void main()
 {
-    gl_Position = PVMmatrix * vec4(position, 1);// out:v vertex in clip coordinates
+	if (useInstancing)
+	{
+		gl_Position = PVmatrix * instanceMatrix * vec4(position, 1);
+		// instances are scaled uniformly, VM without inversion is enough for normals
+		normal_v = normalize(mat3(Vmatrix * instanceMatrix) * normal);
+		position_v = (Vmatrix * instanceMatrix * vec4(position, 1)).xyz;
+	}
+	else
+	{
+		gl_Position = PVMmatrix * vec4(position, 1);// out:v vertex in clip coordinates
+		normal_v = normalize((normalMatrix * vec4(normal, 0.0)).xyz); // normal in eye coordinates by NormalMatrix
+		position_v = (Vmatrix * Mmatrix * vec4(position, 1)).xyz; // vertex in eye coordinates
+	}
 
 	// outputs entering the fragment shader
-    normal_v = normalize((normalMatrix * vec4(normal, 0.0)).xyz); // normal in eye coordinates by NormalMatrix
     texCoord_v = texCoord;
-    position_v = (Vmatrix * Mmatrix * vec4(position, 1)).xyz; // vertex in eye coordinates
 }